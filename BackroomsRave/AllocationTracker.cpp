@@ -0,0 +1,105 @@
+#include "AllocationTracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	constexpr size_t SLOT_COUNT = static_cast<size_t>(profile_phase_t::count) + 1;
+
+	// zero-initialized before any dynamic initialization may allocate
+	std::atomic<UINT64> allocation_counts[SLOT_COUNT];
+	std::atomic<UINT64> allocation_bytes[SLOT_COUNT];
+
+	void count_allocation(size_t size) {
+		const size_t slot = static_cast<size_t>(Profiler::get_current_phase());
+		allocation_counts[slot].fetch_add(1, std::memory_order_relaxed);
+		allocation_bytes[slot].fetch_add(size, std::memory_order_relaxed);
+	}
+
+	void* allocate(size_t size) {
+		count_allocation(size);
+		void* memory = malloc(size > 0 ? size : 1);
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	void* allocate_aligned(size_t size, std::align_val_t alignment) {
+		count_allocation(size);
+		void* memory = _aligned_malloc(size > 0 ? size : 1, static_cast<size_t>(alignment));
+		if (!memory) {
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+}
+
+allocation_stats_t get_allocation_stats(profile_phase_t phase) {
+	const size_t slot = static_cast<size_t>(phase);
+	return {
+		allocation_counts[slot].load(std::memory_order_relaxed),
+		allocation_bytes[slot].load(std::memory_order_relaxed)
+	};
+}
+
+allocation_stats_t get_total_allocation_stats() {
+	allocation_stats_t total = { 0, 0 };
+	for (size_t slot = 0; slot < SLOT_COUNT; slot++) {
+		total.count += allocation_counts[slot].load(std::memory_order_relaxed);
+		total.bytes += allocation_bytes[slot].load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+// Replacements of the global allocation functions, the nothrow
+// versions call these.
+
+void* operator new(size_t size) {
+	return allocate(size);
+}
+
+void* operator new[](size_t size) {
+	return allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return allocate_aligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+	return allocate_aligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	_aligned_free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	_aligned_free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept {
+	_aligned_free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept {
+	_aligned_free(memory);
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <Windows.h>
+#include "Profiler.h"
+
+/*
+ * Heap allocations counted by the replaced global operator new.
+ *
+ * Every allocation is attributed to the innermost profile phase of
+ * the allocating thread, so a phase covers its subsystem (camera,
+ * scene, audio, uploads). Allocations outside of all phases are
+ * attributed to profile_phase_t::count.
+ *
+ * Without profile scopes (NO_PROFILER) all allocations are outside
+ * of all phases.
+ */
+struct allocation_stats_t {
+	UINT64 count;
+	UINT64 bytes;
+};
+
+allocation_stats_t get_allocation_stats(profile_phase_t phase);
+allocation_stats_t get_total_allocation_stats();
+
+#endif // ALLOCATION_TRACKER_H
\ No newline at end of file
@@ -1,16 +1,47 @@
 #include <cassert>
 #include <utility>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
 #include <wrl.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <DirectXMath.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <memory>
+#include <span>
+#include <string>
+#include <thread>
 #include "ApplicationD3D.h"
+#include "AllocationTracker.h"
+#include "AudioMixer.h"
+#include "Benchmarks.h"
 #include "Camera.h"
+#include "CameraPath.h"
+#include "FramePipeline.h"
+#include "FrameSequence.h"
+#include "InstanceSorter.h"
+#include "JobSystem.h"
+#include "LightBaker.h"
+#include "LightingCache.h"
+#include "FrameRing.h"
+#include "Profiler.h"
+#include "RangeAllocator.h"
+#include "SoundWrapper.h"
+#include "UploadScheduler.h"
 #include "util.h"
+#include "Y4mWriter.h"
 #include "Scene.h"
 #include "SceneConfig.h"
+#include "SoftwareRasterizer.h"
+#include "TileLod.h"
 #include "types.h"
 
 #ifndef NDEBUG
@@ -24,6 +55,8 @@
 namespace {
 #include "vertex_shader.h"
 #include "pixel_shader.h"
+#include "vertex_shader_pixel_lit.h"
+#include "pixel_shader_pixel_lit.h"
 
     using ::std::array;
 
@@ -31,6 +64,7 @@ namespace {
 
     using DirectX::XMFLOAT4X4;
     using DirectX::XMFLOAT4;
+    using DirectX::XMFLOAT3;
     using DirectX::XMStoreFloat4x4;
     using DirectX::XMMatrixIdentity;
     using DirectX::XMMATRIX;
@@ -95,53 +129,310 @@ namespace {
     ComPtr<ID3D12Resource> vertex_buffer = nullptr;
     D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {};
 
-    // Descriptor heap for cbv and srv
+    // Descriptor heap for srv
     ComPtr<ID3D12DescriptorHeap> descriptor_heap = nullptr;
 
     // Constant buffer for vertex shader
-    ComPtr<ID3D12Resource> vs_const_buffer = nullptr;
-    constexpr UINT CONST_BUFFER_ALIGN = 512;
-
-    struct vs_const_buffer_t {
-        XMFLOAT4X4 matViewProj;
-        XMFLOAT4X4 matView;
-        XMFLOAT4 colMaterial;
-        XMFLOAT4 colLight[7];
-        XMFLOAT4 pointLight[7];
-        XMFLOAT4 ambientLight;
-        XMFLOAT4 padding[(CONST_BUFFER_ALIGN
-            			- 2 * sizeof(XMFLOAT4X4) - 16 * sizeof(XMFLOAT4)) / sizeof(XMFLOAT4)];
-    };
     constexpr size_t VS_CONST_BUFFER_SIZE = sizeof(vs_const_buffer_t);
     vs_const_buffer_t vs_const_buffer_cpu_data;
-    UINT* vs_const_buffer_data = nullptr;
 
     // CPU - GPU synchronization
     ComPtr<ID3D12Fence> sync_fence = nullptr;
     HANDLE fence_event;
     UINT64 fence_values[FB_COUNT] = { 0, 0 };
 
+    /*
+     * Frame fence of the frame ring, backed by sync_fence.
+     */
+    class D3D12FrameFence : public FrameFence {
+    public:
+        UINT64 get_completed_value() override {
+            return sync_fence->GetCompletedValue();
+        }
+
+        void wait_for_value(UINT64 value) override {
+            if (sync_fence->GetCompletedValue() < value) {
+                hr_check(sync_fence->SetEventOnCompletion(value, fence_event));
+                WaitForSingleObject(fence_event, INFINITE);
+            }
+        }
+    };
+    D3D12FrameFence frame_fence;
+
     // Camera
     std::unique_ptr<Camera> camera;
 
+    // Input of every tick, live unless a recording is replayed
+    std::unique_ptr<InputSource> input;
+    std::wstring input_recording_path;
+
+    // Set once a replay or the camera path ended
+    std::atomic<bool> run_finished = false;
+
+    // Scripted flythrough: the camera follows the path over
+    // `benchmark_frame_count` ticks instead of taking input
+    std::unique_ptr<CameraPath> camera_path;
+    UINT benchmark_frame_count = 0;
+    UINT benchmark_frame = 0;
+    std::wstring benchmark_report_path;
+
+    // Totals of the rendered frames for the benchmark report
+    struct render_stats_t {
+        UINT64 frames;
+        UINT64 drawn_instances;
+        UINT64 upload_bytes;
+    } render_stats = {};
+
+    // Ticks simulated so far, the animation time of the last simulated
+    // frame and a checksum of all
+    // frames simulated from input, equal for replays of the same input
+    // in a window of any size, with the number of those frames
+    UINT64 simulation_tick = 0;
+    UINT32 simulation_time_ms = 0;
+    UINT64 simulation_checksum = fnv1a(nullptr, 0);
+    UINT64 checksum_frames = 0;
+
+    // Jobs of the scene build and update, on all cores
+    std::unique_ptr<JobSystem> job_system;
+
     // Scene
     const SceneConfig scene_config;
     std::unique_ptr<Scene> scene;
 
+    // Spatial audio, every lamp plays the music
+    constexpr UINT AUDIO_SAMPLE_RATE = 44100;
+    // of the headless mix of CheckAudioMix in the portable build, only
+    // compared along with golden frames since it depends on the math
+    // library as they do
+    constexpr UINT64 AUDIO_MIX_CHECKSUM = 0xd66926f31cb57631;
+    std::unique_ptr<AudioMixer> audio_mixer;
+    std::unique_ptr<SoundWrapper> sound;
+    std::vector<size_t> lamp_emitters;
+    std::vector<XMFLOAT4> lamp_positions;
+    std::vector<XMFLOAT3> lamp_velocities;
+    XMFLOAT3 last_camera_position;
+
     // Geometric data of base square
     const auto base_square_data = scene_config.get_base_square();
 
-    // Geometric data of instances
-    std::vector<square_instance_t> instances;
+    // Number of instances: static ones followed by dynamic ones
+    size_t instance_count = 0;
+    size_t static_instance_count = 0;
 
-    // Instance buffer
+    // Instance buffer of static instances. Ranges of it are handed out
+    // by instance_allocator, so instances can be added and removed
+    // without rebuilding the whole buffer.
+    constexpr UINT64 MIN_INSTANCE_CAPACITY = 4096;
     ComPtr<ID3D12Resource> instance_buffer = nullptr;
     D3D12_VERTEX_BUFFER_VIEW instance_buffer_view = {};
-
+    square_instance_t* instance_buffer_data = nullptr;
+    std::unique_ptr<RangeAllocator> instance_allocator;
+    // Static instances, in a range of their own per back buffer when
+    // the lighting cache or the tile LOD changes them between frames
+    RangeAllocator::handle_t static_instance_ranges[FB_COUNT] = {
+        RangeAllocator::INVALID_HANDLE, RangeAllocator::INVALID_HANDLE };
+
+    // Upload ring for data that changes every frame: the constant
+    // buffer and dynamic instances. Room for the frames in flight
+    // and the one being written.
+    constexpr UINT64 INSTANCE_ALIGN = 16;
+    ComPtr<ID3D12Resource> upload_ring_buffer = nullptr;
+    UINT8* upload_ring_data = nullptr;
+    std::unique_ptr<FrameRing> upload_ring;
+    D3D12_GPU_VIRTUAL_ADDRESS frame_const_buffer_address = 0;
+    D3D12_VERTEX_BUFFER_VIEW dynamic_instance_buffer_view = {};
 
     // Texture resource
     ComPtr<ID3D12Resource> texture_resource = nullptr;
 
+    /*
+     * Upload queue of the upload scheduler. Records copies into its own
+     * command lists, one allocator per batch in flight, and submits them
+     * to the main command queue ahead of the frame that uses the data.
+     */
+    class D3D12UploadQueue : public UploadQueue {
+    public:
+        void begin_batch() override {
+            // reuse an allocator whose batch the GPU has finished
+            const UINT64 completed_value = sync_fence->GetCompletedValue();
+            current = allocators.size();
+            for (size_t i = 0; i < allocators.size(); i++) {
+                if (allocators[i].fence_value <= completed_value) {
+                    current = i;
+                    break;
+                }
+            }
+            if (current == allocators.size()) {
+                allocators.push_back({});
+                hr_check(d3d12_device->CreateCommandAllocator(
+                    D3D12_COMMAND_LIST_TYPE_DIRECT,
+                    IID_PPV_ARGS(&allocators[current].allocator)));
+            }
+            else {
+                hr_check(allocators[current].allocator->Reset());
+            }
+
+            if (!cmd_list) {
+                hr_check(d3d12_device->CreateCommandList(
+                    0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+                    allocators[current].allocator.Get(), nullptr,
+                    IID_PPV_ARGS(&cmd_list)));
+            }
+            else {
+                hr_check(cmd_list->Reset(
+                    allocators[current].allocator.Get(), nullptr));
+            }
+        }
+
+        UINT64 submit_batch() override {
+            hr_check(cmd_list->Close());
+            ID3D12CommandList* tmp_cmd_list = cmd_list.Get();
+            cmd_queue->ExecuteCommandLists(1, &tmp_cmd_list);
+
+            // the same fence as frames, so values keep increasing
+            const UINT64 fence_value = fence_values[back_buffer_idx]++;
+            hr_check(cmd_queue->Signal(sync_fence.Get(), fence_value));
+            allocators[current].fence_value = fence_value;
+            return fence_value;
+        }
+
+        ID3D12GraphicsCommandList* get_command_list() {
+            return cmd_list.Get();
+        }
+
+    private:
+        struct allocator_t {
+            ComPtr<ID3D12CommandAllocator> allocator;
+            UINT64 fence_value = 0;
+        };
+        std::vector<allocator_t> allocators;
+        size_t current = 0;
+        ComPtr<ID3D12GraphicsCommandList> cmd_list;
+    };
+
+    // Uploads of textures and buffers, staged in a persistent ring
+    constexpr UINT64 STAGING_CAPACITY = 16 * 1024 * 1024;
+    constexpr UINT64 UPLOAD_FRAME_BUDGET = 4 * 1024 * 1024;
+    ComPtr<ID3D12Resource> staging_buffer = nullptr;
+    D3D12UploadQueue upload_queue;
+    std::unique_ptr<UploadScheduler> upload_scheduler;
+
+    // Startup work running on worker threads while device objects
+    // are created
+    struct bitmap_t {
+        std::shared_ptr<BYTE[]> bits;
+        UINT width = 0;
+        UINT height = 0;
+    };
+    struct wave_t {
+        std::vector<float> samples;
+        UINT sample_rate = AUDIO_SAMPLE_RATE;
+    };
+    std::future<bitmap_t> texture_task;
+    std::future<wave_t> music_task;
+    std::future<std::unique_ptr<Scene>> scene_task;
+
+    // Pipelined frames: the next frame is simulated into a snapshot
+    // on a worker thread while the current one is rendered
+    constexpr size_t MAX_FRAME_LATENCY = 1;
+    struct frame_snapshot_t {
+        vs_const_buffer_t constants;
+        std::vector<square_instance_t> dynamic_instances;
+        std::vector<tile_lighting_t> static_lighting;   // tiles relit by the lighting cache
+        std::vector<square_instance_t> lod_instances;   // static tiles selected by the tile LOD
+        bool lod_changed = false;                       // if they differ from the last frame
+        std::vector<instance_range_t> static_order;     // static instances front to back
+    };
+    std::vector<frame_snapshot_t> frame_snapshots;
+    std::unique_ptr<FramePipeline> frame_pipeline;
+
+    // CPU time of the frame phases, collected after every frame
+    std::unique_ptr<Profiler> profiler;
+
+    // Heap allocations of every phase, the last entry is outside of phases
+    constexpr size_t ALLOCATION_SLOTS = static_cast<size_t>(profile_phase_t::count) + 1;
+    using allocation_snapshot_t = array<allocation_stats_t, ALLOCATION_SLOTS>;
+
+    // Frames of the headless run before allocations must stop, the
+    // interactive frames are checked after the same warm-up
+    constexpr UINT ALLOCATION_WARMUP_FRAMES = 60;
+    allocation_snapshot_t warm_allocations = {};
+
+    // Software rendering of the headless frames: the checksum of
+    // every frame is kept, every RASTER_IMAGE_INTERVAL-th is saved
+    constexpr UINT RASTER_IMAGE_INTERVAL = 100;
+    bool software_rendering = false;
+    std::wstring raster_output_prefix;
+    std::wstring raster_golden_path;
+    std::unique_ptr<SoftwareRasterizer> rasterizer;
+    std::vector<UINT64> raster_checksums;
+    std::vector<square_instance_t> sorted_instances;    // static ones in draw order
+    double raster_overdraw = 0.0;                       // summed over the frames
+
+    // Every OFFLINE_CHECK_INTERVAL-th offline frame is rendered again
+    // by a single worker and compared with the sequence
+    constexpr UINT OFFLINE_CHECK_INTERVAL = 50;
+
+    // Lighting baked for the static tiles, for lamp colors averaged
+    // over BAKE_BEATS beats; kept so edits re-solve only what changed
+    constexpr uint64_t BAKE_BEATS = 64;
+    LightBaker light_baker;
+
+    // Static tiles lit on the CPU and cached between frames instead of
+    // being lit by the vertex shader, with totals of all simulated frames
+    bool lighting_cache_enabled = false;
+    std::unique_ptr<LightingCache> lighting_cache;
+    struct cache_stats_t {
+        UINT64 updates;
+        UINT64 relit_tiles;
+    } cache_stats = {};
+
+    // Static tiles merged into large quads, lit per pixel instead of
+    // per vertex; the merged quads have no baked lighting
+    bool per_pixel_lighting = false;
+
+    // Static tiles subdivided adaptively, fine only near the lamp paths;
+    // baked lighting only fits the uniform tiles
+    bool adaptive_tiles = false;
+
+    // Static tiles drawn through a distance-based level of detail,
+    // selected every simulated frame; the selected instances take the
+    // place of the static ones, `lod_instance_count` in the last selection
+    bool tile_lod_enabled = false;
+    std::unique_ptr<TileLod> tile_lod;
+    size_t lod_instance_count = 0;
+    struct lod_stats_t {
+        UINT64 selections;
+        UINT64 changes;
+    } lod_stats = {};
+
+    // Static instances of the last rendered snapshot, relit or selected.
+    // The range of a back buffer catches up with them when the buffer is
+    // drawn into again, once the GPU has finished its previous frame.
+    std::vector<square_instance_t> current_static_instances;
+    struct static_range_state_t {
+        std::vector<UINT32> stale_tiles;    // relit since the range was written
+        std::vector<UINT8> is_stale;
+        bool stale_selection = false;       // of the tile LOD
+        size_t lod_instance_count = 0;      // selected instances in the range
+    };
+    static_range_state_t static_range_states[FB_COUNT];
+
+    // Static instances drawn front to back, in clusters sorted by view
+    // depth, so the depth test rejects hidden pixels before they are
+    // shaded, with totals of all simulated frames
+    bool instance_sorting = false;
+    std::unique_ptr<InstanceSorter> instance_sorter;
+    struct sort_stats_t {
+        UINT64 frames;
+        UINT64 sorts;
+    } sort_stats = {};
+
+    // Projection: vertical field of view, near and far planes
+    constexpr FLOAT FIELD_OF_VIEW = 45.0f;
+    constexpr FLOAT NEAR_PLANE = 0.5f;
+    constexpr FLOAT FAR_PLANE = 50.0f;
+
     // Color constants
     constinit FLOAT const clear_color[] = { 0.875f, 0.875f, 0.875f, 1.0f };
 
@@ -149,19 +440,12 @@ namespace {
 
     /*
      * Creates the root signature that links constant buffer
-     * with vertex shader and (texture) shader resource
-     * with pixel shader
+     * with both shaders and (texture) shader resource
+     * with pixel shader. The constant buffer is a root descriptor,
+     * so every frame can point it at its own copy in the upload ring.
      */
     void InitRootSignature() {
         D3D12_DESCRIPTOR_RANGE descriptor_ranges[] = {
-            {
-                .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV,
-                .NumDescriptors = 1,
-                .BaseShaderRegister = 0,
-                .RegisterSpace = 0,
-                .OffsetInDescriptorsFromTableStart =
-                     D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND
-            },
             {
                 .RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
                 .NumDescriptors = 1,
@@ -173,15 +457,15 @@ namespace {
         };
         D3D12_ROOT_PARAMETER root_params[] = {
             {
-                .ParameterType =
-                     D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
-                .DescriptorTable = { 1, &descriptor_ranges[0]},
-                .ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX
+                .ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV,
+                .Descriptor = { .ShaderRegister = 0, .RegisterSpace = 0 },
+                // the pixel shader of the per-pixel lighting reads the lights
+                .ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL
             },
             {
                 .ParameterType =
                      D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE,
-                .DescriptorTable = { 1, &descriptor_ranges[1]},
+                .DescriptorTable = { 1, &descriptor_ranges[0]},
                 .ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL
             }
         };
@@ -438,14 +722,31 @@ namespace {
                 .AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT,
                 .InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA,
                 .InstanceDataStepRate = 1
+            },
+            {
+                .SemanticName = "INSTANCE_TEXSCALE",
+                .SemanticIndex = 0,
+                .Format = DXGI_FORMAT_R32G32_FLOAT,
+                .InputSlot = 1,
+                .AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT,
+                .InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA,
+                .InstanceDataStepRate = 1
             }
         };
 
+        // Merged quads need the lighting and the texture repeated per pixel
+        const D3D12_SHADER_BYTECODE vertex_shader = per_pixel_lighting
+            ? D3D12_SHADER_BYTECODE{ vs_pixel_lit_main, sizeof(vs_pixel_lit_main) }
+            : D3D12_SHADER_BYTECODE{ vs_main, sizeof(vs_main) };
+        const D3D12_SHADER_BYTECODE pixel_shader = per_pixel_lighting
+            ? D3D12_SHADER_BYTECODE{ ps_pixel_lit_main, sizeof(ps_pixel_lit_main) }
+            : D3D12_SHADER_BYTECODE{ ps_main, sizeof(ps_main) };
+
         // Graphic pipeline state settings
         D3D12_GRAPHICS_PIPELINE_STATE_DESC pipeline_state_desc = {
             .pRootSignature = root_signature.Get(),
-            .VS = { vs_main, sizeof(vs_main) },  // vertex shader bytecode
-            .PS = { ps_main, sizeof(ps_main) },  // pixel shader bytecode
+            .VS = vertex_shader,  // vertex shader bytecode
+            .PS = pixel_shader,   // pixel shader bytecode
             .DS = {},
             .HS = {},
             .GS = {},
@@ -485,17 +786,87 @@ namespace {
     /*
      * Initializes the camera and scene.
      */
-    void InitSceneElements(HWND hwnd) {
+    void InitSceneElements(HWND hwnd, std::unique_ptr<Scene> built_scene) {
 		// Create a camera
-        camera = std::make_unique<Camera>(hwnd);
+        camera = std::make_unique<Camera>();
+
+        // Take input from the user unless it is replayed
+        // or the camera follows a path
+        if (!input && !camera_path) {
+            input = std::make_unique<LiveInput>(hwnd);
+        }
+        // throws if the recording cannot be written
+        if (input && !input_recording_path.empty()) {
+            input = std::make_unique<InputRecorder>(
+                std::move(input), input_recording_path.c_str());
+        }
 
-		// Create a scene
-        scene = std::make_unique<Scene>(scene_config);
+		// Take the scene built by the scene task
+        scene = std::move(built_scene);
 
-		// Create instances
-		instances = scene->get_instances();
+		// Count instances
+		instance_count = scene->get_instance_count();
+		static_instance_count = scene->get_static_instances().size();
 	}
 
+    /*
+     * Passes the current listener and lamp state to the audio mixer.
+     */
+    void UpdateAudio() {
+        constexpr FLOAT ticks_per_second = 1000.0f / INTERVAL;
+
+        XMFLOAT3 camera_position = camera->get_position();
+        XMFLOAT3 camera_velocity = {
+            (camera_position.x - last_camera_position.x) * ticks_per_second,
+            (camera_position.y - last_camera_position.y) * ticks_per_second,
+            (camera_position.z - last_camera_position.z) * ticks_per_second
+        };
+        last_camera_position = camera_position;
+        audio_mixer->set_listener(
+            camera_position, camera->get_right(), camera_velocity);
+
+        scene->write_lamp_positions(lamp_positions);
+        scene->write_lamp_velocities(lamp_velocities);
+        for (size_t i = 0; i < lamp_emitters.size(); i++) {
+            const XMFLOAT4& position = lamp_positions[i];
+            const XMFLOAT3& velocity = lamp_velocities[i];
+            audio_mixer->set_emitter(
+                lamp_emitters[i],
+                { position.x, position.y, position.z },
+                {
+                    velocity.x * ticks_per_second,
+                    velocity.y * ticks_per_second,
+                    velocity.z * ticks_per_second
+                }
+            );
+        }
+    }
+
+    /*
+     * Attaches an emitter playing the music to every lamp
+     * and starts the playback.
+     *
+     * MUST BE CALLED AFTER InitSceneElements.
+     */
+    void InitAudio(wave_t music) {
+        audio_mixer = std::make_unique<AudioMixer>(AUDIO_SAMPLE_RATE);
+
+        size_t music_clip = audio_mixer->add_clip(
+            std::move(music.samples), music.sample_rate);
+
+        lamp_positions.resize(scene->get_lamp_count());
+        lamp_velocities.resize(scene->get_lamp_count());
+        scene->write_lamp_positions(lamp_positions);
+        for (const auto& position : lamp_positions) {
+            lamp_emitters.push_back(audio_mixer->add_emitter(
+                music_clip, { position.x, position.y, position.z }));
+        }
+
+        last_camera_position = camera->get_position();
+        UpdateAudio();
+        sound = std::make_unique<SoundWrapper>(*audio_mixer);
+    }
+
     /*
      * Creates a vertex buffer and fills it with geometry data.
      */
@@ -542,61 +913,12 @@ namespace {
     }
 
     /*
-     * Creates an instance buffer and fills it with instance data.
-     */
-    void BuildInstanceBuffer() {
-        D3D12_HEAP_PROPERTIES heap_prop = {
-          .Type = D3D12_HEAP_TYPE_UPLOAD,
-          .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
-          .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
-          .CreationNodeMask = 1,
-          .VisibleNodeMask = 1
-        };
-        D3D12_RESOURCE_DESC resource_desc = {
-          .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
-          .Alignment = 0,
-          .Width = instances.size() * sizeof(square_instance_t),
-          .Height = 1,
-          .DepthOrArraySize = 1,
-          .MipLevels = 1,
-          .Format = DXGI_FORMAT_UNKNOWN,
-          .SampleDesc = {.Count = 1, .Quality = 0 },
-          .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
-          .Flags = D3D12_RESOURCE_FLAG_NONE
-        };
-        hr_check(d3d12_device->CreateCommittedResource(
-            &heap_prop,
-            D3D12_HEAP_FLAG_NONE,
-            &resource_desc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&instance_buffer)
-        ));
-
-        UINT8* dst_data = nullptr;
-        D3D12_RANGE read_range = { 0, 0 };
-        hr_check(instance_buffer->Map(
-            0, &read_range, reinterpret_cast<void**>(&dst_data)
-        ));
-        memcpy(dst_data, instances.data(), instances.size() * sizeof(square_instance_t));
-        instance_buffer->Unmap(0, nullptr);
-
-        instance_buffer_view.BufferLocation =
-            instance_buffer->GetGPUVirtualAddress();
-        instance_buffer_view.SizeInBytes = static_cast<UINT>(instances.size())
-            * sizeof(square_instance_t);
-        instance_buffer_view.StrideInBytes = sizeof(square_instance_t);
-    }
-
-
-    /*
-     * Creates a descriptor heap for constant buffer (vertex shader)
-     * and texture shader resource (pixel shader).
+     * Creates a descriptor heap for texture shader resource (pixel shader).
      */
     void BuildDescriptorHeap() {
         D3D12_DESCRIPTOR_HEAP_DESC cbv_heap_desc = {
             .Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-            .NumDescriptors = 2,
+            .NumDescriptors = 1,
             .Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE,
             .NodeMask = 0
         };
@@ -605,11 +927,18 @@ namespace {
     }
 
     /*
-     * Creates a constant buffer for vertex shader and fills it
-     * with some initial data (identity matrix).
+     * Creates the upload ring shared by per-frame data.
      */
-    void BuildVSConstBuffer() {
-        // Create constant buffer resource
+    void BuildUploadRing() {
+        // one frame: constant buffer and dynamic instances, each aligned
+        const UINT64 instance_bytes = (instance_count - static_instance_count)
+            * sizeof(square_instance_t);
+        const UINT64 frame_size = VS_CONST_BUFFER_SIZE
+            + (instance_bytes + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1)
+            / D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+            * D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+        const UINT64 capacity = (FB_COUNT + 1) * frame_size;
+
         D3D12_HEAP_PROPERTIES heap_prop = {
             .Type = D3D12_HEAP_TYPE_UPLOAD,
             .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
@@ -620,7 +949,7 @@ namespace {
         D3D12_RESOURCE_DESC resource_desc = {
             .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
             .Alignment = 0,
-            .Width = VS_CONST_BUFFER_SIZE,
+            .Width = capacity,
             .Height = 1,
             .DepthOrArraySize = 1,
             .MipLevels = 1,
@@ -632,23 +961,21 @@ namespace {
         hr_check(d3d12_device->CreateCommittedResource(
             &heap_prop, D3D12_HEAP_FLAG_NONE,
             &resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr, IID_PPV_ARGS(&vs_const_buffer)
+            nullptr, IID_PPV_ARGS(&upload_ring_buffer)
         ));
 
-        // Create a constant buffer view
-        D3D12_CONSTANT_BUFFER_VIEW_DESC vs_const_buffer_view = {
-            .BufferLocation = vs_const_buffer->GetGPUVirtualAddress(),
-            .SizeInBytes = VS_CONST_BUFFER_SIZE
-        };
-        d3d12_device->CreateConstantBufferView(
-            &vs_const_buffer_view,
-            descriptor_heap->GetCPUDescriptorHandleForHeapStart());
-
-        // Map and initialize the constant buffer.
         // Do not unmap this until the appplication closes.
         D3D12_RANGE read_range = { 0, 0 };
-        hr_check(vs_const_buffer->Map(
-            0, &read_range, reinterpret_cast<void**>(&vs_const_buffer_data)));
+        hr_check(upload_ring_buffer->Map(
+            0, &read_range, reinterpret_cast<void**>(&upload_ring_data)));
+        upload_ring = std::make_unique<FrameRing>(capacity, frame_fence);
+    }
+
+    /*
+     * Sets the initial constant buffer data (identity matrix).
+     * Frame snapshots start from it.
+     */
+    void InitConstBufferData() {
         XMStoreFloat4x4(
             &vs_const_buffer_cpu_data.matViewProj, XMMatrixIdentity());
         XMStoreFloat4x4(
@@ -659,8 +986,282 @@ namespace {
 		}
         vs_const_buffer_cpu_data.colMaterial = { 0.0f, 0.0f, 0.0f, 1.0f };
         vs_const_buffer_cpu_data.ambientLight = { 0.15f, 0.15f, 0.f, 1.0f };
-        memcpy(vs_const_buffer_data, &vs_const_buffer_cpu_data,
-            sizeof vs_const_buffer_cpu_data);
+    }
+
+    /*
+     * Copies the constant buffer and dynamic instances of a frame
+     * snapshot into the upload ring. Space of frames the GPU has
+     * finished is reused, an unsubmitted frame is overwritten.
+     */
+    void UploadFrameData(const frame_snapshot_t& snapshot) {
+        PROFILE_SCOPE(upload_frame);
+        upload_ring->begin_frame();
+
+        const UINT64 const_offset = upload_ring->allocate(
+            VS_CONST_BUFFER_SIZE, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+        memcpy(upload_ring_data + const_offset, &snapshot.constants,
+            sizeof(snapshot.constants));
+        frame_const_buffer_address =
+            upload_ring_buffer->GetGPUVirtualAddress() + const_offset;
+
+        const size_t dynamic_count = snapshot.dynamic_instances.size();
+        const UINT64 instance_offset = upload_ring->allocate(
+            dynamic_count * sizeof(square_instance_t), INSTANCE_ALIGN);
+        memcpy(upload_ring_data + instance_offset, snapshot.dynamic_instances.data(),
+            dynamic_count * sizeof(square_instance_t));
+        dynamic_instance_buffer_view.BufferLocation =
+            upload_ring_buffer->GetGPUVirtualAddress() + instance_offset;
+        dynamic_instance_buffer_view.SizeInBytes = static_cast<UINT>(dynamic_count)
+            * sizeof(square_instance_t);
+        dynamic_instance_buffer_view.StrideInBytes = sizeof(square_instance_t);
+    }
+
+    /*
+     * Writes the colors of the tiles relit in a snapshot into
+     * `instances`, the static instances. Returns the bytes written.
+     */
+    UINT64 ApplyStaticLighting(const frame_snapshot_t& snapshot, square_instance_t* instances) {
+        for (const tile_lighting_t& tile : snapshot.static_lighting) {
+            instances[tile.tile].color = tile.color;
+        }
+        return snapshot.static_lighting.size() * sizeof(XMFLOAT4);
+    }
+
+    /*
+     * Writes the static instances selected in a snapshot over `instances`,
+     * the static instances, if they changed. Returns the bytes written.
+     */
+    UINT64 ApplyTileLod(const frame_snapshot_t& snapshot, square_instance_t* instances) {
+        if (!snapshot.lod_changed) {
+            return 0;
+        }
+        std::copy(snapshot.lod_instances.begin(), snapshot.lod_instances.end(), instances);
+        lod_instance_count = snapshot.lod_instances.size();
+        return lod_instance_count * sizeof(square_instance_t);
+    }
+
+    /*
+     * Applies the static lighting and the tile LOD of a snapshot to
+     * current_static_instances, then copies into the static range of the
+     * current back buffer what changed since it was last drawn: the tiles
+     * relit in the meantime, or the whole selection. The GPU may still
+     * read the range of the other back buffer. Returns the bytes written
+     * to the instance buffer.
+     */
+    UINT64 UpdateStaticRange(const frame_snapshot_t& snapshot) {
+        if (lighting_cache) {
+            ApplyStaticLighting(snapshot, current_static_instances.data());
+            for (static_range_state_t& state : static_range_states) {
+                for (const tile_lighting_t& tile : snapshot.static_lighting) {
+                    if (!state.is_stale[tile.tile]) {
+                        state.is_stale[tile.tile] = 1;
+                        state.stale_tiles.push_back(tile.tile);
+                    }
+                }
+            }
+        }
+        if (tile_lod && ApplyTileLod(snapshot, current_static_instances.data()) > 0) {
+            for (static_range_state_t& state : static_range_states) {
+                state.stale_selection = true;
+            }
+        }
+
+        static_range_state_t& state = static_range_states[back_buffer_idx];
+        square_instance_t* range = instance_buffer_data
+            + instance_allocator->get_offset(static_instance_ranges[back_buffer_idx]);
+        UINT64 bytes = 0;
+        if (state.stale_selection) {
+            std::copy_n(current_static_instances.data(), lod_instance_count, range);
+            state.lod_instance_count = lod_instance_count;
+            state.stale_selection = false;
+            bytes += lod_instance_count * sizeof(square_instance_t);
+        }
+        for (UINT32 tile : state.stale_tiles) {
+            range[tile].color = current_static_instances[tile].color;
+            state.is_stale[tile] = 0;
+        }
+        bytes += state.stale_tiles.size() * sizeof(XMFLOAT4);
+        state.stale_tiles.clear();
+        return bytes;
+    }
+
+    /*
+     * Pixels covered by a unit of size at a distance of 1
+     * in the projection of WriteSnapshot.
+     */
+    FLOAT GetFocalLength() {
+        return viewport.Height / (2.0f * std::abs(std::tan(FIELD_OF_VIEW / 2.0f)));
+    }
+
+    /*
+     * Writes the constant buffer data and dynamic instances
+     * of the state of `scene` into a snapshot.
+     */
+    void WriteSnapshot(const Scene& scene, frame_snapshot_t& snapshot,
+        const XMMATRIX& view_matrix) {
+        PROFILE_SCOPE(write_snapshot);
+        vs_const_buffer_t& constants = snapshot.constants;
+
+        // Compute transformation matrices.
+        XMMATRIX vp_matrix = XMMatrixMultiply(
+            view_matrix,                                               // View
+            XMMatrixPerspectiveFovLH(                                  // Projection
+                FIELD_OF_VIEW, viewport.Width / viewport.Height, NEAR_PLANE, FAR_PLANE)
+        );
+
+        vp_matrix = XMMatrixTranspose(vp_matrix);
+
+        XMStoreFloat4x4(&constants.matViewProj, vp_matrix);
+        XMStoreFloat4x4(&constants.matView, XMMatrixTranspose(view_matrix));
+        scene.write_lamp_colors(constants.colLight);
+        scene.write_lamp_positions(constants.pointLight);
+        const size_t light_count = (std::min)(scene.get_lamp_count(),
+            std::size(constants.pointLight));
+        for (size_t i = 0; i < light_count; i++) {
+            // make light slightly lower to better illuminate the ceiling
+            constants.pointLight[i].y -= 0.25;
+        }
+        scene.write_dynamic_instances(snapshot.dynamic_instances);
+    }
+
+    /*
+     * Pose of the camera in frame `frame` of `frame_count`
+     * frames along a path. The first and the last frame are
+     * the ends of the path.
+     */
+    camera_pose_t SampleCameraPath(const CameraPath& path, UINT frame, UINT frame_count) {
+        return path.sample(path.get_duration() * frame
+            / (std::max)(frame_count - 1, 1u));
+    }
+
+    /*
+     * Takes the input of a tick and simulates one frame into snapshot `slot`.
+     * Runs on the frame pipeline worker, which is the only user
+     * of the input, the camera, the scene and the audio state after startup.
+     * A camera path takes the place of the input until it ends.
+     * Without input, or once a replay or the path ends, the view
+     * does not move and time advances by one tick.
+     */
+    void SimulateFrame(size_t slot) {
+        PROFILE_SCOPE(simulate);
+        input_frame_t frame = { 0, 0, 0, simulation_time_ms + INTERVAL };
+        const bool driven = camera_path
+            ? benchmark_frame < benchmark_frame_count
+            : input && input->next(frame);
+        if ((camera_path || input) && !driven) {
+            run_finished = true;
+        }
+        simulation_time_ms = frame.time_ms;
+
+        if (camera) {
+            PROFILE_SCOPE(camera_update);
+            if (!camera_path) {
+                camera->update(frame);
+            }
+            else if (driven) {
+                const camera_pose_t pose = SampleCameraPath(
+                    *camera_path, benchmark_frame, benchmark_frame_count);
+                camera->set_pose(pose.position, pose.yaw, pose.pitch);
+                benchmark_frame++;
+            }
+        }
+        {
+            PROFILE_SCOPE(scene_update);
+            scene->update(++simulation_tick, frame.time_ms);
+        }
+        frame_snapshot_t& snapshot = frame_snapshots[slot];
+        WriteSnapshot(*scene, snapshot,
+            camera ? camera->get_view_matrix() : XMMatrixIdentity());
+        if (lighting_cache) {
+            PROFILE_SCOPE(light_cache);
+            lighting_cache->update(snapshot.constants, *job_system, snapshot.static_lighting);
+            cache_stats.updates++;
+            cache_stats.relit_tiles += snapshot.static_lighting.size();
+        }
+        if (tile_lod) {
+            PROFILE_SCOPE(tile_lod);
+            snapshot.lod_changed = tile_lod->select(
+                camera ? camera->get_position() : XMFLOAT3(0.0f, 0.0f, 0.0f),
+                GetFocalLength(), snapshot.lod_instances);
+            lod_stats.selections++;
+            lod_stats.changes += snapshot.lod_changed;
+        }
+        if (instance_sorter) {
+            PROFILE_SCOPE(sort_instances);
+            if (tile_lod && snapshot.lod_changed) {
+                instance_sorter->set_instances(snapshot.lod_instances);
+            }
+            sort_stats.sorts += instance_sorter->sort(snapshot.constants.matView, *job_system);
+            sort_stats.frames++;
+            const std::span<const instance_range_t> order = instance_sorter->get_order();
+            snapshot.static_order.assign(order.begin(), order.end());
+        }
+        if (driven) {
+            // the projection depends on the size of the window, which
+            // a replay does not reproduce, the view matrix and the
+            // rest of the constants do not
+            constexpr size_t VIEW_OFFSET = offsetof(vs_const_buffer_t, matView);
+            simulation_checksum = fnv1a(reinterpret_cast<const BYTE*>(&snapshot.constants) + VIEW_OFFSET,
+                sizeof(snapshot.constants) - VIEW_OFFSET, simulation_checksum);
+            simulation_checksum = fnv1a(snapshot.dynamic_instances.data(),
+                snapshot.dynamic_instances.size() * sizeof(square_instance_t),
+                simulation_checksum);
+            checksum_frames++;
+        }
+        if (audio_mixer) {
+            PROFILE_SCOPE(audio_update);
+            UpdateAudio();
+        }
+    }
+
+    /*
+     * Creates the snapshots and starts simulating frames.
+     *
+     * MUST BE CALLED AFTER InitConstBufferData AND InitSceneElements.
+     */
+    void StartFramePipeline() {
+        // the levels of detail are built over the uniform tiles
+        if (tile_lod_enabled && !per_pixel_lighting && !adaptive_tiles) {
+            tile_lod = timed(L"tile lod", [] {
+                return std::make_unique<TileLod>(scene_config.get_rectangles(),
+                    scene->get_static_instances());
+            });
+        }
+        // merged quads are lit per pixel, not per tile, and blocks
+        // of the levels of detail keep their averaged lighting
+        if (lighting_cache_enabled && !per_pixel_lighting && !tile_lod) {
+            lighting_cache = std::make_unique<LightingCache>(scene->get_static_instances());
+        }
+        frame_pipeline = std::make_unique<FramePipeline>(
+            MAX_FRAME_LATENCY, SimulateFrame);
+        frame_snapshots.assign(frame_pipeline->get_slot_count(), {
+            vs_const_buffer_cpu_data,
+            std::vector<square_instance_t>(instance_count - static_instance_count)
+        });
+        if (lighting_cache) {
+            // the first update relights every tile
+            for (frame_snapshot_t& snapshot : frame_snapshots) {
+                snapshot.static_lighting.reserve(lighting_cache->get_tile_count());
+            }
+        }
+        if (tile_lod) {
+            for (frame_snapshot_t& snapshot : frame_snapshots) {
+                snapshot.lod_instances.reserve(tile_lod->get_tile_count());
+            }
+        }
+        if (instance_sorting) {
+            instance_sorter = std::make_unique<InstanceSorter>(
+                static_instance_count, NEAR_PLANE, FAR_PLANE);
+            // the tile LOD hands its selections over as they change
+            if (!tile_lod) {
+                instance_sorter->set_instances(scene->get_static_instances());
+            }
+            for (frame_snapshot_t& snapshot : frame_snapshots) {
+                snapshot.static_order.reserve((static_instance_count + InstanceSorter::CLUSTER_SIZE - 1)
+                    / InstanceSorter::CLUSTER_SIZE);
+            }
+        }
+        frame_pipeline->start();
     }
 
     /*
@@ -695,70 +1296,143 @@ namespace {
     }
 
     /*
-     * Builds and initializes texture resource for GPU.
-     * Creates its view.
-     *
-     * MUST BE CALLED AFTER CreateCommandList (without Close),
-     * InitFence AND InitPipelineStates.
+     * Creates a mapped instance buffer for `capacity` instances.
      */
-    void BuildTextureResource() {
-        hr_check(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
-        UINT const bmp_px_size = 4;
-        UINT bmp_width = 0;
-        UINT bmp_height = 0;
-        BYTE* bmp_bits = load_bitmap(scene_config.get_texture_path(), bmp_width, bmp_height);
-
-        // Texture resource
-        D3D12_HEAP_PROPERTIES tex_heap_prop = {
-            .Type = D3D12_HEAP_TYPE_DEFAULT,
-            .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
-            .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
-            .CreationNodeMask = 1,
-            .VisibleNodeMask = 1
+    void CreateInstanceBuffer(UINT64 capacity) {
+        D3D12_HEAP_PROPERTIES heap_prop = {
+          .Type = D3D12_HEAP_TYPE_UPLOAD,
+          .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+          .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+          .CreationNodeMask = 1,
+          .VisibleNodeMask = 1
         };
-        D3D12_RESOURCE_DESC tex_resource_desc = {
-            .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
-            .Alignment = 0,
-            .Width = bmp_width,
-            .Height = bmp_height,
-            .DepthOrArraySize = 1,
-            .MipLevels = 1,
-            .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
-            .SampleDesc = {.Count = 1, .Quality = 0 },
-            .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
-            .Flags = D3D12_RESOURCE_FLAG_NONE
+        D3D12_RESOURCE_DESC resource_desc = {
+          .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+          .Alignment = 0,
+          .Width = capacity * sizeof(square_instance_t),
+          .Height = 1,
+          .DepthOrArraySize = 1,
+          .MipLevels = 1,
+          .Format = DXGI_FORMAT_UNKNOWN,
+          .SampleDesc = {.Count = 1, .Quality = 0 },
+          .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+          .Flags = D3D12_RESOURCE_FLAG_NONE
         };
         hr_check(d3d12_device->CreateCommittedResource(
-            &tex_heap_prop, D3D12_HEAP_FLAG_NONE,
-            &tex_resource_desc, D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr, IID_PPV_ARGS(&texture_resource)));
-
-        // Helper buffer for reading texture to GPU
-        ComPtr<ID3D12Resource> texture_upload_buffer = nullptr;
+            &heap_prop,
+            D3D12_HEAP_FLAG_NONE,
+            &resource_desc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&instance_buffer)
+        ));
 
-        UINT64 RequiredSize = 0;
-        auto Desc = texture_resource.Get()->GetDesc();
-        ID3D12Device* pDevice = nullptr;
-        hr_check(texture_resource.Get()->GetDevice(
-            __uuidof(*pDevice), reinterpret_cast<void**>(&pDevice)
+        // Do not unmap this until the appplication closes.
+        D3D12_RANGE read_range = { 0, 0 };
+        hr_check(instance_buffer->Map(
+            0, &read_range, reinterpret_cast<void**>(&instance_buffer_data)
         ));
-        pDevice->GetCopyableFootprints(
-            &Desc, 0, 1, 0, nullptr, nullptr, nullptr, &RequiredSize);
-        pDevice->Release();
+        // unused instances are all zero and draw nothing
+        memset(instance_buffer_data, 0, capacity * sizeof(square_instance_t));
 
-        D3D12_HEAP_PROPERTIES tex_upload_heap_prop = {
-            .Type = D3D12_HEAP_TYPE_UPLOAD,
-            .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
-            .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
-            .CreationNodeMask = 1,
-            .VisibleNodeMask = 1
-        };
-        D3D12_RESOURCE_DESC tex_upload_resource_desc = {
-           .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
-           .Alignment = 0,
-           .Width = RequiredSize,
-           .Height = 1,
-           .DepthOrArraySize = 1,
+        instance_buffer_view.BufferLocation =
+            instance_buffer->GetGPUVirtualAddress();
+        instance_buffer_view.SizeInBytes = static_cast<UINT>(capacity)
+            * sizeof(square_instance_t);
+        instance_buffer_view.StrideInBytes = sizeof(square_instance_t);
+    }
+
+    /*
+     * Replaces the instance buffer with a larger one,
+     * keeping all allocated instances at their offsets.
+     */
+    void GrowInstanceBuffer(UINT64 new_capacity) {
+        if (sync_fence) {
+            WaitForGPU();   // the old buffer may still be in use
+        }
+        ComPtr<ID3D12Resource> old_buffer = instance_buffer;
+        square_instance_t* old_data = instance_buffer_data;
+        CreateInstanceBuffer(new_capacity);
+        memcpy(instance_buffer_data, old_data,
+            instance_allocator->get_end() * sizeof(square_instance_t));
+        old_buffer->Unmap(0, nullptr);
+        instance_allocator->grow(new_capacity);
+    }
+
+    /*
+     * Copies instances into a free range of the instance buffer,
+     * growing it when there is no room.
+     */
+    RangeAllocator::handle_t AllocateInstances(
+        std::span<const square_instance_t> instances) {
+        if (instances.empty()) {
+            return RangeAllocator::INVALID_HANDLE;
+        }
+        auto handle = instance_allocator->allocate(instances.size());
+        if (handle == RangeAllocator::INVALID_HANDLE) {
+            const UINT64 capacity = instance_allocator->get_capacity();
+            GrowInstanceBuffer(std::bit_ceil(capacity + instances.size()));
+            handle = instance_allocator->allocate(instances.size());
+        }
+        memcpy(instance_buffer_data + instance_allocator->get_offset(handle),
+            instances.data(), instances.size_bytes());
+        return handle;
+    }
+
+    /*
+     * Creates the instance buffer and fills it with static instances.
+     * Dynamic instances live in the upload ring.
+     */
+    void BuildInstanceBuffer() {
+        const UINT64 capacity = (std::max)(
+            std::bit_ceil(static_cast<UINT64>(static_instance_count)),
+            MIN_INSTANCE_CAPACITY);
+        instance_allocator = std::make_unique<RangeAllocator>(capacity);
+        CreateInstanceBuffer(capacity);
+        std::fill(std::begin(static_instance_ranges), std::end(static_instance_ranges),
+            AllocateInstances(scene->get_static_instances()));
+    }
+
+    /*
+     * Gives every back buffer a static range of its own if the lighting
+     * cache or the tile LOD changes the static instances between frames,
+     * so a frame never writes the instances the GPU draws the one before
+     * it from.
+     *
+     * MUST BE CALLED AFTER BuildInstanceBuffer AND StartFramePipeline.
+     */
+    void BuildStaticRanges() {
+        if (!lighting_cache && !tile_lod) {
+            return;
+        }
+        const std::span<const square_instance_t> instances = scene->get_static_instances();
+        current_static_instances.assign(instances.begin(), instances.end());
+        for (UINT i = 1; i < FB_COUNT; i++) {
+            static_instance_ranges[i] = AllocateInstances(instances);
+        }
+        for (static_range_state_t& state : static_range_states) {
+            state.stale_tiles.reserve(instances.size());
+            state.is_stale.assign(instances.size(), 0);
+        }
+    }
+
+    /*
+     * Creates the staging buffer and the scheduler of uploads through it.
+     */
+    void BuildUploadScheduler() {
+        D3D12_HEAP_PROPERTIES heap_prop = {
+            .Type = D3D12_HEAP_TYPE_UPLOAD,
+            .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+            .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+            .CreationNodeMask = 1,
+            .VisibleNodeMask = 1
+        };
+        D3D12_RESOURCE_DESC resource_desc = {
+           .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+           .Alignment = 0,
+           .Width = STAGING_CAPACITY,
+           .Height = 1,
+           .DepthOrArraySize = 1,
            .MipLevels = 1,
            .Format = DXGI_FORMAT_UNKNOWN,
            .SampleDesc = {.Count = 1, .Quality = 0 },
@@ -766,86 +1440,108 @@ namespace {
            .Flags = D3D12_RESOURCE_FLAG_NONE
         };
         hr_check(d3d12_device->CreateCommittedResource(
-            &tex_upload_heap_prop, D3D12_HEAP_FLAG_NONE,
-            &tex_upload_resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr, IID_PPV_ARGS(&texture_upload_buffer)));
-
-        // Copy texture surface data to the helper buffer
-        D3D12_SUBRESOURCE_DATA texture_data = {
-            .pData = bmp_bits,
-            .RowPitch = bmp_width * bmp_px_size,
-            .SlicePitch = bmp_width * bmp_height * bmp_px_size
-        };
-
-        hr_check(cmd_list->Reset(cmd_allocators[back_buffer_idx].Get(),
-            pipeline_state.Get()));
+            &heap_prop, D3D12_HEAP_FLAG_NONE,
+            &resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&staging_buffer)));
 
-        UINT const MAX_SUBRESOURCES = 1;
-        RequiredSize = 0;
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT Layouts[MAX_SUBRESOURCES];
-        UINT NumRows[MAX_SUBRESOURCES];
-        UINT64 RowSizesInBytes[MAX_SUBRESOURCES];
-        Desc = texture_resource.Get()->GetDesc();
-        pDevice = nullptr;
-        hr_check(texture_resource.Get()->GetDevice(
-            __uuidof(*pDevice), reinterpret_cast<void**>(&pDevice)
-        ));
-        pDevice->GetCopyableFootprints(
-            &Desc, 0, 1, 0, Layouts, NumRows, RowSizesInBytes, &RequiredSize);
-        pDevice->Release();
-
-        UINT8* map_tex_data = nullptr;
-        hr_check(texture_upload_buffer->Map(0, nullptr,
-            reinterpret_cast<void**>(&map_tex_data)));
-
-        D3D12_MEMCPY_DEST DestData = {
-            .pData = map_tex_data + Layouts[0].Offset,
-            .RowPitch = Layouts[0].Footprint.RowPitch,
-            .SlicePitch = SIZE_T(Layouts[0].Footprint.RowPitch)
-                                * SIZE_T(NumRows[0])
-        };
-        for (UINT z = 0; z < Layouts[0].Footprint.Depth; ++z) {
-            auto pDestSlice = static_cast<UINT8*>(DestData.pData)
-                + DestData.SlicePitch * z;
-            auto pSrcSlice = static_cast<const UINT8*>(texture_data.pData)
-                + texture_data.SlicePitch * LONG_PTR(z);
-            for (UINT y = 0; y < NumRows[0]; ++y) {
-                memcpy(pDestSlice + DestData.RowPitch * y,
-                    pSrcSlice + texture_data.RowPitch * LONG_PTR(y),
-                    static_cast<SIZE_T>(RowSizesInBytes[0]));
-            }
-        }
+        // Do not unmap this until the appplication closes.
+        BYTE* staging_data = nullptr;
+        D3D12_RANGE read_range = { 0, 0 };
+        hr_check(staging_buffer->Map(
+            0, &read_range, reinterpret_cast<void**>(&staging_data)));
+        upload_scheduler = std::make_unique<UploadScheduler>(
+            staging_data, STAGING_CAPACITY, UPLOAD_FRAME_BUDGET,
+            upload_queue, frame_fence);
+    }
 
-        texture_upload_buffer->Unmap(0, nullptr);
+    /*
+     * Builds texture resource for GPU from a decoded bitmap
+     * and creates its view.
+     * Texture data is uploaded by the upload scheduler.
+     * Requires BuildUploadScheduler.
+     */
+    void BuildTextureResource(bitmap_t bitmap) {
+        UINT const bmp_px_size = 4;
+        UINT bmp_width = bitmap.width;
+        UINT bmp_height = bitmap.height;
+        std::shared_ptr<BYTE[]> bmp_bits = std::move(bitmap.bits);
 
-        // Ask GPU to copy texture data from the helper buffer
-        // to the texture resource
-        D3D12_TEXTURE_COPY_LOCATION Dst = {
-            .pResource = texture_resource.Get(),
-            .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
-            .SubresourceIndex = 0
-        };
-        D3D12_TEXTURE_COPY_LOCATION Src = {
-            .pResource = texture_upload_buffer.Get(),
-            .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
-            .PlacedFootprint = Layouts[0]
+        // Texture resource
+        D3D12_HEAP_PROPERTIES tex_heap_prop = {
+            .Type = D3D12_HEAP_TYPE_DEFAULT,
+            .CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN,
+            .MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN,
+            .CreationNodeMask = 1,
+            .VisibleNodeMask = 1
         };
-        cmd_list->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
-
-        D3D12_RESOURCE_BARRIER tex_upload_resource_barrier = {
-            .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-            .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
-            .Transition = {
-                .pResource = texture_resource.Get(),
-                .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-                .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
-                .StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE },
+        D3D12_RESOURCE_DESC tex_resource_desc = {
+            .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+            .Alignment = 0,
+            .Width = bmp_width,
+            .Height = bmp_height,
+            .DepthOrArraySize = 1,
+            .MipLevels = 1,
+            .Format = DXGI_FORMAT_R8G8B8A8_UNORM,
+            .SampleDesc = {.Count = 1, .Quality = 0 },
+            .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+            .Flags = D3D12_RESOURCE_FLAG_NONE
         };
-        cmd_list->ResourceBarrier(1, &tex_upload_resource_barrier);
+        hr_check(d3d12_device->CreateCommittedResource(
+            &tex_heap_prop, D3D12_HEAP_FLAG_NONE,
+            &tex_resource_desc, D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr, IID_PPV_ARGS(&texture_resource)));
 
-        hr_check(cmd_list->Close());
-        ID3D12CommandList* tmp_cmd_list = cmd_list.Get();
-        cmd_queue->ExecuteCommandLists(1, &tmp_cmd_list);
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+        UINT num_rows;
+        UINT64 row_size_in_bytes;
+        UINT64 required_size = 0;
+        d3d12_device->GetCopyableFootprints(&tex_resource_desc, 0, 1, 0,
+            &layout, &num_rows, &row_size_in_bytes, &required_size);
+
+        upload_scheduler->enqueue({
+            .size = required_size,
+            .alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT,
+            // Copy texture surface data to the staging buffer
+            .write = [=](BYTE* staging) {
+                const SIZE_T src_row_pitch = SIZE_T(bmp_width) * bmp_px_size;
+                for (UINT y = 0; y < num_rows; ++y) {
+                    memcpy(staging + layout.Offset
+                            + SIZE_T(layout.Footprint.RowPitch) * y,
+                        bmp_bits.get() + src_row_pitch * y,
+                        static_cast<SIZE_T>(row_size_in_bytes));
+                }
+            },
+            // Ask GPU to copy texture data from the staging buffer
+            // to the texture resource
+            .record = [=](UINT64 staging_offset) {
+                ID3D12GraphicsCommandList* upload_cmd_list =
+                    upload_queue.get_command_list();
+                D3D12_TEXTURE_COPY_LOCATION dst = {
+                    .pResource = texture_resource.Get(),
+                    .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+                    .SubresourceIndex = 0
+                };
+                D3D12_PLACED_SUBRESOURCE_FOOTPRINT staged_layout = layout;
+                staged_layout.Offset += staging_offset;
+                D3D12_TEXTURE_COPY_LOCATION src = {
+                    .pResource = staging_buffer.Get(),
+                    .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+                    .PlacedFootprint = staged_layout
+                };
+                upload_cmd_list->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+                D3D12_RESOURCE_BARRIER tex_upload_resource_barrier = {
+                    .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+                    .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
+                    .Transition = {
+                        .pResource = texture_resource.Get(),
+                        .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+                        .StateBefore = D3D12_RESOURCE_STATE_COPY_DEST,
+                        .StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE },
+                };
+                upload_cmd_list->ResourceBarrier(1, &tex_upload_resource_barrier);
+            }
+        });
 
         // Shader resource view for texture
         D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {
@@ -861,13 +1557,8 @@ namespace {
         };
         D3D12_CPU_DESCRIPTOR_HANDLE cpu_desc_handle =
             descriptor_heap->GetCPUDescriptorHandleForHeapStart();
-        cpu_desc_handle.ptr += d3d12_device->GetDescriptorHandleIncrementSize(
-            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
         d3d12_device->CreateShaderResourceView(
             texture_resource.Get(), &srv_desc, cpu_desc_handle);
-
-        WaitForGPU();   // MUST NOT DELETE texture_upload_buffer
-        // BEFORE COPYING IS FINISHED
     }
 
     /*
@@ -877,6 +1568,7 @@ namespace {
     void PrepareNextFrame() {
         const UINT64 current_fence_value = fence_values[back_buffer_idx];
         hr_check(cmd_queue->Signal(sync_fence.Get(), current_fence_value));
+        upload_ring->end_frame(current_fence_value);
 
         // Update the frame index.
         back_buffer_idx = swap_chain->GetCurrentBackBufferIndex();
@@ -884,6 +1576,7 @@ namespace {
         // If the next frame is not ready to be rendered yet,
         // wait until it is ready.
         if (sync_fence->GetCompletedValue() < fence_values[back_buffer_idx]) {
+            PROFILE_SCOPE(fence_wait);
             hr_check(sync_fence->SetEventOnCompletion(
                 fence_values[back_buffer_idx], fence_event));
             WaitForSingleObject(fence_event, INFINITE);
@@ -894,27 +1587,158 @@ namespace {
     }
 
     /*
-     * Initializes all program's graphic resources.
+     * Decodes the texture of the scene.
+     */
+    bitmap_t LoadTexture() {
+        // WIC needs COM on this thread
+        if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED))) {
+            throw "Cannot initialize COM";
+        }
+        bitmap_t bitmap;
+        try {
+            bitmap.bits.reset(load_bitmap(
+                scene_config.get_texture_path(), bitmap.width, bitmap.height));
+        }
+        catch (const char*) {
+            CoUninitialize();
+            throw;
+        }
+        CoUninitialize();
+        return bitmap;
+    }
+
+    /*
+     * Bakes the lighting of the static tiles of `target`
+     * and puts it into its instances.
+     */
+    void BakeLighting(Scene& target, JobSystem& jobs) {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t solved = light_baker.bake(scene_config.get_rectangles(),
+            target.get_static_instances(),
+            LightBaker::average_lamps(scene_config.get_lamps(), target.get_lamps(), BAKE_BEATS),
+            jobs);
+        target.set_static_lighting(light_baker.get_tiles());
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+
+        WCHAR line[128];
+        swprintf_s(line, L"[bake] %zu of %zu tiles solved in %.1f ms\n",
+            solved, light_baker.get_tiles().size(), time.count());
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Merges the static tiles of `target` into large quads
+     * for the per-pixel lighting.
+     */
+    void MergeStaticTiles(Scene& target) {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t tiles = target.get_static_instances().size();
+        target.merge_static_instances();
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        log_tile_reduction(L"merge", L"level", tiles, target.get_static_instances().size(), time.count());
+    }
+
+    /*
+     * Replaces the uniform static tiles of `target` with the adaptive
+     * tiling of the level.
+     */
+    void SubdivideStaticTiles(Scene& target, JobSystem& jobs) {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t tiles = target.get_static_instances().size();
+        target.subdivide_static_instances(scene_config.get_rectangles(), scene_config.get_lamps(), jobs);
+        const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        log_tile_reduction(L"adaptive", L"level", tiles, target.get_static_instances().size(), time.count());
+    }
+
+    /*
+     * Prepares the static tiles of `target` for the lighting in use:
+     * merged for the per-pixel lighting, subdivided for the adaptive
+     * tiling, baked otherwise.
+     */
+    void PrepareStaticTiles(Scene& target, JobSystem& jobs) {
+        // merging needs the uniform tiles, so it wins over the adaptive tiling
+        if (adaptive_tiles && per_pixel_lighting) {
+            OutputDebugStringW(L"[adaptive] ignored, the per-pixel lighting merges the uniform tiles\n");
+        }
+        else if (adaptive_tiles) {
+            timed(L"subdivide tiles", [&] { SubdivideStaticTiles(target, jobs); });
+        }
+        if (per_pixel_lighting) {
+            timed(L"merge tiles", [&] { MergeStaticTiles(target); });
+        }
+        else if (!adaptive_tiles) {
+            timed(L"bake lighting", [&] { BakeLighting(target, jobs); });
+        }
+    }
+
+    /*
+     * Starts the startup work that does not need the device:
+     * texture decoding, music loading and the scene build.
+     * Their errors are thrown again by the get of their futures.
+     */
+    void StartLoadingTasks() {
+        job_system = std::make_unique<JobSystem>();
+        texture_task = std::async(std::launch::async, [] {
+            return timed(L"decode texture", LoadTexture);
+        });
+        music_task = std::async(std::launch::async, [] {
+            return timed(L"load music", [] {
+                wave_t music;
+                music.samples = load_wave(
+                    scene_config.get_music_path(), music.sample_rate);
+                return music;
+            });
+        });
+        scene_task = std::async(std::launch::async, [] {
+            auto built_scene = timed(L"build scene", [] {
+                return std::make_unique<Scene>(scene_config, *job_system);
+            });
+            PrepareStaticTiles(*built_scene, *job_system);
+            return built_scene;
+        });
+    }
+
+    /*
+     * Initializes all program's graphic resources, joining
+     * the loading tasks where their results are needed.
+     *
+     * MUST BE CALLED AFTER StartLoadingTasks.
      */
     void InitGraphicsResources(HWND hwnd) {
-        InitRootSignature();
-        InitDepthBuffer();
-        InitPipelineState();
-        InitCommandList();
-        InitSceneElements(hwnd);
-        BuildVertexBuffer();
-        BuildInstanceBuffer();
-        BuildDescriptorHeap();
-        BuildVSConstBuffer();
-        InitFence();
-        BuildTextureResource();
-        WaitForGPU();
+        // Device objects, independent of assets and the scene
+        timed(L"root signature", InitRootSignature);
+        timed(L"depth buffer", InitDepthBuffer);
+        timed(L"pipeline state", InitPipelineState);
+        timed(L"command list", InitCommandList);
+        timed(L"vertex buffer", BuildVertexBuffer);
+        timed(L"descriptor heap", BuildDescriptorHeap);
+        timed(L"fence", InitFence);
+        timed(L"upload scheduler", BuildUploadScheduler);
+
+        // The texture only needs the upload scheduler
+        BuildTextureResource(
+            timed(L"wait for texture", [] { return texture_task.get(); }));
+
+        // The rest depends on the scene
+        InitSceneElements(hwnd,
+            timed(L"wait for scene", [] { return scene_task.get(); }));
+        timed(L"instance buffer", BuildInstanceBuffer);
+        timed(L"upload ring", BuildUploadRing);
+        InitConstBufferData();
+        InitAudio(timed(L"wait for music", [] { return music_task.get(); }));
+
+        // Uploads run on the frame queue, ahead of the first frame,
+        // so there is no need to wait for them.
+        upload_scheduler->flush();
+        timed(L"first frame", StartFramePipeline);
+        timed(L"static ranges", BuildStaticRanges);
     }
 
     /*
      * Prepares a list of commands to be executed.
      */
-    void PrepareCommandList() {
+    void PrepareCommandList(const frame_snapshot_t& snapshot) {
+        PROFILE_SCOPE(record_commands);
         hr_check(cmd_allocators[back_buffer_idx]->Reset());
 
         hr_check(cmd_list->Reset(
@@ -926,13 +1750,10 @@ namespace {
         ID3D12DescriptorHeap* ppHeaps[] = { descriptor_heap.Get() };
         cmd_list->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
+        cmd_list->SetGraphicsRootConstantBufferView(
+            0, frame_const_buffer_address);
         D3D12_GPU_DESCRIPTOR_HANDLE gpu_desc_handle =
             descriptor_heap->GetGPUDescriptorHandleForHeapStart();
-        cmd_list->SetGraphicsRootDescriptorTable(
-            0, gpu_desc_handle);
-        gpu_desc_handle.ptr +=
-            d3d12_device->GetDescriptorHandleIncrementSize(
-                D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
         cmd_list->SetGraphicsRootDescriptorTable(
             1, gpu_desc_handle);
 
@@ -971,12 +1792,39 @@ namespace {
         cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         cmd_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
         cmd_list->IASetVertexBuffers(1, 1, &instance_buffer_view);
-        cmd_list->DrawInstanced(
-            static_cast<UINT>(base_square_data.size()),
-            static_cast<UINT>(instances.size()),
-            0, 
-            0
-        );
+        const UINT64 first = instance_allocator->get_offset(static_instance_ranges[back_buffer_idx]);
+        if (instance_sorter) {
+            // a draw per run of clusters, nearest first
+            for (const instance_range_t& range : snapshot.static_order) {
+                cmd_list->DrawInstanced(
+                    static_cast<UINT>(base_square_data.size()),
+                    range.count,
+                    0,
+                    static_cast<UINT>(first + range.first)
+                );
+            }
+        }
+        else {
+            // the selected tiles start the static range, the rest of it
+            // is left over from the level
+            cmd_list->DrawInstanced(
+                static_cast<UINT>(base_square_data.size()),
+                static_cast<UINT>(tile_lod
+                    ? static_range_states[back_buffer_idx].lod_instance_count
+                    : static_instance_count),
+                0, 
+                static_cast<UINT>(first)
+            );
+        }
+        if (dynamic_instance_buffer_view.SizeInBytes > 0) {
+            cmd_list->IASetVertexBuffers(1, 1, &dynamic_instance_buffer_view);
+            cmd_list->DrawInstanced(
+                static_cast<UINT>(base_square_data.size()),
+                static_cast<UINT>(instance_count - static_instance_count),
+                0,
+                0
+            );
+        }
 
         // Use the back buffer to be present.
         resource_barrier.Transition.StateBefore
@@ -988,26 +1836,588 @@ namespace {
         hr_check(cmd_list->Close());
     }
 
+    /*
+     * Writes the percentiles of every measured phase to the debugger output.
+     */
+    void LogProfile() {
+        WCHAR line[256];
+        for (size_t i = 0; i < static_cast<size_t>(profile_phase_t::count); i++) {
+            const profile_phase_t phase = static_cast<profile_phase_t>(i);
+            const Profiler::percentiles_t percentiles = profiler->get_percentiles(phase);
+            if (percentiles.samples == 0) {
+                continue;
+            }
+            swprintf_s(line, L"[profile] %-16S p50 %.3f ms, p95 %.3f ms, p99 %.3f ms (%zu samples)\n",
+                Profiler::get_phase_name(phase), percentiles.p50_ms,
+                percentiles.p95_ms, percentiles.p99_ms, percentiles.samples);
+            OutputDebugStringW(line);
+        }
+        swprintf_s(line, L"[profile] %llu events lost\n", profiler->get_lost_events());
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Writes the checksum of the frames simulated from input, and how
+     * many there were, to the debugger output. A recording stopped by
+     * Esc matches its replay, which ends with the recorded frames.
+     */
+    void LogChecksum() {
+        if (checksum_frames == 0) {
+            return;
+        }
+        WCHAR line[128];
+        swprintf_s(line, L"[input] frame checksum %016llx over %llu frames\n",
+            simulation_checksum, checksum_frames);
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Mixes fixed emitters around a still listener, some of them moving
+     * fast enough to reach the lag limit of the Doppler effect, and
+     * logs the checksum of the 16-bit samples, compared with
+     * AUDIO_MIX_CHECKSUM when there are golden frames. The mixer
+     * runs on the audio thread while frames are rendered, so mixing
+     * more of it must not allocate either.
+     */
+    bool CheckAudioMix() {
+        constexpr UINT CLIP_FRAMES = 22050;
+        constexpr UINT MIX_FRAMES = 4 * AUDIO_SAMPLE_RATE;
+        // a sawtooth on the left and a square wave on the right,
+        // so the check does not depend on the sine of the C library
+        std::vector<float> clip(2 * CLIP_FRAMES);
+        for (UINT i = 0; i < CLIP_FRAMES; i++) {
+            clip[2 * i] = static_cast<float>(i % 100) / 50.0f - 1.0f;
+            clip[2 * i + 1] = i % 64 < 32 ? 0.5f : -0.5f;
+        }
+        AudioMixer mixer(AUDIO_SAMPLE_RATE);
+        const size_t music = mixer.add_clip(std::move(clip), CLIP_FRAMES);
+        mixer.set_listener({ 0.0f, 1.5f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f });
+        const XMFLOAT3 emitters[][2] = {
+            { { -3.0f, 2.0f, 4.0f }, { 0.0f, 0.0f, 0.0f } },
+            { { 5.0f, 2.0f, 1.0f }, { -60.0f, 0.0f, 0.0f } },
+            { { 0.0f, 2.0f, -8.0f }, { 0.0f, 0.0f, -90.0f } },
+            { { 40.0f, 2.0f, 40.0f }, { 0.0f, 0.0f, 0.0f } },
+            { { 2.0f, 0.0f, 2.0f }, { 30.0f, 0.0f, 30.0f } },
+        };
+        for (const auto& [position, velocity] : emitters) {
+            mixer.set_emitter(mixer.add_emitter(music, position), position, velocity);
+        }
+        std::vector<FLOAT> mix(2 * MIX_FRAMES);
+        mixer.render(mix.data(), MIX_FRAMES);
+        std::vector<SHORT> pcm(mix.size());
+        for (size_t i = 0; i < mix.size(); i++) {
+            pcm[i] = static_cast<SHORT>(std::lround(std::clamp(mix[i], -1.0f, 1.0f) * 32767.0f));
+        }
+        const UINT64 checksum = fnv1a(pcm.data(), pcm.size() * sizeof(SHORT));
+        const allocation_stats_t before = get_total_allocation_stats();
+        mixer.render(mix.data(), MIX_FRAMES);
+        const UINT64 mix_allocations = get_total_allocation_stats().count - before.count;
+        const bool compare = !raster_golden_path.empty();
+        WCHAR line[192];
+        swprintf_s(line, compare
+            ? L"[audio] mix checksum %016llx, expected %016llx\n"
+            : L"[audio] mix checksum %016llx\n", checksum, AUDIO_MIX_CHECKSUM);
+        OutputDebugStringW(line);
+        swprintf_s(line, L"[alloc] %llu allocations in %u mixed frames\n",
+            mix_allocations, MIX_FRAMES);
+        OutputDebugStringW(line);
+        return (!compare || checksum == AUDIO_MIX_CHECKSUM) && mix_allocations == 0;
+    }
+
+    /*
+     * Moves a white lamp along a corridor much longer than its range in
+     * the lighting cache, and changes its color halfway, comparing the
+     * colors the cache keeps with a full relight every frame. The level
+     * of the scene is shorter than that range, so there a moving lamp
+     * relights all of it.
+     */
+    bool CheckLightingCache() {
+        constexpr UINT CHECK_FRAMES = 120;
+        const rectangle_desc_t corridor[] = {
+            { { -2.0f, -1.0f, -200.0f }, { 2.0f, -1.0f, 200.0f }, { 0.0f, 0.0f }, true, 1.0f },
+        };
+        const std::vector<square_instance_t> tiles = Scene::build_static_instances(corridor, *job_system);
+        LightingCache cache(tiles);
+        std::vector<XMFLOAT4> colors(tiles.size());
+        std::vector<tile_lighting_t> refreshed;
+        std::vector<tile_lighting_t> expected;
+        vs_const_buffer_t constants = vs_const_buffer_cpu_data;
+        UINT64 relit_tiles = 0;
+        FLOAT largest_difference = 0.0f;
+        for (UINT frame = 0; frame < CHECK_FRAMES; frame++) {
+            constants.pointLight[0] = { 0.0f, 2.0f, -150.0f + 2.5f * frame, 0.0f };
+            constants.colLight[0] = frame < CHECK_FRAMES / 2
+                ? XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f) : XMFLOAT4(0.25f, 1.0f, 0.5f, 1.0f);
+            cache.update(constants, *job_system, refreshed);
+            relit_tiles += refreshed.size();
+            for (const tile_lighting_t& tile : refreshed) {
+                colors[tile.tile] = tile.color;
+            }
+            LightingCache(tiles).update(constants, *job_system, expected);
+            for (const tile_lighting_t& tile : expected) {
+                const XMFLOAT4& kept = colors[tile.tile];
+                largest_difference = (std::max)({ largest_difference, std::abs(kept.x - tile.color.x),
+                    std::abs(kept.y - tile.color.y), std::abs(kept.z - tile.color.z) });
+            }
+        }
+        const double relit_per_frame = static_cast<double>(relit_tiles) / CHECK_FRAMES;
+        WCHAR line[160];
+        swprintf_s(line, L"[cache] check: %.1f of %zu tiles relit per frame, "
+            L"largest difference %.2f of a step\n",
+            relit_per_frame, cache.get_tile_count(), largest_difference / LightingCache::COLOR_STEP);
+        OutputDebugStringW(line);
+        return relit_per_frame < cache.get_tile_count() && largest_difference < LightingCache::COLOR_STEP;
+    }
+
+    /*
+     * GPU stand-in of the ring checks. Fence values complete when the
+     * check says so, or when the CPU waits for them.
+     */
+    class ManualFrameFence : public FrameFence {
+    public:
+        UINT64 get_completed_value() override {
+            return completed_value;
+        }
+
+        void wait_for_value(UINT64 value) override {
+            waits++;
+            complete(value);
+        }
+
+        void complete(UINT64 value) {
+            completed_value = (std::max)(completed_value, value);
+        }
+
+        UINT64 completed_value = 0;
+        UINT waits = 0;
+    };
+
+    /*
+     * Drives a frame ring through frames of uneven allocations over a
+     * fence two frames behind, so the ring wraps around and waits for
+     * the fence. Allocations must be aligned, inside the ring and apart
+     * from those of the frames the fence has not passed. Once the fence
+     * passes every frame the ring must be empty, and while it is stalled
+     * the ring must wait rather than queue more frames than it keeps.
+     */
+    bool CheckFrameRing() {
+        constexpr UINT64 CAPACITY = 4096;
+        constexpr UINT CHECK_FRAMES = 1000;
+        constexpr UINT ALLOCATIONS_PER_FRAME = 3;
+        constexpr UINT64 GPU_LAG = 2;
+        ManualFrameFence fence;
+        FrameRing ring(CAPACITY, fence);
+        struct range_t {
+            UINT64 offset;
+            UINT64 size;
+            UINT64 fence_value;
+        };
+        std::vector<range_t> in_flight;
+        bool apart = true;
+        UINT wraps = 0;
+        UINT64 last_offset = 0;
+        UINT64 fence_value = 0;
+        for (UINT frame = 0; frame < CHECK_FRAMES; frame++) {
+            fence.complete(fence_value - (std::min)(fence_value, GPU_LAG));
+            ring.begin_frame();
+            for (UINT i = 0; i < ALLOCATIONS_PER_FRAME; i++) {
+                const UINT64 size = 1 + (37 * frame + 101 * i) % 700;
+                const UINT64 alignment = UINT64(1) << ((frame + i) % 9);
+                const UINT64 offset = ring.allocate(size, alignment);
+                // the ring may have waited for the fence to pass frames
+                std::erase_if(in_flight, [&](const range_t& range) {
+                    return range.fence_value <= fence.completed_value;
+                });
+                apart = apart && offset % alignment == 0 && offset + size <= CAPACITY;
+                for (const range_t& range : in_flight) {
+                    apart = apart && (offset + size <= range.offset || range.offset + range.size <= offset);
+                }
+                wraps += offset < last_offset;
+                last_offset = offset;
+                in_flight.push_back({ offset, size, fence_value + 1 });
+            }
+            ring.end_frame(++fence_value);
+        }
+        const UINT lag_waits = fence.waits;
+
+        fence.complete(fence_value);
+        ring.begin_frame();
+        const bool drained = ring.get_used() == 0 && ring.get_frames_in_flight() == 0;
+
+        for (size_t frame = 0; frame <= FrameRing::MAX_FRAMES_IN_FLIGHT; frame++) {
+            ring.begin_frame();
+            ring.allocate(16, 16);
+            ring.end_frame(++fence_value);
+        }
+        const bool limited = ring.get_frames_in_flight() == FrameRing::MAX_FRAMES_IN_FLIGHT
+            && fence.waits == lag_waits + 1;
+
+        WCHAR line[160];
+        swprintf_s(line, L"[ring] check: %u frames, %u wraps, %u waits for the fence, %s, %s\n",
+            CHECK_FRAMES, wraps, lag_waits, drained ? L"drained" : L"not drained",
+            limited ? L"frames limited" : L"frames not limited");
+        OutputDebugStringW(line);
+        return apart && wraps > 0 && lag_waits > 0 && drained && limited;
+    }
+
+    /*
+     * GPU stand-in of the upload check. Batches get the next fence
+     * value, which completes them once the check passes it.
+     */
+    class ManualUploadQueue : public UploadQueue {
+    public:
+        void begin_batch() override {
+            batch_bytes = 0;
+            batch_uploads = 0;
+        }
+
+        UINT64 submit_batch() override {
+            if (batch_uploads > 1) {
+                largest_batch = (std::max)(largest_batch, batch_bytes);
+            }
+            return ++submitted_value;
+        }
+
+        UINT64 submitted_value = 0;
+        UINT64 batch_bytes = 0;
+        UINT batch_uploads = 0;
+        UINT64 largest_batch = 0;   // of the batches of several uploads
+    };
+
+    /*
+     * Streams uploads of uneven sizes through an upload scheduler over
+     * a fence two batches behind. Staging space must not be written
+     * while a batch the fence has not passed copies out of it, batches
+     * of several uploads must keep to the byte budget, and an upload
+     * must be complete exactly when the fence passes its batch. At the
+     * end, finish must complete every upload.
+     */
+    bool CheckUploadScheduler() {
+        constexpr UINT64 CAPACITY = 4096;
+        constexpr UINT64 FRAME_BUDGET = 1024;
+        constexpr UINT CHECK_FRAMES = 200;
+        constexpr UINT UPLOAD_FRAMES = 150;
+        constexpr UINT UPLOADS_PER_FRAME = 3;
+        constexpr UINT64 GPU_LAG = 2;
+        std::vector<BYTE> staging(CAPACITY);
+        ManualFrameFence fence;
+        ManualUploadQueue queue;
+        UploadScheduler scheduler(staging.data(), CAPACITY, FRAME_BUDGET, queue, fence);
+        struct range_t {
+            UINT64 offset;
+            UINT64 size;
+            UINT64 fence_value;
+        };
+        std::vector<range_t> copying;
+        std::vector<UINT64> ticket_fence_values;    // 0 until the upload is recorded
+        bool apart = true;
+        bool completion_matches = true;
+        UINT wraps = 0;
+        UINT64 last_offset = 0;
+        for (UINT frame = 0; frame < CHECK_FRAMES; frame++) {
+            for (UINT i = 0; frame < UPLOAD_FRAMES && i < UPLOADS_PER_FRAME; i++) {
+                const size_t index = ticket_fence_values.size();
+                const UINT64 size = 1 + (97 * index) % 900;
+                const UINT64 alignment = UINT64(1) << (index % 5);
+                ticket_fence_values.push_back(0);
+                const UINT64 ticket = scheduler.enqueue({ size, alignment,
+                    [&, size](BYTE* data) {
+                        const UINT64 offset = data - staging.data();
+                        std::erase_if(copying, [&](const range_t& range) {
+                            return range.fence_value <= fence.completed_value;
+                        });
+                        for (const range_t& range : copying) {
+                            apart = apart && (offset + size <= range.offset || range.offset + range.size <= offset);
+                        }
+                    },
+                    [&, index, size](UINT64 offset) {
+                        queue.batch_bytes += size;
+                        queue.batch_uploads++;
+                        copying.push_back({ offset, size, queue.submitted_value + 1 });
+                        ticket_fence_values[index] = queue.submitted_value + 1;
+                        wraps += offset < last_offset;
+                        last_offset = offset;
+                    } });
+                completion_matches = completion_matches && ticket == index + 1;
+            }
+            scheduler.flush();
+            fence.complete(queue.submitted_value - (std::min)(queue.submitted_value, GPU_LAG));
+            for (UINT64 ticket = 1; ticket <= ticket_fence_values.size(); ticket++) {
+                const UINT64 fence_value = ticket_fence_values[ticket - 1];
+                completion_matches = completion_matches && scheduler.is_complete(ticket)
+                    == (fence_value != 0 && fence_value <= fence.completed_value);
+            }
+        }
+        scheduler.finish();
+        const bool finished = scheduler.get_pending_count() == 0 && scheduler.get_pending_bytes() == 0
+            && scheduler.is_complete(ticket_fence_values.size());
+
+        WCHAR line[192];
+        swprintf_s(line, L"[upload] check: %zu uploads in %llu batches, %u wraps, "
+            L"largest batch %llu of %llu bytes\n",
+            ticket_fence_values.size(), queue.submitted_value, wraps, queue.largest_batch, FRAME_BUDGET);
+        OutputDebugStringW(line);
+        return apart && completion_matches && finished && wraps > 0 && queue.largest_batch <= FRAME_BUDGET;
+    }
+
+    /*
+     * Writes the tiles relit by the lighting cache per simulated frame
+     * to the debugger output.
+     */
+    void LogLightingCache() {
+        if (!lighting_cache) {
+            return;
+        }
+        WCHAR line[128];
+        swprintf_s(line, L"[cache] %.1f of %zu tiles relit per frame over %llu frames\n",
+            static_cast<double>(cache_stats.relit_tiles) / (std::max)(cache_stats.updates, UINT64(1)),
+            lighting_cache->get_tile_count(), cache_stats.updates);
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Writes the static instances drawn per rendered frame by the tile
+     * LOD and how often the selection changed to the debugger output.
+     */
+    void LogTileLod() {
+        if (!tile_lod) {
+            return;
+        }
+        WCHAR line[160];
+        swprintf_s(line, L"[lod] %.1f of %zu tiles drawn per frame, %llu of %llu selections changed\n",
+            static_cast<double>(render_stats.drawn_instances) / (std::max)(render_stats.frames, UINT64(1))
+            - static_cast<double>(instance_count - static_instance_count),
+            tile_lod->get_tile_count(), lod_stats.changes, lod_stats.selections);
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Writes the frames whose instances were sorted again, and not drawn
+     * in the order of an earlier frame, to the debugger output.
+     */
+    void LogInstanceSorting() {
+        if (!instance_sorter) {
+            return;
+        }
+        WCHAR line[128];
+        swprintf_s(line, L"[sort] %llu of %llu frames sorted, %zu clusters\n",
+            sort_stats.sorts, sort_stats.frames, instance_sorter->get_cluster_count());
+        OutputDebugStringW(line);
+    }
+
+    /*
+     * Instances drawn in a frame: the static ones, those selected by
+     * the tile LOD or those in range of the sort, and the dynamic ones.
+     */
+    size_t GetDrawnInstanceCount(const frame_snapshot_t& snapshot) {
+        size_t static_count = tile_lod ? lod_instance_count : static_instance_count;
+        if (instance_sorter) {
+            static_count = 0;
+            for (const instance_range_t& range : snapshot.static_order) {
+                static_count += range.count;
+            }
+        }
+        return static_count + (instance_count - static_instance_count);
+    }
+
+    /*
+     * Renders a headless frame with the software rasterizer like
+     * RenderFrame draws it and keeps the checksum of the image.
+     */
+    void RasterizeFrame(const frame_snapshot_t& snapshot,
+        std::span<const square_instance_t> static_instances, UINT frame) {
+        PROFILE_SCOPE(rasterize);
+        if (instance_sorter) {
+            // tiles of the rasterizer draw their triangles in submission
+            // order, like the draws of the clusters one after another
+            sorted_instances.clear();
+            for (const instance_range_t& range : snapshot.static_order) {
+                sorted_instances.insert(sorted_instances.end(),
+                    static_instances.begin() + range.first,
+                    static_instances.begin() + range.first + range.count);
+            }
+            static_instances = sorted_instances;
+        }
+        rasterizer->clear(clear_color);
+        rasterizer->draw(snapshot.constants, base_square_data, static_instances);
+        rasterizer->draw(snapshot.constants, base_square_data, snapshot.dynamic_instances);
+        raster_overdraw += rasterizer->get_overdraw();
+        const std::span<const UINT32> pixels = rasterizer->get_pixels();
+        raster_checksums.push_back(fnv1a(pixels.data(), pixels.size_bytes()));
+
+        if (frame % RASTER_IMAGE_INTERVAL == 0) {
+            WCHAR suffix[32];
+            swprintf_s(suffix, L"%05u.ppm", frame);
+            rasterizer->write_ppm((raster_output_prefix + suffix).c_str());
+        }
+    }
+
+    /*
+     * Writes the checksums of the rasterized frames, one per line, and
+     * compares them with the golden ones if there are any. Returns false
+     * if a frame differs or the number of frames does not match.
+     */
+    bool CheckRasterChecksums() {
+        std::ofstream file{ std::filesystem::path(raster_output_prefix + L"checksums.txt") };
+        char text[32];
+        for (UINT64 checksum : raster_checksums) {
+            snprintf(text, sizeof(text), "%016llx\n", checksum);
+            file << text;
+        }
+        if (raster_golden_path.empty()) {
+            return true;
+        }
+
+        std::ifstream golden{ std::filesystem::path(raster_golden_path) };
+        std::vector<UINT64> expected;
+        std::string value;
+        while (golden >> value) {
+            expected.push_back(std::strtoull(value.c_str(), nullptr, 16));
+        }
+
+        // the first differences are listed
+        constexpr size_t MAX_LISTED = 10;
+        size_t differences = 0;
+        WCHAR line[128];
+        for (size_t i = 0; i < (std::max)(expected.size(), raster_checksums.size()); i++) {
+            if (i < expected.size() && i < raster_checksums.size()
+                && expected[i] == raster_checksums[i]) {
+                continue;
+            }
+            if (differences++ < MAX_LISTED) {
+                swprintf_s(line, L"[raster] frame %zu differs from the golden image\n", i);
+                OutputDebugStringW(line);
+            }
+        }
+        swprintf_s(line, L"[raster] %zu of %zu frames differ, %zu golden frames\n",
+            differences, raster_checksums.size(), expected.size());
+        OutputDebugStringW(line);
+        return differences == 0;
+    }
+
+    allocation_snapshot_t TakeAllocationSnapshot() {
+        allocation_snapshot_t snapshot;
+        for (size_t i = 0; i < ALLOCATION_SLOTS; i++) {
+            snapshot[i] = get_allocation_stats(static_cast<profile_phase_t>(i));
+        }
+        return snapshot;
+    }
+
+    /*
+     * Writes the heap allocations of every phase since `since` to the
+     * debugger output. Returns the number of allocations.
+     */
+    UINT64 LogAllocations(const allocation_snapshot_t& since) {
+        const allocation_snapshot_t now = TakeAllocationSnapshot();
+        UINT64 total = 0;
+        WCHAR line[256];
+        for (size_t i = 0; i < ALLOCATION_SLOTS; i++) {
+            const UINT64 count = now[i].count - since[i].count;
+            if (count == 0) {
+                continue;
+            }
+            const profile_phase_t phase = static_cast<profile_phase_t>(i);
+            swprintf_s(line, L"[alloc] %-16S %llu allocations, %llu bytes\n",
+                phase == profile_phase_t::count ? "other" : Profiler::get_phase_name(phase),
+                count, now[i].bytes - since[i].bytes);
+            OutputDebugStringW(line);
+            total += count;
+        }
+        return total;
+    }
+
+    /*
+     * Writes the totals of the rendered frames and the phase percentiles
+     * to the benchmark report, as comma-separated values.
+     */
+    void WriteBenchmarkReport() {
+        std::ofstream file{ std::filesystem::path(benchmark_report_path) };
+        const UINT64 frames = (std::max)(render_stats.frames, UINT64(1));
+        char line[256];
+        snprintf(line, sizeof(line),
+            "frames,%llu\nframe_checksum,%016llx\n"
+            "instances_per_frame,%.1f\nupload_bytes_per_frame,%.1f\n"
+            "relit_tiles_per_frame,%.1f\n\n",
+            render_stats.frames, simulation_checksum,
+            static_cast<double>(render_stats.drawn_instances) / frames,
+            static_cast<double>(render_stats.upload_bytes) / frames,
+            static_cast<double>(cache_stats.relit_tiles) / (std::max)(cache_stats.updates, UINT64(1)));
+        file << line << "phase,p50_ms,p95_ms,p99_ms,samples\n";
+        for (size_t i = 0; i < static_cast<size_t>(profile_phase_t::count); i++) {
+            const profile_phase_t phase = static_cast<profile_phase_t>(i);
+            const Profiler::percentiles_t percentiles = profiler->get_percentiles(phase);
+            if (percentiles.samples == 0) {
+                continue;
+            }
+            snprintf(line, sizeof(line), "%s,%.3f,%.3f,%.3f,%zu\n",
+                Profiler::get_phase_name(phase), percentiles.p50_ms,
+                percentiles.p95_ms, percentiles.p99_ms, percentiles.samples);
+            file << line;
+        }
+
+        const std::wstring message = (file ? L"[benchmark] report written to "
+            : L"[benchmark] cannot write ") + benchmark_report_path + L"\n";
+        OutputDebugStringW(message.c_str());
+    }
+
     /*
      * Renders a single animation frame
      */
     void RenderFrame() {
-        PrepareCommandList();
+        PROFILE_SCOPE(frame);
+
+        // Take the oldest simulated frame not yet rendered, or the last
+        // one again if there is none. Frames are rendered in order, so
+        // the tiles relit by the lighting cache in every frame reach the
+        // instances of the back buffers.
+        const size_t slot = frame_pipeline->acquire();
+        UploadFrameData(frame_snapshots[slot]);
+        if (lighting_cache || tile_lod) {
+            render_stats.upload_bytes += UpdateStaticRange(frame_snapshots[slot]);
+        }
+
+        // Submit pending uploads ahead of the frame
+        {
+            PROFILE_SCOPE(flush_uploads);
+            const UINT64 pending_bytes = upload_scheduler->get_pending_bytes();
+            upload_scheduler->flush();
+            render_stats.upload_bytes += pending_bytes
+                - upload_scheduler->get_pending_bytes();
+        }
+
+        // Every instance is drawn, there is no culling
+        render_stats.frames++;
+        render_stats.drawn_instances += GetDrawnInstanceCount(frame_snapshots[slot]);
+        render_stats.upload_bytes += VS_CONST_BUFFER_SIZE
+            + (instance_count - static_instance_count) * sizeof(square_instance_t);
+
+        PrepareCommandList(frame_snapshots[slot]);
 
         // Execute command list
-        ID3D12CommandList* tmp_cmd_list = cmd_list.Get();
-        cmd_queue->ExecuteCommandLists(1, &tmp_cmd_list);
+        {
+            PROFILE_SCOPE(execute);
+            ID3D12CommandList* tmp_cmd_list = cmd_list.Get();
+            cmd_queue->ExecuteCommandLists(1, &tmp_cmd_list);
+        }
 
         // Present the frame buffer
-        hr_check(swap_chain->Present(1, 0));
+        {
+            PROFILE_SCOPE(present);
+            hr_check(swap_chain->Present(1, 0));
+        }
 
         // Synchronize with the previous frame
         PrepareNextFrame();
+        frame_pipeline->release();
     }
 };
 
 
-void InitDirect3D(HWND hwnd) {
+bool InitDirect3D(HWND hwnd) {
+    ScopeTimer startup_timer(L"startup");
+    profiler = std::make_unique<Profiler>();
+    StartLoadingTasks();
+
     UINT dxgi_factory_flag = 0;
 
 #ifdef DX12_DEBUG
@@ -1020,8 +2430,10 @@ void InitDirect3D(HWND hwnd) {
 #endif /* DX12_DEBUG */
 
     // Create a Direct3D 12 device.
-    hr_check(D3D12CreateDevice(
-        nullptr, MIN_FEATURE_LEVEL, IID_PPV_ARGS(&d3d12_device)));
+    timed(L"device", [] {
+        hr_check(D3D12CreateDevice(
+            nullptr, MIN_FEATURE_LEVEL, IID_PPV_ARGS(&d3d12_device)));
+    });
 
     // Create a DirectX Graphics Infrastructure factory.
     hr_check(CreateDXGIFactory2(
@@ -1097,7 +2509,18 @@ void InitDirect3D(HWND hwnd) {
             D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&cmd_allocators[k])));
     }
 
-    InitGraphicsResources(hwnd);
+    // a loading task that failed throws out of its future here,
+    // hr_check cannot quit from the threads of the tasks
+    try {
+        InitGraphicsResources(hwnd);
+    }
+    catch (const char* message) {
+        WCHAR line[128];
+        swprintf_s(line, L"[startup] %hs\n", message);
+        OutputDebugStringW(line);
+        return false;
+    }
+    return true;
 }
 
 void InitTimer(HWND hwnd) {
@@ -1105,56 +2528,423 @@ void InitTimer(HWND hwnd) {
 }
 
 
-void OnTimer() {
-    if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) {
-        PostQuitMessage(0);
-	}
+void OnTimer(HWND hwnd) {
+    // Closing the window ends the frames and writes their reports,
+    // a replay or a camera path ends the application as Esc does
+    if ((GetAsyncKeyState(VK_ESCAPE) & 0x8000) || run_finished) {
+        DestroyWindow(hwnd);
+        return;
+    }
 
-    // Change animation time.
-    camera->update();
-    scene->update_instances();
-    instances = scene->get_instances();
-    // modify instance buffer
-    UINT8* dst_data = nullptr;
-    D3D12_RANGE read_range = { 0, 0 };
-    hr_check(instance_buffer->Map(
-		0, &read_range, reinterpret_cast<void**>(&dst_data)
-	));
-    memcpy(dst_data, instances.data(), instances.size() * sizeof(square_instance_t));
-    instance_buffer->Unmap(0, nullptr);
-    
-    // Compute transformation matrices.
-    XMMATRIX vp_matrix = XMMatrixMultiply(
-        camera->get_view_matrix(),                                 // View
-        XMMatrixPerspectiveFovLH(                                  // Projection
-            45.0f, viewport.Width / viewport.Height, 0.5f, 50.0f)
-    );
-
-    vp_matrix = XMMatrixTranspose(vp_matrix);
-
-    // Update the constant buffer of vertex shader.
-    XMStoreFloat4x4(&vs_const_buffer_cpu_data.matViewProj, vp_matrix);
-    XMStoreFloat4x4(&vs_const_buffer_cpu_data.matView, XMMatrixTranspose(camera->get_view_matrix()));
-    auto colors = scene->get_lamp_colors();
-    auto positions = scene->get_lamp_positions();
-    for (int i = 0; i < 7; i++) {
-        vs_const_buffer_cpu_data.colLight[i] = colors[i];
-        vs_const_buffer_cpu_data.pointLight[i] = positions[i];
-        // make light slightly lower to better illuminate the ceiling
-        vs_const_buffer_cpu_data.pointLight[i].y -= 0.25;
-    }
-    memcpy(vs_const_buffer_data, &vs_const_buffer_cpu_data,
-        sizeof(vs_const_buffer_cpu_data));
+    // Simulate the next frame on the pipeline worker.
+    frame_pipeline->tick();
 }
 
 void ReleaseTimer(HWND hwnd) {
     KillTimer(hwnd, ID_TIMER);
+    // the window is destroyed without frames if InitDirect3D failed
+    if (!frame_pipeline) {
+        return;
+    }
+    frame_pipeline->stop();
+
+    // Finish the recording
+    input.reset();
 }
 
 void OnPaint() {
     RenderFrame();
+    profiler->collect();
+    if (render_stats.frames == ALLOCATION_WARMUP_FRAMES) {
+        warm_allocations = TakeAllocationSnapshot();
+    }
 }
 
 void EndDirect3D() {
+    if (!frame_pipeline) {
+        return;
+    }
     WaitForGPU();
+    profiler->collect();
+    LogProfile();
+    profiler->write_chrome_trace(L"frame_trace.json");
+    profiler->write_csv(L"frame_phases.csv");
+    LogAllocations({});
+
+    // steady-state frames, the audio thread included,
+    // must not touch the heap either
+    if (render_stats.frames > ALLOCATION_WARMUP_FRAMES) {
+        OutputDebugStringW(L"[alloc] after the warm-up:\n");
+        const UINT64 steady_allocations = LogAllocations(warm_allocations);
+        WCHAR line[128];
+        swprintf_s(line, L"[alloc] %llu allocations in %llu steady-state frames\n",
+            steady_allocations, render_stats.frames - ALLOCATION_WARMUP_FRAMES);
+        OutputDebugStringW(line);
+    }
+    LogChecksum();
+    LogLightingCache();
+    LogTileLod();
+    LogInstanceSorting();
+    if (camera_path) {
+        WriteBenchmarkReport();
+    }
+}
+
+void SetLightingCache() {
+    lighting_cache_enabled = true;
+}
+
+void SetPerPixelLighting() {
+    per_pixel_lighting = true;
+}
+
+void SetAdaptiveTiles() {
+    adaptive_tiles = true;
+}
+
+void SetTileLod() {
+    tile_lod_enabled = true;
+}
+
+void SetInstanceSorting() {
+    instance_sorting = true;
+}
+
+void SetInputRecording(PCWSTR path) {
+    input_recording_path = path;
+}
+
+bool SetInputReplay(PCWSTR path) {
+    try {
+        input = std::make_unique<InputReplay>(path);
+    }
+    catch (const char*) {
+        return false;
+    }
+    return true;
+}
+
+void SetSoftwareRendering(PCWSTR output_prefix, PCWSTR golden_path) {
+    software_rendering = true;
+    raster_output_prefix = output_prefix;
+    raster_golden_path = golden_path ? golden_path : L"";
+}
+
+bool SetBenchmark(PCWSTR camera_path_file, UINT frame_count, PCWSTR report_path) {
+    try {
+        camera_path = std::make_unique<CameraPath>(CameraPath::load(camera_path_file));
+    }
+    catch (const char*) {
+        return false;
+    }
+    benchmark_frame_count = frame_count;
+    benchmark_report_path = report_path;
+    return true;
+}
+
+void EndAudio() {
+    sound.reset();
+}
+
+bool RunHeadless(UINT frame_count) {
+    bitmap_t texture;
+    if (software_rendering) {
+        try {
+            texture = LoadTexture();
+        }
+        catch (const char*) {
+            return false;
+        }
+    }
+    profiler = std::make_unique<Profiler>();
+    viewport.Width = 1920.0f;
+    viewport.Height = 1080.0f;
+    job_system = std::make_unique<JobSystem>();
+    scene = std::make_unique<Scene>(scene_config, *job_system);
+    PrepareStaticTiles(*scene, *job_system);
+    if (input || camera_path) {
+        camera = std::make_unique<Camera>();
+    }
+    instance_count = scene->get_instance_count();
+    static_instance_count = scene->get_static_instances().size();
+    InitConstBufferData();
+    StartFramePipeline();
+
+    if (software_rendering) {
+        rasterizer = std::make_unique<SoftwareRasterizer>(
+            static_cast<UINT>(viewport.Width), static_cast<UINT>(viewport.Height), *job_system);
+        rasterizer->set_texture(texture.width, texture.height, texture.bits.get());
+        raster_checksums.reserve(frame_count);
+        sorted_instances.reserve(static_instance_count);
+    }
+
+    // Stand-in for the renderer: copies every frame out of its
+    // snapshot and waits for the end of the frame.
+    std::vector<BYTE> frame_data(VS_CONST_BUFFER_SIZE
+        + (instance_count - static_instance_count) * sizeof(square_instance_t));
+    std::vector<square_instance_t> static_instances(
+        scene->get_static_instances().begin(), scene->get_static_instances().end());
+    auto frame_end = std::chrono::steady_clock::now();
+    allocation_snapshot_t steady_state = {};
+    // the rasterizer stands in for the GPU, its allocations after the
+    // warm-up are counted apart from those of the frames
+    UINT64 raster_allocations = 0;
+    // a replay or a camera path runs until it is simulated to the end
+    UINT frames = 0;
+    for (; (input || camera_path) ? !run_finished : frames < frame_count; frames++) {
+        if (frames == ALLOCATION_WARMUP_FRAMES) {
+            steady_state = TakeAllocationSnapshot();
+        }
+        frame_pipeline->tick();
+        if (rasterizer) {
+            // golden images need the same frames whatever the timing
+            frame_pipeline->wait_idle();
+        }
+        {
+            PROFILE_SCOPE(frame);
+            const frame_snapshot_t& snapshot = frame_snapshots[frame_pipeline->acquire()];
+            {
+                PROFILE_SCOPE(upload_frame);
+                memcpy(frame_data.data(), &snapshot.constants, VS_CONST_BUFFER_SIZE);
+                memcpy(frame_data.data() + VS_CONST_BUFFER_SIZE, snapshot.dynamic_instances.data(),
+                    snapshot.dynamic_instances.size() * sizeof(square_instance_t));
+            }
+            if (lighting_cache) {
+                render_stats.upload_bytes += ApplyStaticLighting(snapshot, static_instances.data());
+            }
+            if (tile_lod) {
+                render_stats.upload_bytes += ApplyTileLod(snapshot, static_instances.data());
+            }
+            render_stats.frames++;
+            render_stats.drawn_instances += GetDrawnInstanceCount(snapshot);
+            render_stats.upload_bytes += frame_data.size();
+            if (rasterizer) {
+                // the simulation is idle until the next tick
+                const UINT64 allocations_before = get_total_allocation_stats().count;
+                RasterizeFrame(snapshot, std::span<const square_instance_t>(static_instances)
+                    .first(tile_lod ? lod_instance_count : static_instances.size()), frames);
+                if (frames >= ALLOCATION_WARMUP_FRAMES) {
+                    raster_allocations += get_total_allocation_stats().count - allocations_before;
+                }
+            }
+        }
+        frame_end += std::chrono::milliseconds(INTERVAL);
+        std::this_thread::sleep_until(frame_end);
+        frame_pipeline->release();
+        profiler->collect();
+    }
+    frame_pipeline->stop();
+    profiler->collect();
+
+    // Steady-state frames must not touch the heap
+    const UINT64 steady_allocations = LogAllocations(steady_state) - raster_allocations;
+    WCHAR line[256];
+    swprintf_s(line, L"[alloc] %llu allocations in %u steady-state frames, %llu more by the rasterizer\n",
+        steady_allocations, frames - (std::min)(frames, ALLOCATION_WARMUP_FRAMES), raster_allocations);
+    OutputDebugStringW(line);
+
+    LogProfile();
+    LogChecksum();
+    LogLightingCache();
+    LogTileLod();
+    LogInstanceSorting();
+    if (rasterizer) {
+        swprintf_s(line, L"[raster] overdraw %.3f shaded pixels per pixel\n",
+            raster_overdraw / (std::max)(frames, 1u));
+        OutputDebugStringW(line);
+    }
+    profiler->write_chrome_trace(L"frame_trace.json");
+    profiler->write_csv(L"frame_phases.csv");
+    if (camera_path) {
+        WriteBenchmarkReport();
+    }
+    const bool frames_match = !rasterizer || CheckRasterChecksums();
+    const bool mix_matches = CheckAudioMix();
+    const bool cache_matches = CheckLightingCache();
+    const bool ring_works = CheckFrameRing();
+    const bool uploads_work = CheckUploadScheduler();
+
+    const FramePipeline::stats_t stats = frame_pipeline->get_stats();
+    swprintf_s(line,
+        L"[pipeline] %llu simulated, %llu rendered, %llu repeated, %llu ticks dropped\n"
+        L"[pipeline] simulation %.3f ms/frame, %.1f%% overlapped with rendering\n",
+        stats.simulated_frames, stats.rendered_frames,
+        stats.repeated_frames, stats.dropped_ticks,
+        stats.simulate_ms / (std::max)(stats.simulated_frames, UINT64(1)),
+        stats.simulate_ms > 0.0 ? 100.0 * stats.overlap_ms / stats.simulate_ms : 0.0);
+    OutputDebugStringW(line);
+
+    return frames_match && steady_allocations == 0 && mix_matches && cache_matches
+        && ring_works && uploads_work;
+}
+
+void RunBenchmarks() {
+    viewport.Width = 1920.0f;
+    viewport.Height = 1080.0f;
+    job_system = std::make_unique<JobSystem>();
+    scene = std::make_unique<Scene>(scene_config, *job_system);
+    BakeLighting(*scene, *job_system);
+    // the lights of the first frame, seen from the start of the camera
+    InitConstBufferData();
+    frame_snapshot_t snapshot = {
+        vs_const_buffer_cpu_data,
+        std::vector<square_instance_t>(scene->get_instance_count() - scene->get_static_instances().size())
+    };
+    scene->update(1, INTERVAL);
+    WriteSnapshot(*scene, snapshot, Camera().get_view_matrix());
+
+    benchmark_job_scaling(scene_config, INTERVAL);
+    benchmark_tile_reduction(scene_config, GetFocalLength(), NEAR_PLANE, FAR_PLANE, *job_system);
+    benchmark_light_kernel(snapshot.constants);
+    benchmark_range_allocator();
+    benchmark_bake_edit(scene_config, *scene, light_baker, BAKE_BEATS, *job_system);
+}
+
+bool RenderOffline(PCWSTR output_path, UINT frame_count, PCWSTR camera_path_file) {
+    std::unique_ptr<CameraPath> path;
+    if (camera_path_file) {
+        try {
+            path = std::make_unique<CameraPath>(CameraPath::load(camera_path_file));
+        }
+        catch (const char*) {
+            return false;
+        }
+    }
+    viewport.Width = 1920.0f;
+    viewport.Height = 1080.0f;
+    const UINT width = static_cast<UINT>(viewport.Width);
+    const UINT height = static_cast<UINT>(viewport.Height);
+    InitConstBufferData();
+
+    // PNG images are encoded by WIC on this thread
+    if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED))) {
+        return false;
+    }
+    bitmap_t texture;
+    try {
+        texture = LoadTexture();
+    }
+    catch (const char*) {
+        CoUninitialize();
+        return false;
+    }
+
+    // Every worker renders whole frames with a scene of its own,
+    // which is evaluated at the tick of the frame. The last worker
+    // renders frames again to check that they do not depend on
+    // the worker or on the frames it rendered before.
+    struct offline_worker_t {
+        std::unique_ptr<JobSystem> jobs;
+        std::unique_ptr<Scene> scene;
+        std::unique_ptr<SoftwareRasterizer> rasterizer;
+        Camera camera;
+        frame_snapshot_t snapshot;
+    };
+    const size_t worker_count = (std::max)(std::thread::hardware_concurrency(), 1u);
+    std::vector<offline_worker_t> workers(worker_count + 1);
+    for (offline_worker_t& worker : workers) {
+        worker.jobs = std::make_unique<JobSystem>(1);
+        worker.scene = std::make_unique<Scene>(scene_config, *worker.jobs);
+        if (adaptive_tiles) {
+            SubdivideStaticTiles(*worker.scene, *worker.jobs);
+        }
+        worker.rasterizer = std::make_unique<SoftwareRasterizer>(width, height, *worker.jobs);
+        worker.rasterizer->set_texture(texture.width, texture.height, texture.bits.get());
+        worker.snapshot = {
+            vs_const_buffer_cpu_data,
+            std::vector<square_instance_t>(worker.scene->get_instance_count()
+                - worker.scene->get_static_instances().size())
+        };
+    }
+
+    // the scenes share one bake, adaptive tiles have none
+    if (!adaptive_tiles) {
+        {
+            JobSystem bake_jobs;
+            BakeLighting(*workers.front().scene, bake_jobs);
+        }
+        for (offline_worker_t& worker : workers) {
+            worker.scene->set_static_lighting(light_baker.get_tiles());
+        }
+    }
+    // the other tile options act on the frame pipeline or on the device,
+    // here every frame is drawn from scratch by the rasterizer
+    if (lighting_cache_enabled || per_pixel_lighting || tile_lod_enabled || instance_sorting) {
+        OutputDebugStringW(L"[offline] only the adaptive tiles apply, the other tile options are ignored\n");
+    }
+
+    auto render = [&](size_t index, UINT frame, FrameSequence::pixels_t& pixels) {
+        offline_worker_t& worker = workers[index];
+        worker.scene->update(frame, UINT64(frame) * INTERVAL);
+        if (path) {
+            const camera_pose_t pose = SampleCameraPath(*path, frame, frame_count);
+            worker.camera.set_pose(pose.position, pose.yaw, pose.pitch);
+        }
+        WriteSnapshot(*worker.scene, worker.snapshot, worker.camera.get_view_matrix());
+
+        SoftwareRasterizer& rasterizer = *worker.rasterizer;
+        rasterizer.clear(clear_color);
+        rasterizer.draw(worker.snapshot.constants, base_square_data,
+            worker.scene->get_static_instances());
+        rasterizer.draw(worker.snapshot.constants, base_square_data,
+            worker.snapshot.dynamic_instances);
+        const std::span<const UINT32> image = rasterizer.get_pixels();
+        pixels.assign(image.begin(), image.end());
+    };
+
+    // A .y4m output is one video, anything else the prefix of PNG images
+    std::unique_ptr<Y4mWriter> video;
+    if (std::filesystem::path(output_path).extension() == L".y4m") {
+        video = std::make_unique<Y4mWriter>(output_path, width, height, 1000, INTERVAL);
+    }
+    std::vector<UINT64> frame_checksums;
+    frame_checksums.reserve(frame_count);
+    auto write = [&](UINT frame, FrameSequence::pixels_t& pixels) {
+        frame_checksums.push_back(fnv1a(pixels.data(), pixels.size() * sizeof(UINT32)));
+        if (video) {
+            return video->write(pixels);
+        }
+        // the swap chain ignores alpha, so do the images
+        for (UINT32& pixel : pixels) {
+            pixel |= 0xff000000;
+        }
+        WCHAR suffix[32];
+        swprintf_s(suffix, L"%05u.png", frame);
+        return save_png((output_path + std::wstring(suffix)).c_str(),
+            width, height, reinterpret_cast<const BYTE*>(pixels.data()));
+    };
+
+    // two frames per worker keep all of them busy while one is written
+    const auto start = std::chrono::steady_clock::now();
+    FrameSequence sequence(worker_count, 2 * worker_count);
+    const bool complete = sequence.run(frame_count, render, write);
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    video.reset();
+    CoUninitialize();
+
+    WCHAR line[128];
+    swprintf_s(line, L"[offline] %u frames on %zu threads in %.1f s, %.2f frames/s%s\n",
+        frame_count, worker_count, duration.count(), frame_count / duration.count(),
+        complete ? L"" : L", output failed");
+    OutputDebugStringW(line);
+
+    // Frames rendered by a single worker, in order but skipping
+    // the frames between them, must match those of the sequence
+    FrameSequence::pixels_t check_pixels;
+    size_t differences = 0;
+    UINT checked = 0;
+    for (UINT frame = 0; frame < frame_checksums.size(); frame += OFFLINE_CHECK_INTERVAL) {
+        render(worker_count, frame, check_pixels);
+        if (fnv1a(check_pixels.data(), check_pixels.size() * sizeof(UINT32)) != frame_checksums[frame]) {
+            swprintf_s(line, L"[offline] frame %u differs between 1 and %zu threads\n",
+                frame, worker_count);
+            OutputDebugStringW(line);
+            differences++;
+        }
+        checked++;
+    }
+    swprintf_s(line, L"[offline] %zu of %u frames rendered again on 1 thread differ\n",
+        differences, checked);
+    OutputDebugStringW(line);
+    return complete && differences == 0;
 }
\ No newline at end of file
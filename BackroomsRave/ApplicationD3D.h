@@ -8,8 +8,9 @@
 
 /*
  * Initializes all Direct3D 12 components to run the application.
+ * Returns false if loading the assets or the scene failed.
  */
-void InitDirect3D(HWND hWnd);
+bool InitDirect3D(HWND hWnd);
 
 /*
  * Initializes the animation timer.
@@ -17,12 +18,14 @@ void InitDirect3D(HWND hWnd);
 void InitTimer(HWND hwnd);
 
 /*
- * Computes changes in 3D scene animation state.
+ * Requests the next frame of 3D scene animation,
+ * which is simulated on a worker thread. Destroys `hwnd` instead
+ * once Esc is pressed or a replay or a camera path has ended.
  */
-void OnTimer();
+void OnTimer(HWND hwnd);
 
 /*
- * Destroys the animation timer.
+ * Destroys the animation timer and stops the frame simulation.
  */
 void ReleaseTimer(HWND hwnd);
 
@@ -32,8 +35,164 @@ void ReleaseTimer(HWND hwnd);
 void OnPaint();
 
 /*
- * Finishes the usage of Direct3D 12.
+ * Finishes the usage of Direct3D 12 and writes the frame phase
+ * percentiles and the heap allocations, in total and after the
+ * warm-up frames, to the debugger output. The frame phases are
+ * exported to frame_trace.json and frame_phases.csv, as by RunHeadless.
  */
 void EndDirect3D();
 
+/*
+ * Stops the spatial audio playback.
+ */
+void EndAudio();
+
+/*
+ * Runs the pipelined frame loop without a window or a device
+ * for `frame_count` frames and writes the achieved overlap of
+ * simulation and rendering to the debugger output. The frame
+ * phases are exported to frame_trace.json and frame_phases.csv.
+ * The renderer is a stand-in that copies the frame data out, the
+ * D3D12 frames are only logged by EndDirect3D. The audio mixer
+ * is checked by mixing a fixed scene, which must match a recorded
+ * checksum along with golden frames, the lighting cache by moving a
+ * lamp along a long corridor, which must relight only some of its
+ * tiles, and the frame ring and the upload scheduler over a stand-in
+ * fence and queue. Returns false if a frame after the warm-up or the
+ * mixer allocated memory, if the mix differs, if the cache relit
+ * every tile or drifted, if the ring handed out space still in use or
+ * if the uploads broke their budget or completed out of step with
+ * the fence.
+ */
+bool RunHeadless(UINT frame_count);
+
+/*
+ * Measures the scene jobs, the tile reductions, the light kernel, the
+ * instance allocator and the bake of a level edit on the default scene
+ * with its uniform baked tiles, whatever the tile options, and writes
+ * the results to the debugger output.
+ */
+void RunBenchmarks();
+
+/*
+ * Makes RunHeadless render every frame with the software rasterizer.
+ * The checksums of the frames are written to
+ * `<output_prefix>checksums.txt` and every 100th frame to
+ * `<output_prefix><frame>.ppm`. If `golden_path` is not null,
+ * RunHeadless compares the checksums with it, and the one of the audio
+ * mix with that of the portable build, and returns false if one
+ * differs. The allocations of the frames are still checked,
+ * those of the rasterizer, which stands in for the GPU, are only
+ * logged.
+ *
+ * The checksums depend on the rounding of the math library, so golden
+ * files only hold for the build that wrote them. assets/golden has
+ * those of the portable build for the default pose and for the camera
+ * path flythrough.txt; other builds write their own with --raster.
+ *
+ * MUST BE CALLED BEFORE RunHeadless.
+ */
+void SetSoftwareRendering(PCWSTR output_prefix, PCWSTR golden_path);
+
+/*
+ * Lights the static tiles on the CPU once per tile and keeps the
+ * result in the instance buffer, relighting only tiles near lamps
+ * that moved or changed color, instead of lighting every vertex in
+ * the vertex shader. The tiles relit per frame are written to the
+ * debugger output and the benchmark report.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+void SetLightingCache();
+
+/*
+ * Merges the static tiles into as few large quads as the greedy
+ * meshing of merge_tiles finds and lights them per pixel, with the
+ * texture repeated once per tile, instead of lighting the vertices
+ * of every tile. The merged quads have no baked lighting and are
+ * not lit by the lighting cache. The instances saved are written
+ * to the debugger output.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D.
+ */
+void SetPerPixelLighting();
+
+/*
+ * Tiles the static rectangles in square blocks of 2^k tiles, split
+ * quadtree style only where interpolating the light of the lamp paths
+ * across a block would be visibly off, so tiles far from every lamp
+ * are large. The tiles have no baked lighting. The instances saved
+ * are written to the debugger output. Has no effect with
+ * SetPerPixelLighting, which merges the uniform tiles instead.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+void SetAdaptiveTiles();
+
+/*
+ * Draws the uniform static tiles through a distance-based level of
+ * detail: distant blocks of 2x2, 4x4, ... tiles are drawn as single
+ * instances with the average of their baked lighting. The selection
+ * follows the camera position every simulated frame; the tiles drawn
+ * per frame are written to the debugger output. Has no effect with
+ * SetPerPixelLighting or SetAdaptiveTiles, replaces SetLightingCache.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+void SetTileLod();
+
+/*
+ * Draws the static instances front to back: clusters of neighbouring
+ * instances are sorted by view depth every simulated frame, unless the
+ * view barely changed, and drawn nearest first, so the depth test rejects
+ * the pixels hidden behind near walls before they are shaded. Clusters
+ * out of the depth range of the projection are not drawn. The frames
+ * sorted are written to the debugger output, the overdraw as well with
+ * SetSoftwareRendering.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+void SetInstanceSorting();
+
+/*
+ * Records the input of every tick to `path`.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D.
+ */
+void SetInputRecording(PCWSTR path);
+
+/*
+ * Replays the input recorded in `path` instead of taking live input.
+ * The application quits when the replay ends, RunHeadless runs until
+ * all of it is simulated. Returns false if the file cannot be read.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+bool SetInputReplay(PCWSTR path);
+
+/*
+ * Flies the camera along the keyframes in `camera_path_file` over
+ * `frame_count` frames instead of taking input, then quits and writes
+ * the frame phase percentiles, the drawn instances and the uploaded
+ * bytes per frame to `report_path`. RunHeadless runs until the path
+ * ends. Returns false if the path cannot be read.
+ *
+ * MUST BE CALLED BEFORE InitDirect3D OR RunHeadless.
+ */
+bool SetBenchmark(PCWSTR camera_path_file, UINT frame_count, PCWSTR report_path);
+
+/*
+ * Renders `frame_count` frames at fixed animation times with the software
+ * rasterizer, without a window or a device. Frames are rendered on all
+ * cores, one per thread, and written in order: to a video if
+ * `output_path` ends with .y4m, otherwise to `<output_path><frame>.png`.
+ * The camera follows the keyframes in `camera_path_file` if it is not null.
+ * Of the tile options only SetAdaptiveTiles applies, the others are
+ * left out. Some of the frames are rendered again by a single thread
+ * afterwards.
+ * Returns false if the path cannot be read, the output cannot be written
+ * or a frame rendered again differs.
+ */
+bool RenderOffline(PCWSTR output_path, UINT frame_count, PCWSTR camera_path_file);
+
 #endif /* APPLICATIOND3D_H */
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "AudioMixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include "simd.h"
+
+AudioMixer::AudioMixer(UINT sample_rate) : sample_rate(sample_rate) {}
+
+size_t AudioMixer::add_clip(std::vector<float> samples, UINT clip_sample_rate) {
+	std::lock_guard<std::mutex> lock(mutex);
+	clips.push_back({ std::move(samples), clip_sample_rate });
+	return clips.size() - 1;
+}
+
+size_t AudioMixer::add_emitter(size_t clip, DirectX::XMFLOAT3 position, FLOAT emitter_gain) {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t idx = emitter_count++;
+	if (idx % 4 == 0) {
+		// grow every array by a full lane of silent emitters
+		size_t padded = idx + 4;
+		for (auto array : { &pos_x, &pos_y, &pos_z, &vel_x, &vel_y, &vel_z,
+				&gain, &target_left, &target_right, &current_left, &current_right }) {
+			array->resize(padded, 0.0f);
+		}
+		rate.resize(padded, 1.0f);
+		lag.resize(padded, 0.0);
+		emitter_clip.resize(padded, 0);
+	}
+	pos_x[idx] = position.x;
+	pos_y[idx] = position.y;
+	pos_z[idx] = position.z;
+	gain[idx] = emitter_gain;
+	emitter_clip[idx] = clip;
+	return idx;
+}
+
+void AudioMixer::set_emitter(size_t emitter, DirectX::XMFLOAT3 position,
+	DirectX::XMFLOAT3 velocity) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pos_x[emitter] = position.x;
+	pos_y[emitter] = position.y;
+	pos_z[emitter] = position.z;
+	vel_x[emitter] = velocity.x;
+	vel_y[emitter] = velocity.y;
+	vel_z[emitter] = velocity.z;
+}
+
+void AudioMixer::set_listener(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 right,
+	DirectX::XMFLOAT3 velocity) {
+	std::lock_guard<std::mutex> lock(mutex);
+	listener_position = position;
+	listener_right = right;
+	listener_velocity = velocity;
+}
+
+UINT AudioMixer::get_sample_rate() const {
+	return sample_rate;
+}
+
+void AudioMixer::render(FLOAT* out, size_t frames) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::fill(out, out + 2 * frames, 0.0f);
+	while (frames > 0) {
+		size_t block = (std::min)(frames, BLOCK_SIZE);
+		compute_gains();
+		mix_block(out, block);
+		out += 2 * block;
+		frames -= block;
+	}
+}
+
+/*
+ * Computes target stereo gains and playback rates of all emitters,
+ * four at a time.
+ */
+void AudioMixer::compute_gains() {
+	using namespace DirectX;
+
+	const XMVECTOR lx = XMVectorReplicate(listener_position.x);
+	const XMVECTOR ly = XMVectorReplicate(listener_position.y);
+	const XMVECTOR lz = XMVectorReplicate(listener_position.z);
+	const XMVECTOR rx = XMVectorReplicate(listener_right.x);
+	const XMVECTOR ry = XMVectorReplicate(listener_right.y);
+	const XMVECTOR rz = XMVectorReplicate(listener_right.z);
+	const XMVECTOR lvx = XMVectorReplicate(listener_velocity.x);
+	const XMVECTOR lvy = XMVectorReplicate(listener_velocity.y);
+	const XMVECTOR lvz = XMVectorReplicate(listener_velocity.z);
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR min_dist_sq = XMVectorReplicate(1e-4f);
+	const XMVECTOR rolloff = XMVectorReplicate(ROLLOFF);
+	const XMVECTOR speed_of_sound = XMVectorReplicate(SPEED_OF_SOUND);
+	const XMVECTOR min_rate = XMVectorReplicate(0.5f);
+	const XMVECTOR max_rate = XMVectorReplicate(2.0f);
+
+	for (size_t i = 0; i < gain.size(); i += 4) {
+		XMVECTOR dx = XMVectorSubtract(load_lane(pos_x, i), lx);
+		XMVECTOR dy = XMVectorSubtract(load_lane(pos_y, i), ly);
+		XMVECTOR dz = XMVectorSubtract(load_lane(pos_z, i), lz);
+
+		XMVECTOR dist_sq = XMVectorMultiply(dx, dx);
+		dist_sq = XMVectorMultiplyAdd(dy, dy, dist_sq);
+		dist_sq = XMVectorMultiplyAdd(dz, dz, dist_sq);
+		dist_sq = XMVectorMax(dist_sq, min_dist_sq);
+		XMVECTOR inv_dist = XMVectorReciprocalSqrt(dist_sq);
+
+		// distance attenuation
+		XMVECTOR att = XMVectorDivide(
+			load_lane(gain, i), XMVectorMultiplyAdd(rolloff, dist_sq, one));
+
+		// equal power panning, pan = cos of the angle to the right vector
+		XMVECTOR pan = XMVectorMultiply(dx, rx);
+		pan = XMVectorMultiplyAdd(dy, ry, pan);
+		pan = XMVectorMultiplyAdd(dz, rz, pan);
+		pan = XMVectorClamp(XMVectorMultiply(pan, inv_dist),
+			XMVectorNegate(one), one);
+		XMVECTOR left = XMVectorSqrt(XMVectorMax(
+			XMVectorMultiply(half, XMVectorSubtract(one, pan)), zero));
+		XMVECTOR right = XMVectorSqrt(XMVectorMax(
+			XMVectorMultiply(half, XMVectorAdd(one, pan)), zero));
+		store_lane(target_left, i, XMVectorMultiply(att, left));
+		store_lane(target_right, i, XMVectorMultiply(att, right));
+
+		// Doppler: velocities projected on the listener -> emitter direction
+		XMVECTOR source_speed = XMVectorMultiply(load_lane(vel_x, i), dx);
+		source_speed = XMVectorMultiplyAdd(load_lane(vel_y, i), dy, source_speed);
+		source_speed = XMVectorMultiplyAdd(load_lane(vel_z, i), dz, source_speed);
+		source_speed = XMVectorMultiply(source_speed, inv_dist);
+		XMVECTOR listener_speed = XMVectorMultiply(lvx, dx);
+		listener_speed = XMVectorMultiplyAdd(lvy, dy, listener_speed);
+		listener_speed = XMVectorMultiplyAdd(lvz, dz, listener_speed);
+		listener_speed = XMVectorMultiply(listener_speed, inv_dist);
+		XMVECTOR doppler = XMVectorDivide(
+			XMVectorAdd(speed_of_sound, listener_speed),
+			XMVectorAdd(speed_of_sound, source_speed));
+		store_lane(rate, i, XMVectorClamp(doppler, min_rate, max_rate));
+	}
+}
+
+/*
+ * Adds a block of all emitters to `out`, ramping from
+ * the current gains to the targets computed by compute_gains.
+ *
+ * An emitter is resampled from where the shared position minus its lag
+ * is at the start of the block to where it is at the end, the lag
+ * growing while the Doppler rate is below 1 and shrinking above it.
+ */
+void AudioMixer::mix_block(FLOAT* out, size_t frames) {
+	const FLOAT inv_frames = 1.0f / static_cast<FLOAT>(frames);
+	for (size_t e = 0; e < emitter_count; e++) {
+		const clip_t& clip = clips[emitter_clip[e]];
+		const size_t length = clip.samples.size() / 2;
+		const double lag_start = lag[e];
+		lag[e] = std::clamp(lag_start + (1.0 - rate[e]) * frames / sample_rate, -MAX_LAG, MAX_LAG);
+		if (length == 0) {
+			continue;
+		}
+
+		FLOAT left = current_left[e];
+		FLOAT right = current_right[e];
+		const FLOAT left_step = (target_left[e] - left) * inv_frames;
+		const FLOAT right_step = (target_right[e] - right) * inv_frames;
+		current_left[e] = target_left[e];
+		current_right[e] = target_right[e];
+		if (left == 0.0f && right == 0.0f
+			&& target_left[e] == 0.0f && target_right[e] == 0.0f) {
+			// inaudible, the lag is all there is to keep
+			continue;
+		}
+
+		// in frames of the clip
+		const double clip_frames = static_cast<double>(clip.sample_rate) / sample_rate;
+		double pos = std::fmod((played_frames - lag_start * sample_rate) * clip_frames,
+			static_cast<double>(length));
+		if (pos < 0.0) {
+			pos += length;
+		}
+		const double step = (frames - (lag[e] - lag_start) * sample_rate) / frames * clip_frames;
+		for (size_t f = 0; f < frames; f++) {
+			const size_t idx = static_cast<size_t>(pos);
+			const FLOAT frac = static_cast<FLOAT>(pos - idx);
+			const FLOAT* a = &clip.samples[2 * (idx % length)];
+			const FLOAT* b = &clip.samples[2 * ((idx + 1) % length)];
+
+			left += left_step;
+			right += right_step;
+			out[2 * f] += left * MASTER_GAIN * (a[0] + frac * (b[0] - a[0]));
+			out[2 * f + 1] += right * MASTER_GAIN * (a[1] + frac * (b[1] - a[1]));
+			pos += step;
+		}
+	}
+	played_frames += frames;
+
+	for (size_t i = 0; i < 2 * frames; i++) {
+		out[i] = std::clamp(out[i], -1.0f, 1.0f);
+	}
+}
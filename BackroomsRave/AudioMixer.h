@@ -0,0 +1,86 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <vector>
+#include <mutex>
+
+/*
+ * Mixes looping stereo clips played by positional emitters into
+ * an interleaved stereo buffer, as heard by a single listener.
+ *
+ * Emitters are attenuated with the same falloff as the lamp lights,
+ * panned relative to the listener's right vector, which balances the
+ * channels of the clip, and pitch shifted by the Doppler effect.
+ *
+ * All emitters play around one shared playback position, so emitters
+ * of the same clip stay in time with each other and with the beat of
+ * the scene. The Doppler effect only moves an emitter ahead of or behind
+ * that position, by at most MAX_LAG seconds; the pitch is back to normal
+ * while the lag stays at its limit. Gains are computed for four emitters at once
+ * from structure-of-arrays data, once per block of BLOCK_SIZE frames,
+ * and ramped linearly across the block to avoid zipper noise.
+ *
+ * The mixer does not talk to any audio device, so it can be rendered
+ * headlessly. All public methods are thread-safe.
+ */
+class AudioMixer {
+public:
+	static constexpr size_t BLOCK_SIZE = 256;
+
+	AudioMixer(UINT sample_rate);
+
+	// `samples` are interleaved stereo frames.
+	size_t add_clip(std::vector<float> samples, UINT clip_sample_rate);
+	size_t add_emitter(size_t clip, DirectX::XMFLOAT3 position, FLOAT gain = 1.0f);
+	void set_emitter(size_t emitter, DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 velocity);
+	void set_listener(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 right,
+		DirectX::XMFLOAT3 velocity);
+
+	// Writes `frames` interleaved stereo frames to `out`.
+	void render(FLOAT* out, size_t frames);
+	UINT get_sample_rate() const;
+
+private:
+	void compute_gains();
+	void mix_block(FLOAT* out, size_t frames);
+
+	// scene units per second, the scene is roughly in meters
+	static constexpr FLOAT SPEED_OF_SOUND = 343.0f;
+	// same as the attenuation of lamp lights in the vertex shader
+	static constexpr FLOAT ROLLOFF = 0.1f;
+	static constexpr FLOAT MASTER_GAIN = 0.5f;
+	// seconds an emitter may play behind (or ahead of, if negative)
+	// the shared playback position
+	static constexpr double MAX_LAG = 0.05;
+
+	struct clip_t {
+		std::vector<float> samples;
+		UINT sample_rate;
+	};
+
+	UINT sample_rate;
+	std::mutex mutex;
+	std::vector<clip_t> clips;
+
+	DirectX::XMFLOAT3 listener_position = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 listener_right = { 1.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 listener_velocity = { 0.0f, 0.0f, 0.0f };
+
+	// Emitter data, stored as structure of arrays padded to
+	// a multiple of 4 (padding emitters have zero gain).
+	size_t emitter_count = 0;
+	std::vector<float> pos_x, pos_y, pos_z;
+	std::vector<float> vel_x, vel_y, vel_z;
+	std::vector<float> gain;
+	std::vector<size_t> emitter_clip;
+
+	// Gain kernel output and per-emitter playback state.
+	std::vector<float> target_left, target_right, rate;
+	std::vector<float> current_left, current_right;
+	std::vector<double> lag;        // in seconds
+	UINT64 played_frames = 0;       // shared playback position
+};
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,231 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Camera.h"
+#include "InstanceSorter.h"
+#include "PointLightKernel.h"
+#include "RangeAllocator.h"
+#include "Rectangle.h"
+#include "TileLod.h"
+#include "TileMerger.h"
+#include "util.h"
+
+using namespace DirectX;
+
+namespace {
+	// a single floor of a million tiles
+	const rectangle_desc_t large_level[] = {
+		{ { -500.0f, 0.0f, -500.0f }, { 500.0f, 0.0f, 500.0f }, { 0.0f, 0.0f }, true, 1.0f },
+	};
+}
+
+void benchmark_job_scaling(const SceneConfig& config, UINT interval_ms) {
+	constexpr UINT BUILD_REPEATS = 20;
+	constexpr UINT UPDATE_REPEATS = 1000;
+	const size_t max_threads = (std::max)(std::thread::hardware_concurrency(), 1u);
+	for (size_t threads = 1; threads <= max_threads; threads++) {
+		JobSystem jobs(threads);
+		const auto build_start = std::chrono::steady_clock::now();
+		for (UINT i = 0; i < BUILD_REPEATS; i++) {
+			Scene bench_scene(config, jobs);
+		}
+		const auto build_end = std::chrono::steady_clock::now();
+		Scene bench_scene(config, jobs);
+		const auto update_start = std::chrono::steady_clock::now();
+		for (UINT i = 0; i < UPDATE_REPEATS; i++) {
+			bench_scene.update(i, i * interval_ms);
+		}
+		const auto update_end = std::chrono::steady_clock::now();
+		const size_t large_tiles = Scene::build_static_instances(large_level, jobs).size();
+		const auto end = std::chrono::steady_clock::now();
+
+		const std::chrono::duration<double, std::milli> build = build_end - build_start;
+		const std::chrono::duration<double, std::micro> update = update_end - update_start;
+		const std::chrono::duration<double, std::milli> large_build = end - update_end;
+		WCHAR line[160];
+		swprintf_s(line, L"[jobs] %zu threads: build %.3f ms, update %.3f us, %zu tiles %.3f ms\n",
+			threads, build.count() / BUILD_REPEATS, update.count() / UPDATE_REPEATS,
+			large_tiles, large_build.count());
+		OutputDebugStringW(line);
+	}
+}
+
+void benchmark_tile_reduction(const SceneConfig& config, FLOAT focal_length,
+	FLOAT near_plane, FLOAT far_plane, JobSystem& jobs)
+{
+	const std::pair<PCWSTR, std::span<const rectangle_desc_t>> tile_levels[] = {
+		{ L"level", config.get_rectangles() },
+		{ L"large level", large_level },
+	};
+	Scene tiled_scene(config, jobs);
+	WCHAR line[160];
+	for (const auto& [name, rectangles] : tile_levels) {
+		// merged before any lighting is baked into the tiles
+		const std::vector<square_instance_t> tiles = Scene::build_static_instances(rectangles, jobs);
+		const auto merge_start = std::chrono::steady_clock::now();
+		const size_t quads = merge_tiles(tiles).size();
+		const std::chrono::duration<double, std::milli> merge_time =
+			std::chrono::steady_clock::now() - merge_start;
+		log_tile_reduction(L"merge", name, tiles.size(), quads, merge_time.count());
+
+		// adaptive tiling for the lamps of the level
+		const auto subdivide_start = std::chrono::steady_clock::now();
+		tiled_scene.subdivide_static_instances(rectangles, config.get_lamps(), jobs);
+		const std::chrono::duration<double, std::milli> subdivide_time =
+			std::chrono::steady_clock::now() - subdivide_start;
+		log_tile_reduction(L"adaptive", name, tiles.size(),
+			tiled_scene.get_static_instances().size(), subdivide_time.count());
+
+		// levels of detail seen from the start of the camera, then
+		// selected again while the camera walks away from it
+		const auto lod_start = std::chrono::steady_clock::now();
+		TileLod lod(rectangles, tiles);
+		std::vector<square_instance_t> selected;
+		const XMFLOAT3 eye = Camera().get_position();
+		lod.select(eye, focal_length, selected);
+		const auto lod_end = std::chrono::steady_clock::now();
+		const std::chrono::duration<double, std::milli> lod_time = lod_end - lod_start;
+		log_tile_reduction(L"lod", name, tiles.size(), selected.size(), lod_time.count());
+		constexpr UINT LOD_STEPS = 100;
+		size_t changes = 0;
+		for (UINT i = 1; i <= LOD_STEPS; i++) {
+			changes += lod.select({ eye.x + 0.1f * i, eye.y, eye.z }, focal_length, selected);
+		}
+		const std::chrono::duration<double, std::milli> walk_time = std::chrono::steady_clock::now() - lod_end;
+		swprintf_s(line, L"[lod] %s: %zu nodes, %.3f ms per step of the camera, %zu of %u changed\n",
+			name, lod.get_node_count(), walk_time.count() / LOD_STEPS, changes, LOD_STEPS);
+		OutputDebugStringW(line);
+
+		// front-to-back order of the tiles while the camera turns
+		InstanceSorter sorter(tiles.size(), near_plane, far_plane);
+		sorter.set_instances(tiles);
+		Camera sort_camera;
+		constexpr UINT SORT_STEPS = 100;
+		const auto sort_start = std::chrono::steady_clock::now();
+		for (UINT i = 0; i < SORT_STEPS; i++) {
+			sort_camera.set_pose(eye, 0.01f * i, 0.0f);
+			XMFLOAT4X4 view;
+			XMStoreFloat4x4(&view, XMMatrixTranspose(sort_camera.get_view_matrix()));
+			sorter.sort(view, jobs);
+		}
+		const std::chrono::duration<double, std::milli> sort_time = std::chrono::steady_clock::now() - sort_start;
+		swprintf_s(line, L"[sort] %s: %zu clusters, %.3f ms per sort, %zu draws\n",
+			name, sorter.get_cluster_count(), sort_time.count() / SORT_STEPS, sorter.get_order().size());
+		OutputDebugStringW(line);
+	}
+}
+
+void benchmark_light_kernel(const vs_const_buffer_t& constants) {
+	constexpr size_t LIGHT_VERTICES = 1 << 16;
+	constexpr UINT LIGHT_REPEATS = 20;
+	std::vector<FLOAT> light_data(LIGHT_VERTICES * 14);
+	light_batch_t light_batch = {};
+	for (size_t c = 0; c < 14; c++) {
+		FLOAT* data = light_data.data() + c * LIGHT_VERTICES;
+		if (c < 3) {
+			light_batch.position[c] = data;
+		}
+		else if (c < 6) {
+			light_batch.normal[c - 3] = data;
+		}
+		else if (c < 10) {
+			light_batch.color[c - 6] = data;
+		}
+		else {
+			light_batch.result[c - 10] = data;
+		}
+	}
+	light_batch.count = LIGHT_VERTICES;
+	for (size_t i = 0; i < LIGHT_VERTICES; i++) {
+		light_data[i] = static_cast<FLOAT>(i % 256) * 0.25f;
+		light_data[2 * LIGHT_VERTICES + i] = static_cast<FLOAT>(i / 256) * 0.25f;
+		light_data[4 * LIGHT_VERTICES + i] = 1.0f;
+	}
+	std::fill(light_data.begin() + 6 * LIGHT_VERTICES, light_data.begin() + 10 * LIGHT_VERTICES, 1.0f);
+	const PointLightKernel light_kernel(constants);
+	const auto light_start = std::chrono::steady_clock::now();
+	for (UINT i = 0; i < LIGHT_REPEATS; i++) {
+		light_kernel.evaluate(light_batch);
+	}
+	const std::chrono::duration<double> light_time = std::chrono::steady_clock::now() - light_start;
+	WCHAR line[128];
+	swprintf_s(line, L"[lights] %zu lights: %.1f M vertex-lights/s\n",
+		light_kernel.get_light_count(),
+		1e-6 * LIGHT_VERTICES * LIGHT_REPEATS * light_kernel.get_light_count()
+		/ (std::max)(light_time.count(), 1e-9));
+	OutputDebugStringW(line);
+}
+
+/*
+ * Ranges of up to a thousand instances are allocated while the
+ * allocator is less than half full and freed at random otherwise.
+ */
+void benchmark_range_allocator() {
+	constexpr UINT64 ALLOCATOR_CAPACITY = 1 << 20;
+	constexpr UINT ALLOCATOR_OPERATIONS = 200000;
+	RangeAllocator allocator(ALLOCATOR_CAPACITY);
+	std::vector<RangeAllocator::handle_t> live_ranges;
+	live_ranges.reserve(ALLOCATOR_OPERATIONS);
+	std::mt19937 random(1);
+	const auto churn_start = std::chrono::steady_clock::now();
+	for (UINT i = 0; i < ALLOCATOR_OPERATIONS; i++) {
+		if (allocator.get_used() < ALLOCATOR_CAPACITY / 2) {
+			const RangeAllocator::handle_t handle = allocator.allocate(1 + random() % 1024);
+			if (handle != RangeAllocator::INVALID_HANDLE) {
+				live_ranges.push_back(handle);
+				continue;
+			}
+		}
+		if (!live_ranges.empty()) {
+			std::swap(live_ranges[random() % live_ranges.size()], live_ranges.back());
+			allocator.free(live_ranges.back());
+			live_ranges.pop_back();
+		}
+	}
+	const auto churn_end = std::chrono::steady_clock::now();
+	const float churn_fragmentation = allocator.get_fragmentation();
+	const UINT64 churn_end_offset = allocator.get_end();
+	const size_t moves = allocator.defragment().size();
+	const std::chrono::duration<double> churn_time = churn_end - churn_start;
+	const std::chrono::duration<double, std::milli> defragment_time =
+		std::chrono::steady_clock::now() - churn_end;
+	WCHAR line[256];
+	swprintf_s(line, L"[ranges] %.1f M operations/s, %llu of %llu used, fragmentation %.3f\n"
+		L"[ranges] defragment: %zu moves in %.3f ms, end %llu -> %llu, fragmentation %.3f\n",
+		1e-6 * ALLOCATOR_OPERATIONS / (std::max)(churn_time.count(), 1e-9),
+		allocator.get_used(), allocator.get_capacity(), churn_fragmentation,
+		moves, defragment_time.count(), churn_end_offset, allocator.get_end(),
+		allocator.get_fragmentation());
+	OutputDebugStringW(line);
+}
+
+/*
+ * The uniform tiles are built one rectangle after another, so those of
+ * the removed rectangle are the last ones. Only the tiles the edit
+ * reaches are solved again.
+ */
+void benchmark_bake_edit(const SceneConfig& config, const Scene& scene,
+	const LightBaker& baker, uint64_t bake_beats, JobSystem& jobs)
+{
+	const std::span<const rectangle_desc_t> rectangles = config.get_rectangles();
+	const std::span<const rectangle_desc_t> edited = rectangles.first(rectangles.size() - 1);
+	const std::span<const square_instance_t> instances = scene.get_static_instances();
+	const std::span<const square_instance_t> edited_instances =
+		instances.first(instances.size() - AxisRectangle::tile_count(rectangles.back()));
+	LightBaker edit_baker = baker;
+	const auto edit_start = std::chrono::steady_clock::now();
+	const size_t edit_solved = edit_baker.bake(edited, edited_instances,
+		LightBaker::average_lamps(config.get_lamps(), scene.get_lamps(), bake_beats), jobs);
+	const std::chrono::duration<double, std::milli> edit_time = std::chrono::steady_clock::now() - edit_start;
+	WCHAR line[128];
+	swprintf_s(line, L"[bake] edit: %zu of %zu tiles solved in %.1f ms\n",
+		edit_solved, edited_instances.size(), edit_time.count());
+	OutputDebugStringW(line);
+}
\ No newline at end of file
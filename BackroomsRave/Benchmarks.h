@@ -0,0 +1,53 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <Windows.h>
+#include <cstdint>
+#include "JobSystem.h"
+#include "LightBaker.h"
+#include "Scene.h"
+#include "SceneConfig.h"
+#include "types.h"
+
+/*
+ * Benchmarks of the CPU work behind the frames, run by --bench apart
+ * from the checks of --headless. Every one writes its results to the
+ * debugger output, prefixed by the tag of the work it measures.
+ */
+
+/*
+ * Scaling of the scene build and update from one thread to all of
+ * them, and of the build of a floor of a million tiles. A tick of
+ * the update is `interval_ms` of animation time.
+ */
+void benchmark_job_scaling(const SceneConfig& config, UINT interval_ms);
+
+/*
+ * Instances saved on the level of `config` and on the floor of a
+ * million tiles by merging the tiles, by the adaptive tiling and by
+ * the levels of detail, and the cost of sorting the tiles front to
+ * back, seen by a camera at its start. `focal_length` is in pixels.
+ */
+void benchmark_tile_reduction(const SceneConfig& config, FLOAT focal_length,
+	FLOAT near_plane, FLOAT far_plane, JobSystem& jobs);
+
+/*
+ * Throughput of the light kernel on a grid of floor vertices,
+ * lit by the lights of `constants`.
+ */
+void benchmark_light_kernel(const vs_const_buffer_t& constants);
+
+/*
+ * Churn of the instance allocator and the compaction after it.
+ */
+void benchmark_range_allocator();
+
+/*
+ * Bake of an edit of the level of `config` removing its last
+ * rectangle. `scene` has the uniform tiles of `config`, baked by
+ * `baker` with the lamps averaged over `bake_beats` beats.
+ */
+void benchmark_bake_edit(const SceneConfig& config, const Scene& scene,
+	const LightBaker& baker, uint64_t bake_beats, JobSystem& jobs);
+
+#endif // BENCHMARKS_H
\ No newline at end of file
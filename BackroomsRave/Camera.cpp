@@ -3,38 +3,31 @@
 #include <windows.h>
 #include <algorithm>
 
-Camera::Camera(HWND hwnd) {
-	RECT rect;
-	GetClientRect(hwnd, &rect);
-
-	center_x = (rect.right - rect.left) / 2;
-	center_y = (rect.bottom - rect.top) / 2;
-
-	SetCursorPos(center_x, center_y);
+Camera::Camera() {
 	position = { 0.0f, 0.0f, 0.0f };
 }
 
-void Camera::update() {
+void Camera::update(const input_frame_t& input) {
 	auto translate_vector = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-	if (GetAsyncKeyState(0x57) & 0x8000) { // W
+	if (input.keys & input_frame_t::KEY_FORWARD) {
 		translate_vector = DirectX::XMVectorAdd(
 			translate_vector,
 			DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)
 		);
 	}
-	if (GetAsyncKeyState(0x41) & 0x8000) { // A
+	if (input.keys & input_frame_t::KEY_LEFT) {
 		translate_vector = DirectX::XMVectorAdd(
 			translate_vector,
 			DirectX::XMVectorSet(-1.0f, 0.0f, 0.0f, 0.0f)
 		);
 	}
-	if (GetAsyncKeyState(0x53) & 0x8000) { // S
+	if (input.keys & input_frame_t::KEY_BACKWARD) {
 		translate_vector = DirectX::XMVectorAdd(
 			translate_vector,
 			DirectX::XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f)
 		);
 	}
-	if (GetAsyncKeyState(0x44) & 0x8000) { // D
+	if (input.keys & input_frame_t::KEY_RIGHT) {
 		translate_vector = DirectX::XMVectorAdd(
 			translate_vector,
 			DirectX::XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f)
@@ -55,19 +48,19 @@ void Camera::update() {
 		)
 	);
 
-	// each frame we look for the change in cursor position
-	// and reset it to the center of the window
-	POINT cursor_pos;
-	GetCursorPos(&cursor_pos);
-	SetCursorPos(center_x, center_y);
-
-	float dx = static_cast<float>(cursor_pos.x - center_x);
-	float dy = static_cast<float>(cursor_pos.y - center_y);
+	float dx = static_cast<float>(input.mouse_dx);
+	float dy = static_cast<float>(input.mouse_dy);
 	// clamp to prevent the camera from flipping
 	pitch = std::clamp(pitch + dy * rotation_speed, -1.5f, 1.5f);
 	yaw = fmodf(yaw + dx * rotation_speed, DirectX::XM_2PI);
 }
 
+void Camera::set_pose(DirectX::XMFLOAT3 position, float yaw, float pitch) {
+	this->position = position;
+	this->yaw = yaw;
+	this->pitch = pitch;
+}
+
 DirectX::XMMATRIX Camera::get_view_matrix() {
 	auto look_direction = DirectX::XMVector3Transform(
 		DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
@@ -84,4 +77,13 @@ DirectX::XMMATRIX Camera::get_view_matrix() {
 		target,
 		DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
 	);
+}
+
+DirectX::XMFLOAT3 Camera::get_position() const {
+	return position;
+}
+
+DirectX::XMFLOAT3 Camera::get_right() const {
+	// the camera never rolls, so the right vector depends on yaw only
+	return { cosf(yaw), 0.0f, -sinf(yaw) };
 }
\ No newline at end of file
@@ -3,20 +3,23 @@
 
 #include <DirectXMath.h>
 #include <windows.h>
+#include "Input.h"
 
 
 /*
  * Class storing the position of the camera and responsible for
- * updating it based on user input.
+ * updating it based on user input. The camera only depends on the
+ * input frames, so replayed input moves it the same way.
  */
 class Camera {
 	public:
-		Camera(HWND hwnd);
-		void update();
+		Camera();
+		void update(const input_frame_t& input);
+		void set_pose(DirectX::XMFLOAT3 position, float yaw, float pitch);
 		DirectX::XMMATRIX get_view_matrix();
+		DirectX::XMFLOAT3 get_position() const;
+		DirectX::XMFLOAT3 get_right() const;
 	private:
-		int center_x;
-		int center_y;
 		DirectX::XMFLOAT3 position;
 		float pitch = 0.0f;
 		float yaw = 0.0f;
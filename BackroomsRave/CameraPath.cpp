@@ -0,0 +1,88 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+	using namespace DirectX;
+
+	// keyframes past the ends repeat the end ones
+	XMVECTOR key_position(const std::vector<camera_key_t>& keys, std::ptrdiff_t idx) {
+		idx = std::clamp<std::ptrdiff_t>(idx, 0, static_cast<std::ptrdiff_t>(keys.size()) - 1);
+		return XMLoadFloat3(&keys[idx].position);
+	}
+
+	XMVECTOR key_angles(const std::vector<camera_key_t>& keys, std::ptrdiff_t idx) {
+		idx = std::clamp<std::ptrdiff_t>(idx, 0, static_cast<std::ptrdiff_t>(keys.size()) - 1);
+		return XMVectorSet(keys[idx].yaw, keys[idx].pitch, 0.0f, 0.0f);
+	}
+}
+
+CameraPath::CameraPath(std::vector<camera_key_t> keys) :
+	keys(std::move(keys))
+{
+	if (this->keys.size() < 2) {
+		throw "Camera path needs two keyframes";
+	}
+	for (size_t i = 1; i < this->keys.size(); i++) {
+		if (!(this->keys[i].time > this->keys[i - 1].time)) {
+			throw "Camera keyframe times must increase";
+		}
+	}
+}
+
+CameraPath CameraPath::load(PCWSTR path) {
+	std::ifstream file{ std::filesystem::path(path) };
+	if (!file) {
+		throw "Cannot open the camera path";
+	}
+
+	std::vector<camera_key_t> keys;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		std::string first;
+		if (!(fields >> first) || first[0] == '#') {
+			continue;
+		}
+		fields.clear();
+		fields.seekg(0);
+
+		camera_key_t key;
+		if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z
+			>> key.yaw >> key.pitch)) {
+			throw "Invalid camera keyframe";
+		}
+		keys.push_back(key);
+	}
+	return CameraPath(std::move(keys));
+}
+
+float CameraPath::get_duration() const {
+	return keys.back().time - keys.front().time;
+}
+
+camera_pose_t CameraPath::sample(float time) const {
+	time = std::clamp(time + keys.front().time, keys.front().time, keys.back().time);
+
+	// segment containing `time`, the last one includes its end
+	const auto next = std::upper_bound(keys.begin() + 1, keys.end() - 1, time,
+		[](float t, const camera_key_t& key) { return t < key.time; });
+	const std::ptrdiff_t i = (next - keys.begin()) - 1;
+	const float u = (time - keys[i].time) / (keys[i + 1].time - keys[i].time);
+
+	camera_pose_t pose;
+	XMStoreFloat3(&pose.position, XMVectorCatmullRom(
+		key_position(keys, i - 1), key_position(keys, i),
+		key_position(keys, i + 1), key_position(keys, i + 2), u));
+	const XMVECTOR angles = XMVectorCatmullRom(
+		key_angles(keys, i - 1), key_angles(keys, i),
+		key_angles(keys, i + 1), key_angles(keys, i + 2), u);
+	pose.yaw = XMVectorGetX(angles);
+	pose.pitch = XMVectorGetY(angles);
+	return pose;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <vector>
+
+/*
+ * Camera keyframe, `time` in seconds from the start of the path.
+ */
+struct camera_key_t {
+	float time;
+	DirectX::XMFLOAT3 position;
+	float yaw;
+	float pitch;
+};
+
+struct camera_pose_t {
+	DirectX::XMFLOAT3 position;
+	float yaw;
+	float pitch;
+};
+
+/*
+ * Scripted camera flythrough. Positions and angles are interpolated
+ * between keyframes with Catmull-Rom splines, so the camera passes
+ * through every keyframe. Angles are not wrapped, a turn of more
+ * than half a circle needs keyframes in between.
+ */
+class CameraPath {
+public:
+	// Needs two keyframes or more with increasing times, throws otherwise.
+	CameraPath(std::vector<camera_key_t> keys);
+
+	// Reads keyframes from a text file, one per line as
+	// "time x y z yaw pitch". Empty lines and lines starting
+	// with '#' are skipped. Throws if the file is invalid.
+	static CameraPath load(PCWSTR path);
+
+	float get_duration() const;
+	// `time` is clamped to the path.
+	camera_pose_t sample(float time) const;
+
+private:
+	std::vector<camera_key_t> keys;
+};
+
+#endif // CAMERA_PATH_H
\ No newline at end of file
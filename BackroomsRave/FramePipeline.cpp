@@ -0,0 +1,143 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline(size_t max_latency,
+	std::function<void(size_t slot)> simulate) :
+	max_latency(max_latency),
+	simulate(std::move(simulate))
+{
+	free_slots.reserve(get_slot_count());
+	ready_slots.reserve(get_slot_count());
+	for (size_t i = 0; i < get_slot_count(); i++) {
+		free_slots.push_back(i);
+	}
+}
+
+FramePipeline::~FramePipeline() {
+	stop();
+}
+
+size_t FramePipeline::get_slot_count() const {
+	return max_latency + 2;
+}
+
+void FramePipeline::start() {
+	// the renderer always has a snapshot to show
+	const size_t slot = free_slots.front();
+	free_slots.erase(free_slots.begin());
+	simulate(slot);
+	ready_slots.push_back(slot);
+	stats.simulated_frames++;
+
+	running = true;
+	worker = std::thread(&FramePipeline::run, this);
+}
+
+void FramePipeline::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+void FramePipeline::tick() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pending_ticks + ready_slots.size() > max_latency) {
+			stats.dropped_ticks++;
+			return;
+		}
+		pending_ticks++;
+	}
+	condition.notify_all();
+}
+
+void FramePipeline::wait_idle() {
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] {
+		return !running || (pending_ticks == 0 && !simulating);
+	});
+}
+
+size_t FramePipeline::acquire() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!ready_slots.empty()) {
+		if (rendered_slot != NO_SLOT) {
+			free_slots.push_back(rendered_slot);
+		}
+		rendered_slot = ready_slots.front();
+		ready_slots.erase(ready_slots.begin());
+		stats.rendered_frames++;
+		condition.notify_all();
+	}
+	else {
+		stats.repeated_frames++;
+	}
+	render_busy = true;
+	render_start = clock::now();
+	return rendered_slot;
+}
+
+void FramePipeline::release() {
+	std::lock_guard<std::mutex> lock(mutex);
+	const std::chrono::duration<double, std::milli> duration =
+		clock::now() - render_start;
+	stats.render_ms += duration.count();
+	render_busy = false;
+}
+
+FramePipeline::stats_t FramePipeline::get_stats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+/*
+ * Total time the renderer has spent on frames until `now`.
+ * Must be called with the mutex held.
+ */
+double FramePipeline::render_busy_ms(clock::time_point now) const {
+	double busy = stats.render_ms;
+	if (render_busy) {
+		const std::chrono::duration<double, std::milli> duration = now - render_start;
+		busy += duration.count();
+	}
+	return busy;
+}
+
+/*
+ * Worker loop, simulates a frame for every tick.
+ */
+void FramePipeline::run() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [this] {
+			return !running || (pending_ticks > 0 && !free_slots.empty());
+		});
+		if (!running) {
+			return;
+		}
+		const size_t slot = free_slots.front();
+		free_slots.erase(free_slots.begin());
+		pending_ticks--;
+		simulating = true;
+
+		const clock::time_point start = clock::now();
+		const double busy_before = render_busy_ms(start);
+		lock.unlock();
+
+		simulate(slot);
+
+		lock.lock();
+		const clock::time_point end = clock::now();
+		const std::chrono::duration<double, std::milli> duration = end - start;
+		stats.simulate_ms += duration.count();
+		stats.overlap_ms += render_busy_ms(end) - busy_before;
+		stats.simulated_frames++;
+		ready_slots.push_back(slot);
+		simulating = false;
+		condition.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <Windows.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Simulates upcoming frames on a worker thread while the renderer
+ * records and presents the current one.
+ *
+ * Every tick asks for one simulated frame, written by `simulate`
+ * into a snapshot slot. The renderer takes finished snapshots in
+ * order and keeps the last one until a newer one is ready. Besides
+ * the frame being simulated, at most `max_latency` frames wait for
+ * the renderer, ticks beyond that are dropped.
+ */
+class FramePipeline {
+public:
+	static constexpr size_t NO_SLOT = ~size_t(0);
+
+	struct stats_t {
+		UINT64 simulated_frames;
+		UINT64 rendered_frames;     // renders of a new snapshot
+		UINT64 repeated_frames;     // renders of the previous snapshot
+		UINT64 dropped_ticks;
+		double simulate_ms;
+		double render_ms;
+		double overlap_ms;          // simulation while the renderer was busy
+	};
+
+	FramePipeline(size_t max_latency, std::function<void(size_t slot)> simulate);
+	~FramePipeline();
+
+	// Slots needed for snapshots: one rendered, one simulated and
+	// up to `max_latency` waiting.
+	size_t get_slot_count() const;
+
+	// Simulates the first frame on the calling thread and starts the worker.
+	void start();
+	void stop();
+	void tick();
+	// Waits until the frames of all ticks so far are simulated, so the
+	// renderer gets every frame regardless of timing.
+	void wait_idle();
+
+	// Renderer side: acquire returns the slot to render,
+	// release marks the end of the frame.
+	size_t acquire();
+	void release();
+
+	stats_t get_stats() const;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	void run();
+	double render_busy_ms(clock::time_point now) const;
+
+	const size_t max_latency;
+	std::function<void(size_t slot)> simulate;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::thread worker;
+	bool running = false;
+
+	// oldest first, reserved for all slots so frames do not allocate
+	std::vector<size_t> free_slots;
+	std::vector<size_t> ready_slots;
+	size_t rendered_slot = NO_SLOT;
+	size_t pending_ticks = 0;
+	bool simulating = false;
+
+	stats_t stats = {};
+	bool render_busy = false;
+	clock::time_point render_start;
+};
+
+#endif // FRAME_PIPELINE_H
\ No newline at end of file
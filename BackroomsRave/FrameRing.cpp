@@ -0,0 +1,94 @@
+#include "FrameRing.h"
+
+FrameRing::FrameRing(UINT64 capacity, FrameFence& fence) :
+	capacity(capacity),
+	fence(fence)
+{}
+
+void FrameRing::begin_frame() {
+	retire(fence.get_completed_value());
+	head = frame_start;
+}
+
+/*
+ * Position of the next allocation, ignoring the space in use.
+ */
+UINT64 FrameRing::find_position(UINT64 size, UINT64 alignment) {
+	if (size > capacity) {
+		throw "Allocation larger than the frame ring";
+	}
+	if (head == tail && frame_count == 0) {
+		// nothing in use, start over at the beginning of the buffer
+		head = tail = frame_start = (head + capacity - 1) / capacity * capacity;
+	}
+
+	UINT64 position = (head + alignment - 1) / alignment * alignment;
+	if (position % capacity + size > capacity) {
+		// does not fit before the end of the buffer, skip to the start
+		position = (position / capacity + 1) * capacity;
+	}
+	return position;
+}
+
+UINT64 FrameRing::allocate(UINT64 size, UINT64 alignment) {
+	const UINT64 position = find_position(size, alignment);
+
+	// wait for the GPU until the oldest frames free enough space
+	while (position + size - tail > capacity) {
+		if (frame_count == 0) {
+			throw "Frame does not fit in the frame ring";
+		}
+		const UINT64 oldest_fence_value = frames[first_frame].fence_value;
+		fence.wait_for_value(oldest_fence_value);
+		retire(oldest_fence_value);
+	}
+
+	head = position + size;
+	return position % capacity;
+}
+
+bool FrameRing::try_allocate(UINT64 size, UINT64 alignment, UINT64& offset) {
+	retire(fence.get_completed_value());
+	const UINT64 position = find_position(size, alignment);
+	if (position + size - tail > capacity) {
+		return false;
+	}
+	head = position + size;
+	offset = position % capacity;
+	return true;
+}
+
+void FrameRing::end_frame(UINT64 fence_value) {
+	if (frame_count == MAX_FRAMES_IN_FLIGHT) {
+		// too many frames queued, wait for the oldest one
+		const UINT64 oldest_fence_value = frames[first_frame].fence_value;
+		fence.wait_for_value(oldest_fence_value);
+		retire(oldest_fence_value);
+	}
+	frames[(first_frame + frame_count) % MAX_FRAMES_IN_FLIGHT] = { head, fence_value };
+	frame_count++;
+	frame_start = head;
+}
+
+void FrameRing::retire(UINT64 completed_value) {
+	while (frame_count > 0 && frames[first_frame].fence_value <= completed_value) {
+		tail = frames[first_frame].end;
+		first_frame = (first_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		frame_count--;
+	}
+	if (frame_count == 0) {
+		tail = frame_start;
+	}
+}
+
+UINT64 FrameRing::get_capacity() const {
+	return capacity;
+}
+
+UINT64 FrameRing::get_used() const {
+	return head - tail;
+}
+
+size_t FrameRing::get_frames_in_flight() const {
+	return frame_count;
+}
\ No newline at end of file
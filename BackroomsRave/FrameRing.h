@@ -0,0 +1,70 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <Windows.h>
+#include <array>
+
+/*
+ * Source of GPU progress, as seen by the CPU.
+ * Implemented over ID3D12Fence by the renderer.
+ */
+class FrameFence {
+public:
+	virtual ~FrameFence() = default;
+	virtual UINT64 get_completed_value() = 0;
+	virtual void wait_for_value(UINT64 value) = 0;
+};
+
+/*
+ * Linear ring allocator over one persistently mapped upload buffer.
+ *
+ * Allocations made between begin_frame and end_frame belong to
+ * a single frame and are retired together once the fence reaches
+ * the value the frame was submitted with. The allocator only
+ * hands out offsets, so it does not depend on the graphics API.
+ */
+class FrameRing {
+public:
+	static constexpr size_t MAX_FRAMES_IN_FLIGHT = 16;
+
+	// `capacity` must be a multiple of every alignment used.
+	FrameRing(UINT64 capacity, FrameFence& fence);
+
+	// Retires finished frames and drops allocations of the current
+	// frame, which was never submitted.
+	void begin_frame();
+	// Returns an offset into the buffer, waits for the GPU if full.
+	UINT64 allocate(UINT64 size, UINT64 alignment);
+	// Same as allocate, but fails instead of waiting.
+	bool try_allocate(UINT64 size, UINT64 alignment, UINT64& offset);
+	// Marks the current frame as submitted with `fence_value`.
+	void end_frame(UINT64 fence_value);
+
+	UINT64 get_capacity() const;
+	UINT64 get_used() const;
+	size_t get_frames_in_flight() const;
+
+private:
+	UINT64 find_position(UINT64 size, UINT64 alignment);
+	void retire(UINT64 completed_value);
+
+	struct frame_t {
+		UINT64 end;
+		UINT64 fence_value;
+	};
+
+	// Positions grow monotonically, the buffer offset is
+	// position % capacity.
+	UINT64 capacity;
+	UINT64 head = 0;            // next free position
+	UINT64 tail = 0;            // start of the oldest unretired frame
+	UINT64 frame_start = 0;     // start of the current frame
+	FrameFence& fence;
+
+	// frames in flight, a fixed circular queue
+	std::array<frame_t, MAX_FRAMES_IN_FLIGHT> frames = {};
+	size_t first_frame = 0;
+	size_t frame_count = 0;
+};
+
+#endif // FRAME_RING_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "FrameSequence.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+FrameSequence::FrameSequence(size_t worker_count, size_t capacity) :
+	worker_count((std::max)(worker_count, size_t(1))),
+	capacity((std::max)(capacity, size_t(1)))
+{
+}
+
+bool FrameSequence::run(UINT frame_count, const render_t& render, const write_t& write) {
+	struct slot_t {
+		pixels_t pixels;
+		bool ready = false;
+	};
+	std::vector<slot_t> slots(capacity);
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	UINT next_frame = 0;
+	UINT written_frames = 0;
+	bool stopped = false;
+	std::exception_ptr error;
+
+	auto work = [&](size_t worker) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			// the slot of a frame is free once the frame `capacity` before it is written
+			condition.wait(lock, [&] {
+				return stopped || next_frame == frame_count
+					|| next_frame < written_frames + capacity;
+			});
+			if (stopped || next_frame == frame_count) {
+				return;
+			}
+			const UINT frame = next_frame++;
+			slot_t& slot = slots[frame % capacity];
+			lock.unlock();
+
+			try {
+				render(worker, frame, slot.pixels);
+			}
+			catch (...) {
+				lock.lock();
+				if (!error) {
+					error = std::current_exception();
+				}
+				stopped = true;
+				condition.notify_all();
+				return;
+			}
+
+			lock.lock();
+			slot.ready = true;
+			condition.notify_all();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < (std::min)(worker_count, size_t(frame_count)); i++) {
+		workers.emplace_back(work, i);
+	}
+
+	// write on the calling thread, in order
+	for (UINT frame = 0; frame < frame_count; frame++) {
+		slot_t& slot = slots[frame % capacity];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&] { return slot.ready || stopped; });
+			if (!slot.ready) {
+				break;
+			}
+		}
+
+		const bool written = write(frame, slot.pixels);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.ready = false;
+		written_frames++;
+		stopped = stopped || !written;
+		condition.notify_all();
+		if (stopped) {
+			break;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopped = true;
+	}
+	condition.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return written_frames == frame_count;
+}
\ No newline at end of file
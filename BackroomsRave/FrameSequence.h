@@ -0,0 +1,35 @@
+#ifndef FRAME_SEQUENCE_H
+#define FRAME_SEQUENCE_H
+
+#include <Windows.h>
+#include <functional>
+#include <vector>
+
+/*
+ * Renders a numbered sequence of frames on several threads, one frame
+ * per thread at a time, and hands them to a writer strictly in order.
+ *
+ * Frames are rendered into a fixed number of slots: a thread takes the
+ * next frame only while fewer than `capacity` frames wait for the
+ * writer, so memory stays bounded however long the sequence is.
+ */
+class FrameSequence {
+public:
+	using pixels_t = std::vector<UINT32>;
+	// `worker` is the index of the rendering thread, below `worker_count`.
+	using render_t = std::function<void(size_t worker, UINT frame, pixels_t& pixels)>;
+	// Returns false to stop the sequence.
+	using write_t = std::function<bool(UINT frame, pixels_t& pixels)>;
+
+	FrameSequence(size_t worker_count, size_t capacity);
+
+	// Renders and writes frames [0, frame_count) and returns false if
+	// the writer stopped early. Exceptions of `render` are forwarded.
+	bool run(UINT frame_count, const render_t& render, const write_t& write);
+
+private:
+	size_t worker_count;
+	size_t capacity;
+};
+
+#endif // FRAME_SEQUENCE_H
\ No newline at end of file
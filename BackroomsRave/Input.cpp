@@ -0,0 +1,137 @@
+#include "Input.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iterator>
+
+namespace {
+	constexpr char MAGIC[4] = { 'B', 'R', 'I', 'N' };
+	constexpr UINT32 VERSION = 1;
+	constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(VERSION);
+	constexpr size_t FRAME_SIZE = 9;
+
+	template <typename T>
+	void put(char*& out, T value) {
+		for (size_t i = 0; i < sizeof(T); i++) {
+			*out++ = static_cast<char>((static_cast<UINT64>(value) >> (8 * i)) & 0xff);
+		}
+	}
+
+	template <typename T>
+	T get(const char*& in) {
+		UINT64 value = 0;
+		for (size_t i = 0; i < sizeof(T); i++) {
+			value |= static_cast<UINT64>(static_cast<UINT8>(*in++)) << (8 * i);
+		}
+		return static_cast<T>(value);
+	}
+
+	INT16 clamp_delta(LONG delta) {
+		return static_cast<INT16>(std::clamp<LONG>(delta, INT16_MIN, INT16_MAX));
+	}
+}
+
+LiveInput::LiveInput(HWND hwnd) :
+	start(std::chrono::steady_clock::now())
+{
+	RECT rect;
+	GetClientRect(hwnd, &rect);
+
+	center_x = (rect.right - rect.left) / 2;
+	center_y = (rect.bottom - rect.top) / 2;
+
+	SetCursorPos(center_x, center_y);
+}
+
+bool LiveInput::next(input_frame_t& frame) {
+	frame.keys = 0;
+	if (GetAsyncKeyState(0x57) & 0x8000) { // W
+		frame.keys |= input_frame_t::KEY_FORWARD;
+	}
+	if (GetAsyncKeyState(0x41) & 0x8000) { // A
+		frame.keys |= input_frame_t::KEY_LEFT;
+	}
+	if (GetAsyncKeyState(0x53) & 0x8000) { // S
+		frame.keys |= input_frame_t::KEY_BACKWARD;
+	}
+	if (GetAsyncKeyState(0x44) & 0x8000) { // D
+		frame.keys |= input_frame_t::KEY_RIGHT;
+	}
+
+	// each tick we look for the change in cursor position
+	// and reset it to the center of the window
+	POINT cursor_pos;
+	GetCursorPos(&cursor_pos);
+	SetCursorPos(center_x, center_y);
+	frame.mouse_dx = clamp_delta(cursor_pos.x - center_x);
+	frame.mouse_dy = clamp_delta(cursor_pos.y - center_y);
+
+	const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start);
+	frame.time_ms = static_cast<UINT32>(elapsed.count());
+	return true;
+}
+
+InputRecorder::InputRecorder(std::unique_ptr<InputSource> source, PCWSTR path) :
+	source(std::move(source)),
+	file(std::filesystem::path(path), std::ios::binary)
+{
+	char header[HEADER_SIZE];
+	char* out = header;
+	for (char c : MAGIC) {
+		put(out, c);
+	}
+	put(out, VERSION);
+	file.write(header, sizeof(header));
+	if (!file) {
+		throw "Cannot write the input recording";
+	}
+}
+
+bool InputRecorder::next(input_frame_t& frame) {
+	if (!source->next(frame)) {
+		return false;
+	}
+	char record[FRAME_SIZE];
+	char* out = record;
+	put(out, frame.keys);
+	put(out, frame.mouse_dx);
+	put(out, frame.mouse_dy);
+	put(out, frame.time_ms);
+	file.write(record, sizeof(record));
+	return true;
+}
+
+InputReplay::InputReplay(PCWSTR path) {
+	std::ifstream file(std::filesystem::path(path), std::ios::binary);
+	const std::vector<char> data{
+		std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	if (data.size() < HEADER_SIZE || !std::equal(std::begin(MAGIC), std::end(MAGIC), data.begin())) {
+		throw "Invalid input recording";
+	}
+	const char* in = data.data() + sizeof(MAGIC);
+	if (get<UINT32>(in) != VERSION) {
+		throw "Unsupported input recording version";
+	}
+
+	// a tick cut off by a crash while recording is dropped
+	frames.resize((data.size() - HEADER_SIZE) / FRAME_SIZE);
+	for (auto& frame : frames) {
+		frame.keys = get<UINT8>(in);
+		frame.mouse_dx = get<INT16>(in);
+		frame.mouse_dy = get<INT16>(in);
+		frame.time_ms = get<UINT32>(in);
+	}
+}
+
+bool InputReplay::next(input_frame_t& frame) {
+	if (position == frames.size()) {
+		return false;
+	}
+	frame = frames[position++];
+	return true;
+}
+
+size_t InputReplay::size() const {
+	return frames.size();
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <Windows.h>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+/*
+ * Input of a single simulation tick.
+ */
+struct input_frame_t {
+	static constexpr UINT8 KEY_FORWARD = 1 << 0;   // W
+	static constexpr UINT8 KEY_LEFT = 1 << 1;      // A
+	static constexpr UINT8 KEY_BACKWARD = 1 << 2;  // S
+	static constexpr UINT8 KEY_RIGHT = 1 << 3;     // D
+
+	UINT8 keys;
+	INT16 mouse_dx;
+	INT16 mouse_dy;
+	UINT32 time_ms;     // animation time of the tick
+};
+
+/*
+ * Source of per-tick input. Everything the simulation depends on
+ * comes from here, so replaying a recorded stream reproduces
+ * the same frames.
+ */
+class InputSource {
+public:
+	virtual ~InputSource() = default;
+	// Returns false when there is no more input, `frame` is unchanged then.
+	virtual bool next(input_frame_t& frame) = 0;
+};
+
+/*
+ * Keyboard and mouse of the user. The cursor is moved back to
+ * the center of the window after every tick, the offset from the
+ * center is the mouse movement.
+ */
+class LiveInput : public InputSource {
+public:
+	LiveInput(HWND hwnd);
+	bool next(input_frame_t& frame) override;
+
+private:
+	int center_x;
+	int center_y;
+	std::chrono::steady_clock::time_point start;
+};
+
+/*
+ * Passes the input of another source through and appends it to a file.
+ *
+ * The file is a header followed by 9 bytes per tick: the key bits,
+ * the mouse movement and the time, little-endian.
+ */
+class InputRecorder : public InputSource {
+public:
+	// Throws if the file cannot be written.
+	InputRecorder(std::unique_ptr<InputSource> source, PCWSTR path);
+	bool next(input_frame_t& frame) override;
+
+private:
+	std::unique_ptr<InputSource> source;
+	std::ofstream file;
+};
+
+/*
+ * Plays a file written by InputRecorder back.
+ */
+class InputReplay : public InputSource {
+public:
+	// Loads the whole file, throws if it is not a recording.
+	InputReplay(PCWSTR path);
+	bool next(input_frame_t& frame) override;
+	size_t size() const;
+
+private:
+	std::vector<input_frame_t> frames;
+	size_t position = 0;
+};
+
+#endif // INPUT_H
\ No newline at end of file
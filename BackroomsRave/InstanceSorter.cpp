@@ -0,0 +1,189 @@
+#include "InstanceSorter.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "simd.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr UINT32 DIGITS = 256;
+	constexpr UINT32 MAX_KEY = 0xffff;
+	constexpr UINT32 OUT_OF_RANGE = UINT32_MAX;
+}
+
+InstanceSorter::InstanceSorter(size_t max_instances, FLOAT near_depth, FLOAT far_depth) :
+	near_depth(near_depth),
+	far_depth(far_depth)
+{
+	const size_t max_clusters = (max_instances + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+	for (std::vector<FLOAT>& axis : center) {
+		axis.reserve(lane_padded(max_clusters));
+	}
+	radius.reserve(lane_padded(max_clusters));
+	clusters.reserve(max_clusters);
+	keys.reserve(lane_padded(max_clusters));
+	items[0].reserve(max_clusters);
+	items[1].reserve(max_clusters);
+	histograms.resize((std::max)((max_clusters + RADIX_BLOCK - 1) / RADIX_BLOCK, size_t(1)) * DIGITS);
+	order.reserve(max_clusters);
+}
+
+/*
+ * The world matrix of an instance maps the base square, from -1 to 1,
+ * so its first two rows reach from its center to its edges.
+ */
+void InstanceSorter::set_instances(std::span<const square_instance_t> instances) {
+	for (std::vector<FLOAT>& axis : center) {
+		axis.clear();
+	}
+	radius.clear();
+	clusters.clear();
+	for (size_t first = 0; first < instances.size(); first += CLUSTER_SIZE) {
+		const std::span<const square_instance_t> cluster =
+			instances.subspan(first, (std::min)(CLUSTER_SIZE, instances.size() - first));
+		XMVECTOR lower = XMVectorReplicate(FLT_MAX);
+		XMVECTOR upper = XMVectorReplicate(-FLT_MAX);
+		for (const square_instance_t& instance : cluster) {
+			const XMVECTOR p = XMVectorSet(instance.world._41, instance.world._42, instance.world._43, 0.0f);
+			lower = XMVectorMin(lower, p);
+			upper = XMVectorMax(upper, p);
+		}
+		const XMVECTOR middle = XMVectorScale(XMVectorAdd(lower, upper), 0.5f);
+		FLOAT reach = 0.0f;
+		for (const square_instance_t& instance : cluster) {
+			const XMFLOAT4X4& world = instance.world;
+			const XMVECTOR p = XMVectorSet(world._41, world._42, world._43, 0.0f);
+			const FLOAT corner = std::sqrt(
+				world._11 * world._11 + world._12 * world._12 + world._13 * world._13
+				+ world._21 * world._21 + world._22 * world._22 + world._23 * world._23);
+			reach = (std::max)(reach,
+				XMVectorGetX(XMVector3Length(XMVectorSubtract(p, middle))) + corner);
+		}
+
+		center[0].push_back(XMVectorGetX(middle));
+		center[1].push_back(XMVectorGetY(middle));
+		center[2].push_back(XMVectorGetZ(middle));
+		radius.push_back(reach);
+		clusters.push_back({ static_cast<UINT32>(first), static_cast<UINT32>(cluster.size()) });
+	}
+	for (std::vector<FLOAT>& axis : center) {
+		axis.resize(lane_padded(clusters.size()), 0.0f);
+	}
+	radius.resize(lane_padded(clusters.size()), 0.0f);
+	keys.resize(lane_padded(clusters.size()));
+	order.clear();
+	has_order = false;
+}
+
+/*
+ * Row 2 of the transposed view matrix gives the view depth of a point.
+ * Radix passes go from the lower digit to the higher one; every block
+ * scatters its keys, in order, after the same digits of the blocks
+ * before it, so equal keys keep the order of their clusters.
+ */
+bool InstanceSorter::sort(const XMFLOAT4X4& view, JobSystem& jobs) {
+	const XMFLOAT4 axis = { view._31, view._32, view._33, view._34 };
+	if (has_order
+		&& std::abs(axis.x - last_axis.x) < TURN_EPSILON
+		&& std::abs(axis.y - last_axis.y) < TURN_EPSILON
+		&& std::abs(axis.z - last_axis.z) < TURN_EPSILON
+		&& std::abs(axis.w - last_axis.w) < MOVE_EPSILON)
+	{
+		return false;
+	}
+	has_order = true;
+	last_axis = axis;
+
+	// 16-bit keys, four clusters at a time
+	const size_t lanes = lane_padded(clusters.size());
+	const FLOAT key_scale = MAX_KEY / (far_depth - near_depth);
+	jobs.parallel_for(lanes / 4, RADIX_BLOCK / 4, [&](size_t begin, size_t end) {
+		const XMVECTOR near_plane = XMVectorReplicate(near_depth);
+		const XMVECTOR far_plane = XMVectorReplicate(far_depth);
+		for (size_t i = begin * 4; i < end * 4; i += 4) {
+			const XMVECTOR depth = XMVectorMultiplyAdd(load_lane(center[0], i), XMVectorReplicate(axis.x),
+				XMVectorMultiplyAdd(load_lane(center[1], i), XMVectorReplicate(axis.y),
+				XMVectorMultiplyAdd(load_lane(center[2], i), XMVectorReplicate(axis.z),
+				XMVectorReplicate(axis.w))));
+			const XMVECTOR reach = load_lane(radius, i);
+			const XMVECTOR in_range = XMVectorAndInt(
+				XMVectorGreaterOrEqual(XMVectorAdd(depth, reach), near_plane),
+				XMVectorLessOrEqual(XMVectorSubtract(depth, reach), far_plane));
+			const XMVECTOR key = XMVectorClamp(
+				XMVectorScale(XMVectorSubtract(depth, near_plane), key_scale),
+				XMVectorZero(), XMVectorReplicate(static_cast<FLOAT>(MAX_KEY)));
+			XMFLOAT4 lane_keys;
+			XMStoreFloat4(&lane_keys, key);
+			UINT32 visible[4];
+			XMStoreInt4(visible, in_range);
+			const FLOAT values[4] = { lane_keys.x, lane_keys.y, lane_keys.z, lane_keys.w };
+			for (size_t l = 0; l < 4; l++) {
+				keys[i + l] = visible[l] ? static_cast<UINT32>(values[l]) : OUT_OF_RANGE;
+			}
+		}
+	});
+
+	std::vector<UINT64>& sorted = items[0];
+	std::vector<UINT64>& scratch = items[1];
+	sorted.clear();
+	for (UINT32 c = 0; c < clusters.size(); c++) {
+		if (keys[c] != OUT_OF_RANGE) {
+			sorted.push_back(static_cast<UINT64>(keys[c]) << 32 | c);
+		}
+	}
+	scratch.resize(sorted.size());
+
+	const size_t count = sorted.size();
+	const size_t blocks = (count + RADIX_BLOCK - 1) / RADIX_BLOCK;
+	for (UINT32 shift = 32; shift < 48; shift += 8) {
+		const std::vector<UINT64>& source = shift == 32 ? sorted : scratch;
+		std::vector<UINT64>& target = shift == 32 ? scratch : sorted;
+		jobs.parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++) {
+				UINT32* histogram = histograms.data() + b * DIGITS;
+				std::fill_n(histogram, DIGITS, 0u);
+				for (size_t i = b * RADIX_BLOCK; i < (std::min)((b + 1) * RADIX_BLOCK, count); i++) {
+					histogram[(source[i] >> shift) & (DIGITS - 1)]++;
+				}
+			}
+		});
+		UINT32 offset = 0;
+		for (UINT32 d = 0; d < DIGITS; d++) {
+			for (size_t b = 0; b < blocks; b++) {
+				const UINT32 digits = histograms[b * DIGITS + d];
+				histograms[b * DIGITS + d] = offset;
+				offset += digits;
+			}
+		}
+		jobs.parallel_for(blocks, 1, [&](size_t begin, size_t end) {
+			for (size_t b = begin; b < end; b++) {
+				UINT32* next = histograms.data() + b * DIGITS;
+				for (size_t i = b * RADIX_BLOCK; i < (std::min)((b + 1) * RADIX_BLOCK, count); i++) {
+					target[next[(source[i] >> shift) & (DIGITS - 1)]++] = source[i];
+				}
+			}
+		});
+	}
+
+	order.clear();
+	for (UINT64 item : sorted) {
+		const instance_range_t& cluster = clusters[static_cast<UINT32>(item)];
+		if (!order.empty() && order.back().first + order.back().count == cluster.first) {
+			order.back().count += cluster.count;
+		}
+		else {
+			order.push_back(cluster);
+		}
+	}
+	return true;
+}
+
+std::span<const instance_range_t> InstanceSorter::get_order() const {
+	return order;
+}
+
+size_t InstanceSorter::get_cluster_count() const {
+	return clusters.size();
+}
\ No newline at end of file
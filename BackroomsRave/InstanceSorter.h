@@ -0,0 +1,76 @@
+#ifndef INSTANCE_SORTER_H
+#define INSTANCE_SORTER_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <span>
+#include <vector>
+#include "JobSystem.h"
+#include "types.h"
+
+/*
+ * Consecutive instances drawn by one draw call.
+ */
+struct instance_range_t {
+	UINT32 first;
+	UINT32 count;
+};
+
+/*
+ * Front-to-back draw order of instances, so the depth test rejects the
+ * pixels hidden behind near walls before they are shaded.
+ *
+ * Instances are sorted in clusters of CLUSTER_SIZE consecutive ones,
+ * which for the tiles of a rectangle are close to each other. A cluster
+ * is keyed by the view depth of its center, quantized to 16 bits between
+ * the near and the far depth, and clusters out of that range are left
+ * out. The keys are computed four clusters at a time and sorted by a
+ * parallel radix sort of two 8-bit digits, in blocks of RADIX_BLOCK keys
+ * that each job counts and scatters, stable whatever the thread count.
+ *
+ * View depth depends only on the view direction and the depth of the
+ * camera along it, so the order of the last sort is kept while they
+ * change by less than TURN_EPSILON and MOVE_EPSILON.
+ */
+class InstanceSorter {
+public:
+	static constexpr size_t CLUSTER_SIZE = 64;
+	static constexpr size_t RADIX_BLOCK = 4096;
+	static constexpr FLOAT MOVE_EPSILON = 1.0f / 64.0f;
+	static constexpr FLOAT TURN_EPSILON = 1.0f / 256.0f;
+
+	// Has room for up to `max_instances` instances, so set_instances
+	// and sort do not allocate.
+	InstanceSorter(size_t max_instances, FLOAT near_depth, FLOAT far_depth);
+
+	// Takes the instances to sort, the next sort does not keep the order.
+	void set_instances(std::span<const square_instance_t> instances);
+
+	// Sorts the clusters for `view`, the transposed view matrix of the
+	// vertex shader constants. Returns false if the last order is kept.
+	bool sort(const DirectX::XMFLOAT4X4& view, JobSystem& jobs);
+
+	// Visible instances front to back, neighbouring clusters joined.
+	std::span<const instance_range_t> get_order() const;
+	size_t get_cluster_count() const;
+
+private:
+	FLOAT near_depth;
+	FLOAT far_depth;
+
+	// clusters, structure of arrays padded to whole lanes
+	std::vector<FLOAT> center[3];
+	std::vector<FLOAT> radius;      // of the bounding sphere
+	std::vector<instance_range_t> clusters;
+
+	// radix sort of the visible clusters
+	std::vector<UINT32> keys;       // UINT32_MAX when out of range
+	std::vector<UINT64> items[2];   // key << 32 | cluster
+	std::vector<UINT32> histograms; // 256 digits per block
+
+	std::vector<instance_range_t> order;
+	DirectX::XMFLOAT4 last_axis = {};
+	bool has_order = false;
+};
+
+#endif // INSTANCE_SORTER_H
\ No newline at end of file
@@ -0,0 +1,158 @@
+#include "JobSystem.h"
+
+namespace {
+	// queue of the current thread, workers of one job system only
+	thread_local const JobSystem* current_system = nullptr;
+	thread_local size_t current_queue_index = 0;
+}
+
+JobSystem::JobSystem(size_t thread_count) {
+	thread_count = (std::max)(thread_count, size_t(1));
+	for (size_t i = 0; i < thread_count; i++) {
+		queues.push_back(std::make_unique<queue_t>());
+	}
+	// the waiting thread is the first one
+	for (size_t i = 1; i < thread_count; i++) {
+		workers.emplace_back(&JobSystem::work, this, i);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		running = false;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+/*
+ * Appends a job, doubling the ring when it is full.
+ */
+void JobSystem::queue_t::push_back(job_t job) {
+	if (size == jobs.size()) {
+		std::vector<job_t> grown((std::max)(jobs.size() * 2, size_t(16)));
+		for (size_t i = 0; i < size; i++) {
+			grown[i] = std::move(jobs[(first + i) % jobs.size()]);
+		}
+		jobs = std::move(grown);
+		first = 0;
+	}
+	jobs[(first + size) % jobs.size()] = std::move(job);
+	size++;
+}
+
+JobSystem::job_t JobSystem::queue_t::pop_back() {
+	size--;
+	return std::move(jobs[(first + size) % jobs.size()]);
+}
+
+JobSystem::job_t JobSystem::queue_t::pop_front() {
+	job_t job = std::move(jobs[first]);
+	first = (first + 1) % jobs.size();
+	size--;
+	return job;
+}
+
+size_t JobSystem::get_thread_count() const {
+	return queues.size();
+}
+
+size_t JobSystem::current_queue() const {
+	return current_system == this ? current_queue_index : 0;
+}
+
+void JobSystem::run(std::function<void()> job, counter_t& counter) {
+	push({ std::move(job), nullptr, nullptr, 0, 0, &counter });
+}
+
+/*
+ * Queues a job on the thread's own queue and wakes a worker.
+ */
+void JobSystem::push(job_t job) {
+	job.counter->fetch_add(1, std::memory_order_relaxed);
+	queue_t& queue = *queues[current_queue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.push_back(std::move(job));
+	}
+	queued_jobs.fetch_add(1);
+	{
+		// do not let a worker go to sleep between the check and the wait
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+void JobSystem::wait(const counter_t& counter) {
+	const size_t queue = current_queue();
+	while (counter.load(std::memory_order_acquire) > 0) {
+		if (!try_execute(queue)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+/*
+ * Takes the newest job of the thread's own queue.
+ */
+bool JobSystem::pop(size_t queue_index, job_t& job) {
+	queue_t& queue = *queues[queue_index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.size == 0) {
+		return false;
+	}
+	job = queue.pop_back();
+	return true;
+}
+
+/*
+ * Takes the oldest job of another queue.
+ */
+bool JobSystem::steal(size_t thief, job_t& job) {
+	for (size_t i = 1; i < queues.size(); i++) {
+		queue_t& queue = *queues[(thief + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.size > 0) {
+			job = queue.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::try_execute(size_t queue) {
+	job_t job;
+	if (!pop(queue, job) && !steal(queue, job)) {
+		return false;
+	}
+	queued_jobs.fetch_sub(1);
+	if (job.function) {
+		job.function();
+	}
+	else {
+		job.range_function(job.context, job.begin, job.end);
+	}
+	job.counter->fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+/*
+ * Worker loop, sleeps while there are no jobs.
+ */
+void JobSystem::work(size_t queue) {
+	current_system = this;
+	current_queue_index = queue;
+	while (true) {
+		if (try_execute(queue)) {
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this] { return !running || queued_jobs.load() > 0; });
+		if (!running) {
+			return;
+		}
+	}
+}
\ No newline at end of file
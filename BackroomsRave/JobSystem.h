@@ -0,0 +1,132 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing job scheduler.
+ *
+ * Every worker owns a deque of jobs: it pushes and pops its own jobs
+ * at the back, idle workers steal from the front of the others.
+ * Threads that are not workers share one more deque. A thread that
+ * waits for jobs runs queued jobs in the meantime, so jobs may
+ * start and wait for other jobs.
+ *
+ * Completion is tracked with counters: run increments the counter
+ * of a job, finishing the job decrements it.
+ *
+ * Deques are ring buffers that only grow, and parallel_for queues
+ * plain function pointers to its ranges instead of std::function,
+ * so splitting work does not allocate once the queues have grown
+ * to their working size.
+ */
+class JobSystem {
+public:
+	using counter_t = std::atomic<size_t>;
+
+	// `thread_count` includes the thread that waits for jobs.
+	JobSystem(size_t thread_count = std::thread::hardware_concurrency());
+	~JobSystem();
+
+	size_t get_thread_count() const;
+
+	// Jobs must not throw, parallel_for forwards exceptions of its body.
+	void run(std::function<void()> job, counter_t& counter);
+	void wait(const counter_t& counter);
+
+	// Calls body(begin, end) for consecutive ranges of at most `grain`
+	// of `count` indices. Results written by index do not depend on
+	// the order in which the ranges run.
+	template <typename F>
+	void parallel_for(size_t count, size_t grain, const F& body);
+
+private:
+	using range_function_t = void (*)(void* context, size_t begin, size_t end);
+
+	struct job_t {
+		std::function<void()> function;
+		// used instead of `function` when it is empty
+		range_function_t range_function;
+		void* context;
+		size_t begin;
+		size_t end;
+		counter_t* counter;
+	};
+	struct queue_t {
+		std::mutex mutex;
+		std::vector<job_t> jobs;    // ring buffer
+		size_t first = 0;
+		size_t size = 0;
+
+		void push_back(job_t job);
+		job_t pop_back();
+		job_t pop_front();
+	};
+
+	size_t current_queue() const;
+	void push(job_t job);
+	bool pop(size_t queue, job_t& job);
+	bool steal(size_t thief, job_t& job);
+	bool try_execute(size_t queue);
+	void work(size_t queue);
+
+	// queue 0 is shared by threads that are not workers
+	std::vector<std::unique_ptr<queue_t>> queues;
+	std::vector<std::thread> workers;
+
+	std::atomic<size_t> queued_jobs = 0;
+	bool running = true;
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+};
+
+template <typename F>
+void JobSystem::parallel_for(size_t count, size_t grain, const F& body) {
+	grain = (std::max)(grain, size_t(1));
+	if (count <= grain) {
+		// not worth splitting
+		if (count > 0) {
+			body(size_t(0), count);
+		}
+		return;
+	}
+
+	// shared by all ranges, jobs only point to it
+	struct state_t {
+		const F& body;
+		counter_t counter = 0;
+		std::mutex error_mutex = {};
+		std::exception_ptr error = nullptr;
+	} state{ body };
+
+	const range_function_t run_range = [](void* context, size_t begin, size_t end) {
+		state_t& state = *static_cast<state_t*>(context);
+		try {
+			state.body(begin, end);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(state.error_mutex);
+			if (!state.error) {
+				state.error = std::current_exception();
+			}
+		}
+	};
+	for (size_t begin = 0; begin < count; begin += grain) {
+		const size_t end = (std::min)(begin + grain, count);
+		push({ nullptr, run_range, &state, begin, end, &state.counter });
+	}
+	wait(state.counter);
+	if (state.error) {
+		std::rethrow_exception(state.error);
+	}
+}
+
+#endif // JOB_SYSTEM_H
\ No newline at end of file
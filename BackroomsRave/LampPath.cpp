@@ -0,0 +1,106 @@
+#include "LampPath.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+	using namespace DirectX;
+
+	// curve evaluations per segment used to measure the length
+	constexpr size_t DENSE_SAMPLES_PER_SEGMENT = 64;
+	// equally spaced samples per segment kept in the table
+	constexpr size_t TABLE_SAMPLES_PER_SEGMENT = 16;
+
+	size_t segment_count(const lamp_desc_t& lamp) {
+		const size_t n = lamp.points.size();
+		switch (lamp.type) {
+		case path_type_t::BEZIER:
+			if (lamp.loop ? n % 3 != 0 : n % 3 != 1) {
+				throw "Invalid Bezier path";
+			}
+			return n / 3;
+		default:
+			return lamp.loop ? n : n - 1;
+		}
+	}
+
+	XMVECTOR point(const lamp_desc_t& lamp, std::ptrdiff_t idx) {
+		const std::ptrdiff_t n = static_cast<std::ptrdiff_t>(lamp.points.size());
+		idx = lamp.loop ? ((idx % n) + n) % n : std::clamp<std::ptrdiff_t>(idx, 0, n - 1);
+		return XMLoadFloat3(&lamp.points[idx]);
+	}
+
+	/*
+	 * Evaluates segment `seg` of the path at u in [0, 1].
+	 */
+	XMVECTOR evaluate(const lamp_desc_t& lamp, size_t seg, float u) {
+		const std::ptrdiff_t i = static_cast<std::ptrdiff_t>(seg);
+		switch (lamp.type) {
+		case path_type_t::CATMULL_ROM:
+			return XMVectorCatmullRom(
+				point(lamp, i - 1), point(lamp, i),
+				point(lamp, i + 1), point(lamp, i + 2), u);
+		case path_type_t::BEZIER: {
+			// de Casteljau
+			XMVECTOR p0 = point(lamp, 3 * i);
+			XMVECTOR p1 = point(lamp, 3 * i + 1);
+			XMVECTOR p2 = point(lamp, 3 * i + 2);
+			XMVECTOR p3 = point(lamp, 3 * i + 3);
+			XMVECTOR a = XMVectorLerp(p0, p1, u);
+			XMVECTOR b = XMVectorLerp(p1, p2, u);
+			XMVECTOR c = XMVectorLerp(p2, p3, u);
+			return XMVectorLerp(XMVectorLerp(a, b, u), XMVectorLerp(b, c, u), u);
+		}
+		default:
+			return XMVectorLerp(point(lamp, i), point(lamp, i + 1), u);
+		}
+	}
+}
+
+std::vector<DirectX::XMFLOAT3> build_arc_length_table(const lamp_desc_t& lamp) {
+	if (lamp.points.empty()) {
+		throw "Empty lamp path";
+	}
+	if (lamp.points.size() == 1) {
+		return { lamp.points[0], lamp.points[0] };
+	}
+
+	const size_t segments = segment_count(lamp);
+	const bool straight = lamp.type == path_type_t::WAYPOINTS;
+	if (straight && segments == 1) {
+		// a single line is already uniform
+		return { lamp.points[0], lamp.points[1] };
+	}
+
+	// measure the curve
+	const size_t dense_per_segment = straight ? 1 : DENSE_SAMPLES_PER_SEGMENT;
+	const size_t dense_count = segments * dense_per_segment + 1;
+	std::vector<XMFLOAT3> dense(dense_count);
+	std::vector<float> length(dense_count, 0.0f);
+	for (size_t k = 0; k < dense_count; k++) {
+		size_t seg = std::min(k / dense_per_segment, segments - 1);
+		float u = static_cast<float>(k - seg * dense_per_segment) / dense_per_segment;
+		XMStoreFloat3(&dense[k], evaluate(lamp, seg, u));
+		if (k > 0) {
+			length[k] = length[k - 1] + XMVectorGetX(XMVector3Length(XMVectorSubtract(
+				XMLoadFloat3(&dense[k]), XMLoadFloat3(&dense[k - 1]))));
+		}
+	}
+
+	// resample at equal distances along the curve
+	const size_t table_count = segments * TABLE_SAMPLES_PER_SEGMENT + 1;
+	const float total_length = length.back();
+	std::vector<XMFLOAT3> table(table_count);
+	size_t j = 0;
+	for (size_t k = 0; k < table_count; k++) {
+		float s = total_length * k / (table_count - 1);
+		while (j + 2 < dense_count && length[j + 1] < s) {
+			j++;
+		}
+		float span = length[j + 1] - length[j];
+		float f = span > 0.0f ? std::clamp((s - length[j]) / span, 0.0f, 1.0f) : 0.0f;
+		XMStoreFloat3(&table[k], XMVectorLerp(
+			XMLoadFloat3(&dense[j]), XMLoadFloat3(&dense[j + 1]), f));
+	}
+	return table;
+}
@@ -0,0 +1,35 @@
+#ifndef LAMP_PATH_H
+#define LAMP_PATH_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+/*
+ * Kind of curve a lamp follows through its points.
+ */
+enum class path_type_t {
+	WAYPOINTS,      // straight lines between the points
+	CATMULL_ROM,    // smooth curve through all the points
+	BEZIER          // cubic segments: point, control, control, point, ...
+};
+
+/*
+ * Description of a lamp path. Open paths are travelled back and forth,
+ * loops are travelled around in one direction.
+ */
+struct lamp_desc_t {
+	std::vector<DirectX::XMFLOAT3> points;
+	float speed;    // part of the whole path travelled during an update
+	path_type_t type = path_type_t::WAYPOINTS;
+	bool loop = false;
+};
+
+/*
+ * Samples a lamp path at points equally spaced along its length,
+ * so that stepping through the samples at a constant rate moves
+ * the lamp at a constant speed. The first and the last sample are
+ * the ends of the path (the same point for loops).
+ */
+std::vector<DirectX::XMFLOAT3> build_arc_length_table(const lamp_desc_t& lamp);
+
+#endif // LAMP_PATH_H
\ No newline at end of file
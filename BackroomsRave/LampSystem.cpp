@@ -0,0 +1,264 @@
+#include "LampSystem.h"
+
+#include <algorithm>
+#include <bit>
+#include "Rectangle.h"
+#include "counter_rng.h"
+#include "simd.h"
+
+namespace {
+	/*
+	 * Builds the six faces of a lamp cube centered at the origin.
+	 * Lamp instances only differ from these by translation and color.
+	 */
+	std::array<square_instance_t, LampSystem::INSTANCES_PER_LAMP> build_cube() {
+		const DirectX::XMFLOAT4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+		AxisRectangle faces[] = {
+			// top face
+			AxisRectangle({ -0.25f, 0.25f, -0.25f }, { 0.25f, 0.25f, 0.25f },
+				{ 0.5f, 0.5f }, true, 0.5f, color),
+			// bottom face
+			AxisRectangle({ -0.25f, -0.25f, -0.25f }, { 0.25f, -0.25f, 0.25f },
+				{ 0.5f, 0.0f }, false, 0.5f, color),
+			// north face
+			AxisRectangle({ -0.25f, -0.25f, 0.25f }, { 0.25f, 0.25f, 0.25f },
+				{ 0.5f, 0.0f }, true, 0.5f, color),
+			// south face
+			AxisRectangle({ -0.25f, -0.25f, -0.25f }, { 0.25f, 0.25f, -0.25f },
+				{ 0.5f, 0.0f }, false, 0.5f, color),
+			// west face
+			AxisRectangle({ -0.25f, -0.25f, -0.25f }, { -0.25f, 0.25f, 0.25f },
+				{ 0.5f, 0.0f }, false, 0.5f, color),
+			// east face
+			AxisRectangle({ 0.25f, -0.25f, -0.25f }, { 0.25f, 0.25f, 0.25f },
+				{ 0.5f, 0.0f }, true, 0.5f, color),
+		};
+
+		std::array<square_instance_t, LampSystem::INSTANCES_PER_LAMP> cube;
+		for (size_t i = 0; i < cube.size(); i++) {
+			// every face is a single tile
+			cube[i] = faces[i].get_instances().front();
+		}
+		return cube;
+	}
+
+	/*
+	 * Counter of a color channel of a lamp at a beat.
+	 */
+	constexpr uint64_t color_counter(uint64_t lamp, uint64_t beat, uint64_t channel) {
+		return (beat << 34) | (lamp << 2) | channel;
+	}
+
+	/*
+	 * Upper 12 significant bits of a float, the rest is exactly
+	 * `value - high_bits(value)`.
+	 */
+	float high_bits(float value) {
+		return std::bit_cast<float>(std::bit_cast<uint32_t>(value) & 0xfffff000u);
+	}
+
+	/*
+	 * Part of `x` past a whole number of `period`, 1 or 2. Exact,
+	 * the result only keeps bits that `x` has.
+	 */
+	DirectX::XMVECTOR phase_of(DirectX::FXMVECTOR x, DirectX::FXMVECTOR period,
+		DirectX::FXMVECTOR inverse_period) {
+		using namespace DirectX;
+		return XMVectorNegativeMultiplySubtract(
+			period, XMVectorFloor(XMVectorMultiply(x, inverse_period)), x);
+	}
+}
+
+LampSystem::LampSystem(std::span<const lamp_desc_t> lamps, uint64_t seed,
+	JobSystem& jobs) :
+	count(lamps.size()),
+	jobs(jobs),
+	cube(build_cube()),
+	key(rng_key(seed)),
+	beat(0)
+{
+	const size_t padded = lane_padded(count);
+	for (auto array : { &t, &speed, &speed_high, &speed_low, &loop, &pos_x, &pos_y, &pos_z }) {
+		array->resize(padded, 0.0f);
+	}
+	for (auto array : { &direction, &color_r, &color_g, &color_b }) {
+		array->resize(padded, 1.0f);
+	}
+	table_offset.resize(count);
+	table_size.resize(count);
+
+	for (size_t i = 0; i < count; i++) {
+		auto lamp_table = build_arc_length_table(lamps[i]);
+		table_offset[i] = table.size();
+		table_size[i] = lamp_table.size();
+		table.insert(table.end(), lamp_table.begin(), lamp_table.end());
+
+		speed[i] = lamps[i].speed;
+		speed_high[i] = high_bits(speed[i]);
+		speed_low[i] = speed[i] - speed_high[i];
+		loop[i] = lamps[i].loop ? 1.0f : 0.0f;
+		pos_x[i] = lamp_table.front().x;
+		pos_y[i] = lamp_table.front().y;
+		pos_z[i] = lamp_table.front().z;
+	}
+
+	change_colors(beat);
+}
+
+size_t LampSystem::size() const {
+	return count;
+}
+
+uint64_t LampSystem::get_beat() const {
+	return beat;
+}
+
+DirectX::XMFLOAT4 LampSystem::get_color(size_t lamp, uint64_t beat) const {
+	return {
+		rng_unit_float(squares32(color_counter(lamp, beat, 0), key)),
+		rng_unit_float(squares32(color_counter(lamp, beat, 1), key)),
+		rng_unit_float(squares32(color_counter(lamp, beat, 2), key)),
+		1.0f
+	};
+}
+
+/*
+ * Finds the table sample preceding lamp's current position
+ * and the fraction of the way to the next one.
+ */
+size_t LampSystem::table_segment(size_t lamp, float& fraction) const {
+	const size_t last = table_size[lamp] - 1;
+	float u = t[lamp] * last;
+	size_t k = (std::min)(static_cast<size_t>(u), last - 1);
+	fraction = u - k;
+	return table_offset[lamp] + k;
+}
+
+void LampSystem::update(uint64_t tick, uint64_t time_ms) {
+	jobs.parallel_for(t.size(), LAMPS_PER_JOB, [this, tick](size_t begin, size_t end) {
+		update_range(tick, begin, end);
+	});
+
+	uint64_t current_beat = time_ms / color_change_interval_ms;
+	if (current_beat != beat) {
+		beat = current_beat;
+		change_colors(beat);
+	}
+}
+
+/*
+ * Places lamps [begin, end) at `tick`, `begin` is a multiple of 4.
+ * An open path is travelled to its end and back every two path
+ * lengths, a loop once per length.
+ *
+ * The tick is split into 12-bit parts and the speeds into their upper
+ * and lower 12 bits, so every part of the distance travelled is exact
+ * in float. The whole paths are dropped from each part before they are
+ * summed, which keeps the phase as precise at any tick below 2^36 as
+ * at the start.
+ */
+void LampSystem::update_range(uint64_t tick, size_t begin, size_t end) {
+	using namespace DirectX;
+
+	const XMVECTOR tick_parts[] = {
+		XMVectorReplicate(static_cast<float>(tick & 0xfff)),
+		XMVectorReplicate(static_cast<float>(tick & 0xfff000)),
+		XMVectorReplicate(static_cast<float>(tick & 0xfff000000)),
+	};
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR two = XMVectorReplicate(2.0f);
+	const XMVECTOR minus_one = XMVectorNegate(one);
+
+	for (size_t i = begin; i < end; i += 4) {
+		const XMVECTOR is_loop = XMVectorGreater(load_lane(loop, i), half);
+		const XMVECTOR period = XMVectorSelect(two, one, is_loop);
+		const XMVECTOR inverse_period = XMVectorSelect(half, one, is_loop);
+		const XMVECTOR high = load_lane(speed_high, i);
+		const XMVECTOR low = load_lane(speed_low, i);
+
+		XMVECTOR phase = XMVectorZero();
+		for (const XMVECTOR& part : tick_parts) {
+			phase = XMVectorAdd(phase, phase_of(XMVectorMultiply(part, high), period, inverse_period));
+			phase = XMVectorAdd(phase, phase_of(XMVectorMultiply(part, low), period, inverse_period));
+		}
+		phase = phase_of(phase, period, inverse_period);
+
+		// a loop phase is below 1, so only open paths fold back
+		const XMVECTOR backwards = XMVectorGreater(phase, one);
+		store_lane(t, i, XMVectorSelect(phase, XMVectorSubtract(two, phase), backwards));
+		store_lane(direction, i, XMVectorSelect(
+			one, minus_one, XMVectorGreaterOrEqual(phase, one)));
+	}
+
+	// arc-length table lookup
+	for (size_t i = begin; i < (std::min)(end, count); i++) {
+		float f;
+		size_t k = table_segment(i, f);
+		pos_x[i] = table[k].x + f * (table[k + 1].x - table[k].x);
+		pos_y[i] = table[k].y + f * (table[k + 1].y - table[k].y);
+		pos_z[i] = table[k].z + f * (table[k + 1].z - table[k].z);
+	}
+}
+
+/*
+ * Sets the colors of all lamps for the given beat. Lamps are
+ * independent of each other, so the loop has no carried state.
+ */
+void LampSystem::change_colors(uint64_t beat) {
+	jobs.parallel_for(count, LAMPS_PER_JOB, [this, beat](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			color_r[i] = rng_unit_float(squares32(color_counter(i, beat, 0), key));
+			color_g[i] = rng_unit_float(squares32(color_counter(i, beat, 1), key));
+			color_b[i] = rng_unit_float(squares32(color_counter(i, beat, 2), key));
+		}
+	});
+}
+
+void LampSystem::write_positions(std::span<DirectX::XMFLOAT4> out) const {
+	const size_t n = (std::min)(out.size(), count);
+	for (size_t i = 0; i < n; i++) {
+		out[i] = { pos_x[i], pos_y[i], pos_z[i], 0.0f };
+	}
+}
+
+void LampSystem::write_velocities(std::span<DirectX::XMFLOAT3> out) const {
+	// distance travelled during a single update
+	const size_t n = (std::min)(out.size(), count);
+	for (size_t i = 0; i < n; i++) {
+		float f;
+		size_t k = table_segment(i, f);
+		float step = direction[i] * speed[i] * (table_size[i] - 1);
+		out[i] = {
+			step * (table[k + 1].x - table[k].x),
+			step * (table[k + 1].y - table[k].y),
+			step * (table[k + 1].z - table[k].z)
+		};
+	}
+}
+
+void LampSystem::write_colors(std::span<DirectX::XMFLOAT4> out) const {
+	const size_t n = (std::min)(out.size(), count);
+	for (size_t i = 0; i < n; i++) {
+		out[i] = { color_r[i], color_g[i], color_b[i], 1.0f };
+	}
+}
+
+void LampSystem::write_instances(std::span<square_instance_t> out) const {
+	const size_t n = (std::min)(out.size() / INSTANCES_PER_LAMP, count);
+	jobs.parallel_for(n, LAMPS_PER_JOB, [this, out](size_t begin, size_t end) {
+		auto dst = out.begin() + begin * INSTANCES_PER_LAMP;
+		for (size_t i = begin; i < end; i++) {
+			const DirectX::XMFLOAT4 color = { color_r[i], color_g[i], color_b[i], 1.0f };
+			for (const auto& face : cube) {
+				*dst = face;
+				dst->color = color;
+				// row-major world matrix, translation is in the last row
+				dst->world._41 += pos_x[i];
+				dst->world._42 += pos_y[i];
+				dst->world._43 += pos_z[i];
+				++dst;
+			}
+		}
+	});
+}
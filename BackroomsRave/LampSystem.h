@@ -0,0 +1,90 @@
+#ifndef LAMP_SYSTEM_H
+#define LAMP_SYSTEM_H
+
+#include <DirectXMath.h>
+#include <array>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include "JobSystem.h"
+#include "LampPath.h"
+#include "types.h"
+
+/*
+ * All lamps of the scene, stored as structure of arrays.
+ * Lamps move at constant speed along their paths and change
+ * color randomly on every beat of the music.
+ *
+ * Paths are turned into arc-length tables on construction, so a lamp
+ * position is a single table lookup for any kind of path.
+ *
+ * The state of the lamps is a function of the tick and the animation
+ * time passed to update, not of the updates before it, so scenes that
+ * skip ticks, like those of the offline workers, agree with a scene
+ * updated on every tick. Positions are the distance travelled after
+ * `tick` steps, folded back and forth on open paths and wrapped around
+ * on loops, summed from exact parts so that long runs do not drift.
+ *
+ * Lamp colors come from a counter-based generator, so the color
+ * of a lamp at a given beat depends only on the seed, the lamp
+ * index and the beat number. Beats are counted from the animation
+ * time, so the lamps do not depend on the clock.
+ *
+ * Lamps are updated four at a time, in jobs of LAMPS_PER_JOB lamps,
+ * and their state is written straight into caller-provided output
+ * buffers.
+ */
+class LampSystem {
+public:
+	static constexpr size_t INSTANCES_PER_LAMP = 6;
+	// multiple of 4, fewer lamps are updated on the calling thread
+	static constexpr size_t LAMPS_PER_JOB = 256;
+
+	LampSystem(std::span<const lamp_desc_t> lamps, uint64_t seed, JobSystem& jobs);
+
+	// Sets the lamps to where they are `tick` steps after the start,
+	// with the colors of the beat at `time_ms`.
+	void update(uint64_t tick, uint64_t time_ms);
+	size_t size() const;
+	uint64_t get_beat() const;
+	DirectX::XMFLOAT4 get_color(size_t lamp, uint64_t beat) const;
+
+	// Writers fill `out` with the data of as many lamps as it fits
+	// (INSTANCES_PER_LAMP elements per lamp for instances).
+	void write_positions(std::span<DirectX::XMFLOAT4> out) const;
+	void write_velocities(std::span<DirectX::XMFLOAT3> out) const;
+	void write_colors(std::span<DirectX::XMFLOAT4> out) const;
+	void write_instances(std::span<square_instance_t> out) const;
+
+private:
+	void change_colors(uint64_t beat);
+	void update_range(uint64_t tick, size_t begin, size_t end);
+	size_t table_segment(size_t lamp, float& fraction) const;
+
+	size_t count;
+	JobSystem& jobs;
+
+	// per-lamp data, padded to a multiple of 4
+	std::vector<float> t;                           // part of the path travelled
+	std::vector<float> direction;                   // +1 or -1
+	std::vector<float> speed;
+	std::vector<float> speed_high, speed_low;      // upper and lower 12 bits
+	std::vector<float> loop;                        // 1 for loops, 0 otherwise
+	std::vector<float> pos_x, pos_y, pos_z;
+	std::vector<float> color_r, color_g, color_b;
+
+	// arc-length tables of all lamps, one after another
+	std::vector<size_t> table_offset;
+	std::vector<size_t> table_size;
+	std::vector<DirectX::XMFLOAT3> table;
+
+	// cube faces of a lamp centered at the origin
+	std::array<square_instance_t, INSTANCES_PER_LAMP> cube;
+
+	const int64_t color_change_interval_ms =
+		static_cast<int64_t>(60000.f / 165.0f); // 165 BPM, same as the music
+	uint64_t key;
+	uint64_t beat;
+};
+
+#endif // LAMP_SYSTEM_H
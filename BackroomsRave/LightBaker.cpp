@@ -0,0 +1,334 @@
+#include "LightBaker.h"
+
+#include <algorithm>
+#include <cmath>
+#include "PointLightKernel.h"
+#include "simd.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr size_t NO_TILE = SIZE_MAX;
+	// rays start this far in front of their tile
+	constexpr FLOAT RAY_OFFSET = 1e-3f;
+
+	/*
+	 * Plane and bounds of a rectangle, for casting rays.
+	 */
+	struct plane_t {
+		int axis;
+		FLOAT min[3];
+		FLOAT max[3];
+		bool empty;
+	};
+
+	plane_t make_plane(const rectangle_desc_t& desc) {
+		const FLOAT lower_left[3] = {
+			desc.pos_lower_left.x, desc.pos_lower_left.y, desc.pos_lower_left.z
+		};
+		const FLOAT upper_right[3] = {
+			desc.pos_upper_right.x, desc.pos_upper_right.y, desc.pos_upper_right.z
+		};
+		plane_t plane = {};
+		for (int a = 0; a < 3; a++) {
+			plane.min[a] = (std::min)(lower_left[a], upper_right[a]);
+			plane.max[a] = (std::max)(lower_left[a], upper_right[a]);
+		}
+		// same axis as AxisRectangle
+		plane.axis = lower_left[0] == upper_right[0] ? 0 : lower_left[1] == upper_right[1] ? 1 : 2;
+		plane.empty = AxisRectangle::tile_count(desc) == 0;
+		return plane;
+	}
+
+	/*
+	 * Distance from `point` to the box of `plane`.
+	 */
+	FLOAT box_distance(const plane_t& plane, const FLOAT point[3]) {
+		FLOAT squared = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			const FLOAT d = (std::max)({ plane.min[a] - point[a], point[a] - plane.max[a], 0.0f });
+			squared += d * d;
+		}
+		return std::sqrt(squared);
+	}
+
+	/*
+	 * Nearest rectangle hit by the ray within `range`,
+	 * or NO_TILE if there is none.
+	 */
+	size_t cast_ray(std::span<const plane_t> planes, const FLOAT origin[3],
+		const FLOAT direction[3], FLOAT range, FLOAT& hit_distance)
+	{
+		size_t hit = NO_TILE;
+		hit_distance = range;
+		for (size_t r = 0; r < planes.size(); r++) {
+			const plane_t& plane = planes[r];
+			const FLOAT d = direction[plane.axis];
+			if (plane.empty || std::abs(d) < 1e-6f) {
+				continue;
+			}
+			const FLOAT t = (plane.min[plane.axis] - origin[plane.axis]) / d;
+			if (t <= 0.0f || t >= hit_distance) {
+				continue;
+			}
+			bool inside = true;
+			for (int a = 0; a < 3; a++) {
+				const FLOAT x = origin[a] + t * direction[a];
+				inside = inside && (a == plane.axis || (x >= plane.min[a] && x <= plane.max[a]));
+			}
+			if (inside) {
+				hit = r;
+				hit_distance = t;
+			}
+		}
+		return hit;
+	}
+
+	/*
+	 * Rectangles that light the same way, whatever their texture.
+	 */
+	bool same_geometry(const rectangle_desc_t& a, const rectangle_desc_t& b) {
+		return a.pos_lower_left.x == b.pos_lower_left.x
+			&& a.pos_lower_left.y == b.pos_lower_left.y
+			&& a.pos_lower_left.z == b.pos_lower_left.z
+			&& a.pos_upper_right.x == b.pos_upper_right.x
+			&& a.pos_upper_right.y == b.pos_upper_right.y
+			&& a.pos_upper_right.z == b.pos_upper_right.z
+			&& a.change_orientation == b.change_orientation
+			&& a.tile_size == b.tile_size
+			&& a.color.x == b.color.x && a.color.y == b.color.y
+			&& a.color.z == b.color.z && a.color.w == b.color.w;
+	}
+
+	bool same_lights(std::span<const bake_light_t> a, std::span<const bake_light_t> b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+			[](const bake_light_t& x, const bake_light_t& y) {
+				return x.position.x == y.position.x && x.position.y == y.position.y
+					&& x.position.z == y.position.z && x.color.x == y.color.x
+					&& x.color.y == y.color.y && x.color.z == y.color.z;
+			});
+	}
+}
+
+std::vector<bake_light_t> LightBaker::average_lamps(std::span<const lamp_desc_t> lamps,
+	const LampSystem& system, uint64_t beats)
+{
+	std::vector<bake_light_t> lights;
+	for (size_t lamp = 0; lamp < (std::min)(lamps.size(), system.size()); lamp++) {
+		XMVECTOR color = XMVectorZero();
+		for (uint64_t beat = 0; beat < beats; beat++) {
+			const XMFLOAT4 beat_color = system.get_color(lamp, beat);
+			color = XMVectorAdd(color, XMLoadFloat4(&beat_color));
+		}
+
+		// lamps move at a constant speed, so they spend the same time
+		// at every sample; the last one of a loop is the first one again
+		const std::vector<XMFLOAT3> table = build_arc_length_table(lamps[lamp]);
+		const size_t samples = lamps[lamp].loop ? table.size() - 1 : table.size();
+		color = XMVectorScale(color, 1.0f / ((std::max)(beats, uint64_t(1)) * samples));
+		for (size_t i = 0; i < samples; i++) {
+			bake_light_t& light = lights.emplace_back();
+			light.position = table[i];
+			XMStoreFloat3(&light.color, color);
+		}
+	}
+	return lights;
+}
+
+/*
+ * Tiles of rectangles matching ones of the last bake are copied unless
+ * a changed rectangle, new or old, is within BOUNCE_RANGE of them.
+ */
+size_t LightBaker::bake(std::span<const rectangle_desc_t> rectangles,
+	std::span<const square_instance_t> instances,
+	std::span<const bake_light_t> lights, JobSystem& jobs)
+{
+	std::vector<size_t> offsets(rectangles.size() + 1, 0);
+	std::vector<plane_t> planes(rectangles.size());
+	for (size_t r = 0; r < rectangles.size(); r++) {
+		offsets[r + 1] = offsets[r] + AxisRectangle::tile_count(rectangles[r]);
+		planes[r] = make_plane(rectangles[r]);
+	}
+	if (offsets.back() != instances.size()) {
+		throw "Instances do not match the rectangles";
+	}
+
+	// Tile centers and normals, the normal of the base square
+	// is -z and the world matrices are row-major
+	const size_t tile_count = instances.size();
+	const size_t padded_count = lane_padded(tile_count);
+	std::vector<FLOAT> tile_data(14 * padded_count, 0.0f);
+	FLOAT* center[3];
+	FLOAT* normal[3];
+	FLOAT* reflectance[4];
+	FLOAT* direct[4];
+	for (size_t c = 0; c < 4; c++) {
+		if (c < 3) {
+			center[c] = tile_data.data() + c * padded_count;
+			normal[c] = tile_data.data() + (3 + c) * padded_count;
+		}
+		reflectance[c] = tile_data.data() + (6 + c) * padded_count;
+		direct[c] = tile_data.data() + (10 + c) * padded_count;
+	}
+	for (size_t i = 0; i < tile_count; i++) {
+		const XMFLOAT4X4& world = instances[i].world;
+		const XMVECTOR n = XMVector3Normalize(XMVectorSet(-world._31, -world._32, -world._33, 0.0f));
+		center[0][i] = world._41;
+		center[1][i] = world._42;
+		center[2][i] = world._43;
+		normal[0][i] = XMVectorGetX(n);
+		normal[1][i] = XMVectorGetY(n);
+		normal[2][i] = XMVectorGetZ(n);
+		for (size_t c = 0; c < 4; c++) {
+			reflectance[c][i] = REFLECTANCE;
+		}
+	}
+
+	// Direct light reflected by every tile, without ambient light,
+	// lamp tiles glow in their color instead
+	std::vector<XMFLOAT4> light_positions(lights.size());
+	std::vector<XMFLOAT4> light_colors(lights.size());
+	for (size_t l = 0; l < lights.size(); l++) {
+		light_positions[l] = { lights[l].position.x, lights[l].position.y, lights[l].position.z, 0.0f };
+		light_colors[l] = { lights[l].color.x, lights[l].color.y, lights[l].color.z, 0.0f };
+	}
+	const PointLightKernel kernel(light_positions, light_colors,
+		{ 0.0f, 0.0f, 0.0f, 0.0f }, XMMatrixIdentity());
+	jobs.parallel_for(padded_count / 4, TILES_PER_JOB, [&](size_t begin, size_t end) {
+		light_batch_t batch = {};
+		for (size_t c = 0; c < 4; c++) {
+			if (c < 3) {
+				batch.position[c] = center[c] + 4 * begin;
+				batch.normal[c] = normal[c] + 4 * begin;
+			}
+			batch.color[c] = reflectance[c] + 4 * begin;
+			batch.result[c] = direct[c] + 4 * begin;
+		}
+		batch.count = 4 * (end - begin);
+		kernel.evaluate(batch);
+	});
+	for (size_t i = 0; i < tile_count; i++) {
+		if (instances[i].color.w > 0.0f) {
+			direct[0][i] = instances[i].color.x;
+			direct[1][i] = instances[i].color.y;
+			direct[2][i] = instances[i].color.z;
+		}
+	}
+
+	// Tiles of the last bake that are still valid, by new tile
+	std::vector<size_t> source(tile_count, NO_TILE);
+	if (!this->tiles.empty() && same_lights(lights, this->lights)) {
+		std::vector<size_t> match(rectangles.size(), NO_TILE);
+		std::vector<bool> matched(this->rectangles.size(), false);
+		for (size_t r = 0; r < rectangles.size(); r++) {
+			for (size_t old = 0; old < this->rectangles.size(); old++) {
+				if (!matched[old] && same_geometry(rectangles[r], this->rectangles[old])) {
+					match[r] = old;
+					matched[old] = true;
+					break;
+				}
+			}
+		}
+		std::vector<plane_t> changed;
+		for (size_t r = 0; r < rectangles.size(); r++) {
+			if (match[r] == NO_TILE) {
+				changed.push_back(planes[r]);
+			}
+		}
+		for (size_t old = 0; old < this->rectangles.size(); old++) {
+			if (!matched[old]) {
+				changed.push_back(make_plane(this->rectangles[old]));
+			}
+		}
+
+		for (size_t r = 0; r < rectangles.size(); r++) {
+			if (match[r] == NO_TILE) {
+				continue;
+			}
+			for (size_t i = offsets[r]; i < offsets[r + 1]; i++) {
+				const FLOAT point[3] = { center[0][i], center[1][i], center[2][i] };
+				const bool affected = std::any_of(changed.begin(), changed.end(),
+					[&](const plane_t& plane) { return box_distance(plane, point) <= BOUNCE_RANGE; });
+				if (!affected) {
+					source[i] = this->offsets[match[r]] + i - offsets[r];
+				}
+			}
+		}
+	}
+
+	std::vector<baked_tile_t> tiles(tile_count);
+	std::vector<size_t> solve;
+	for (size_t i = 0; i < tile_count; i++) {
+		if (source[i] != NO_TILE) {
+			tiles[i] = this->tiles[source[i]];
+		}
+		else {
+			solve.push_back(i);
+		}
+	}
+
+	// One bounce: gather the direct light of the tiles hit by the rays
+	jobs.parallel_for(solve.size(), TILES_PER_JOB, [&](size_t begin, size_t end) {
+		for (size_t s = begin; s < end; s++) {
+			const size_t i = solve[s];
+			const XMVECTOR n = XMVectorSet(normal[0][i], normal[1][i], normal[2][i], 0.0f);
+			const XMVECTOR helper = std::abs(normal[0][i]) < 0.9f
+				? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			const XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(helper, n));
+			const XMVECTOR bitangent = XMVector3Cross(n, tangent);
+			const FLOAT origin[3] = {
+				center[0][i] + RAY_OFFSET * normal[0][i],
+				center[1][i] + RAY_OFFSET * normal[1][i],
+				center[2][i] + RAY_OFFSET * normal[2][i]
+			};
+
+			XMVECTOR bounce = XMVectorZero();
+			size_t occluded = 0;
+			for (size_t k = 0; k < RAYS_PER_TILE; k++) {
+				// stratified in the elevation, golden ratio steps around the normal
+				const FLOAT u = (k + 0.5f) / RAYS_PER_TILE;
+				const FLOAT phi = XM_2PI * std::fmod(k * 0.618034f, 1.0f);
+				const FLOAT sine = std::sqrt(u);
+				XMFLOAT3 ray;
+				XMStoreFloat3(&ray, XMVectorAdd(XMVectorScale(n, std::sqrt(1.0f - u)),
+					XMVectorAdd(XMVectorScale(tangent, sine * std::cos(phi)),
+						XMVectorScale(bitangent, sine * std::sin(phi)))));
+				const FLOAT direction[3] = { ray.x, ray.y, ray.z };
+
+				FLOAT hit_distance;
+				const size_t r = cast_ray(planes, origin, direction, BOUNCE_RANGE, hit_distance);
+				if (r == NO_TILE) {
+					continue;
+				}
+				occluded += hit_distance < OCCLUSION_RANGE;
+				const XMFLOAT3 hit_point = {
+					origin[0] + hit_distance * direction[0],
+					origin[1] + hit_distance * direction[1],
+					origin[2] + hit_distance * direction[2]
+				};
+				const size_t hit = offsets[r] + AxisRectangle::tile_at(rectangles[r], hit_point);
+				// the back of a tile reflects nothing
+				const FLOAT facing = normal[0][hit] * direction[0]
+					+ normal[1][hit] * direction[1] + normal[2][hit] * direction[2];
+				if (facing < 0.0f) {
+					bounce = XMVectorAdd(bounce,
+						XMVectorSet(direct[0][hit], direct[1][hit], direct[2][hit], 0.0f));
+				}
+			}
+
+			// with rays distributed by the cosine, the mean is the irradiance
+			XMStoreFloat3(&tiles[i].bounce, XMVectorScale(bounce, 1.0f / RAYS_PER_TILE));
+			tiles[i].occlusion = static_cast<FLOAT>(occluded) / RAYS_PER_TILE;
+		}
+	});
+
+	this->rectangles.assign(rectangles.begin(), rectangles.end());
+	this->offsets = std::move(offsets);
+	this->lights.assign(lights.begin(), lights.end());
+	this->tiles = std::move(tiles);
+	return solve.size();
+}
+
+std::span<const baked_tile_t> LightBaker::get_tiles() const {
+	return tiles;
+}
\ No newline at end of file
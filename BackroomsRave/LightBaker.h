@@ -0,0 +1,76 @@
+#ifndef LIGHT_BAKER_H
+#define LIGHT_BAKER_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "JobSystem.h"
+#include "LampPath.h"
+#include "LampSystem.h"
+#include "Rectangle.h"
+#include "types.h"
+
+/*
+ * Point light of the bake, standing for a lamp averaged over time.
+ */
+struct bake_light_t {
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 color;
+};
+
+/*
+ * Baked lighting of a static tile.
+ */
+struct baked_tile_t {
+	DirectX::XMFLOAT3 bounce;   // light reflected onto the tile by other tiles
+	FLOAT occlusion;            // blocked part of the ambient light, 0 to 1
+};
+
+/*
+ * Offline bake of the indirect lighting of the static tiles.
+ *
+ * The direct light of every tile is the lighting of VertexShader.hlsl
+ * at its center, evaluated by PointLightKernel. Every tile then casts
+ * RAYS_PER_TILE rays, distributed by the cosine around its normal,
+ * against the rectangles: the bounce light is the mean direct light
+ * reflected by the tiles the rays hit, the occlusion is the part of
+ * the rays hitting something closer than OCCLUSION_RANGE.
+ *
+ * Rays end at BOUNCE_RANGE, so a changed rectangle only affects tiles
+ * within that distance. The baker keeps the input and the result of
+ * its last bake, and a new bake with the same lights solves only
+ * the tiles affected by the rectangles that changed.
+ */
+class LightBaker {
+public:
+	static constexpr size_t RAYS_PER_TILE = 256;
+	static constexpr FLOAT BOUNCE_RANGE = 8.0f;
+	static constexpr FLOAT OCCLUSION_RANGE = 1.5f;
+	// part of the light reflected by the walls
+	static constexpr FLOAT REFLECTANCE = 0.5f;
+	static constexpr size_t TILES_PER_JOB = 16;
+
+	// Lights at the samples of the arc-length tables of the lamps,
+	// with the mean color of `beats` beats.
+	static std::vector<bake_light_t> average_lamps(std::span<const lamp_desc_t> lamps,
+		const LampSystem& system, uint64_t beats);
+
+	// `instances` are the tiles of `rectangles`, in the order of
+	// Scene::build_static_instances. Returns the number of tiles solved.
+	size_t bake(std::span<const rectangle_desc_t> rectangles,
+		std::span<const square_instance_t> instances,
+		std::span<const bake_light_t> lights, JobSystem& jobs);
+
+	// One per tile of the last bake.
+	std::span<const baked_tile_t> get_tiles() const;
+
+private:
+	std::vector<rectangle_desc_t> rectangles;
+	std::vector<size_t> offsets;    // first tile of every rectangle
+	std::vector<bake_light_t> lights;
+	std::vector<baked_tile_t> tiles;
+};
+
+#endif // LIGHT_BAKER_H
\ No newline at end of file
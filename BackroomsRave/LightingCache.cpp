@@ -0,0 +1,240 @@
+#include "LightingCache.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "simd.h"
+
+using namespace DirectX;
+
+namespace {
+	// vertices lit by one kernel call, a multiple of 4
+	constexpr size_t LIGHT_BATCH = 256;
+
+	bool same(const XMFLOAT4& a, const XMFLOAT4& b) {
+		return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+	}
+
+	FLOAT brightest(const XMFLOAT4& color) {
+		return (std::max)({ color.x, color.y, color.z });
+	}
+}
+
+LightingCache::LightingCache(std::span<const square_instance_t> instances) :
+	kernel({}, {}, { 0.0f, 0.0f, 0.0f, 0.0f }, XMMatrixIdentity())
+{
+	// the normal of the base square is -z, world matrices are row-major
+	XMVECTOR lower = XMVectorReplicate(FLT_MAX);
+	XMVECTOR upper = XMVectorReplicate(-FLT_MAX);
+	for (size_t i = 0; i < instances.size(); i++) {
+		const square_instance_t& instance = instances[i];
+		if (instance.color.w > 0.0f) {
+			continue;
+		}
+		const XMFLOAT4X4& world = instance.world;
+		const XMVECTOR n = XMVector3Normalize(XMVectorSet(-world._31, -world._32, -world._33, 0.0f));
+		const XMVECTOR p = XMVectorSet(world._41, world._42, world._43, 0.0f);
+		lower = XMVectorMin(lower, p);
+		upper = XMVectorMax(upper, p);
+
+		tiles.push_back(static_cast<UINT32>(i));
+		position[0].push_back(world._41);
+		position[1].push_back(world._42);
+		position[2].push_back(world._43);
+		normal[0].push_back(XMVectorGetX(n));
+		normal[1].push_back(XMVectorGetY(n));
+		normal[2].push_back(XMVectorGetZ(n));
+		bounce[0].push_back(instance.color.x);
+		bounce[1].push_back(instance.color.y);
+		bounce[2].push_back(instance.color.z);
+		exposure.push_back(1.0f + instance.color.w);
+	}
+	if (tiles.empty()) {
+		lower = upper = XMVectorZero();
+	}
+
+	// Counting sort of the tiles into the cells
+	XMStoreFloat3(&grid_origin, lower);
+	XMFLOAT3 extent;
+	XMStoreFloat3(&extent, XMVectorSubtract(upper, lower));
+	grid_size[0] = static_cast<size_t>(extent.x / CELL_SIZE) + 1;
+	grid_size[1] = static_cast<size_t>(extent.y / CELL_SIZE) + 1;
+	grid_size[2] = static_cast<size_t>(extent.z / CELL_SIZE) + 1;
+	std::vector<size_t> tile_cells(tiles.size());
+	cell_start.assign(grid_size[0] * grid_size[1] * grid_size[2] + 1, 0);
+	for (size_t t = 0; t < tiles.size(); t++) {
+		const FLOAT origin[3] = { grid_origin.x, grid_origin.y, grid_origin.z };
+		size_t cell = 0;
+		for (int a = 2; a >= 0; a--) {
+			const size_t i = (std::min)(static_cast<size_t>(
+				(position[a][t] - origin[a]) / CELL_SIZE), grid_size[a] - 1);
+			cell = cell * grid_size[a] + i;
+		}
+		tile_cells[t] = cell;
+		cell_start[cell + 1]++;
+	}
+	for (size_t c = 1; c < cell_start.size(); c++) {
+		cell_start[c] += cell_start[c - 1];
+	}
+	cell_tiles.resize(tiles.size());
+	std::vector<UINT32> filled(cell_start.begin(), cell_start.end() - 1);
+	for (size_t t = 0; t < tiles.size(); t++) {
+		cell_tiles[filled[tile_cells[t]]++] = static_cast<UINT32>(t);
+	}
+
+	marks.assign(tiles.size(), 0);
+	dirty.reserve(tiles.size());
+}
+
+size_t LightingCache::get_tile_count() const {
+	return tiles.size();
+}
+
+/*
+ * c / (1 + ATTENUATION * d^2) < COLOR_STEP for d^2 > (c / COLOR_STEP - 1) / ATTENUATION.
+ */
+FLOAT LightingCache::light_range(FLOAT brightness) {
+	return std::sqrt((std::max)(brightness / COLOR_STEP - 1.0f, 0.0f) / PointLightKernel::ATTENUATION);
+}
+
+/*
+ * Marks the tiles within `range` of the segment from `a` to `b`, looking
+ * only at the cells around it. A tile with both ends behind it, where the
+ * light is left out by the cosine, keeps its color.
+ */
+void LightingCache::mark_near_segment(FXMVECTOR a, FXMVECTOR b, FLOAT range) {
+	const XMVECTOR origin = XMLoadFloat3(&grid_origin);
+	const XMVECTOR reach = XMVectorReplicate(range);
+	XMFLOAT3 first;
+	XMFLOAT3 last;
+	XMStoreFloat3(&first, XMVectorScale(
+		XMVectorSubtract(XMVectorSubtract(XMVectorMin(a, b), reach), origin), 1.0f / CELL_SIZE));
+	XMStoreFloat3(&last, XMVectorScale(
+		XMVectorSubtract(XMVectorAdd(XMVectorMax(a, b), reach), origin), 1.0f / CELL_SIZE));
+	const FLOAT cell_first[3] = { first.x, first.y, first.z };
+	const FLOAT cell_last[3] = { last.x, last.y, last.z };
+	size_t lo[3];
+	size_t hi[3];
+	for (int i = 0; i < 3; i++) {
+		if (cell_last[i] < 0.0f || cell_first[i] >= static_cast<FLOAT>(grid_size[i])) {
+			return;
+		}
+		lo[i] = static_cast<size_t>((std::max)(cell_first[i], 0.0f));
+		hi[i] = (std::min)(static_cast<size_t>(cell_last[i]), grid_size[i] - 1);
+	}
+
+	const XMVECTOR segment = XMVectorSubtract(b, a);
+	const FLOAT length_squared = XMVectorGetX(XMVector3LengthSq(segment));
+	for (size_t z = lo[2]; z <= hi[2]; z++) {
+		for (size_t y = lo[1]; y <= hi[1]; y++) {
+			for (size_t x = lo[0]; x <= hi[0]; x++) {
+				const size_t cell = (z * grid_size[1] + y) * grid_size[0] + x;
+				for (UINT32 c = cell_start[cell]; c < cell_start[cell + 1]; c++) {
+					const UINT32 t = cell_tiles[c];
+					if (marks[t] == mark) {
+						continue;
+					}
+					const XMVECTOR p = XMVectorSet(position[0][t], position[1][t], position[2][t], 0.0f);
+					const XMVECTOR n = XMVectorSet(normal[0][t], normal[1][t], normal[2][t], 0.0f);
+					const XMVECTOR offset = XMVectorSubtract(p, a);
+					if (XMVectorGetX(XMVector3Dot(offset, n)) >= 0.0f
+						&& XMVectorGetX(XMVector3Dot(XMVectorSubtract(p, b), n)) >= 0.0f)
+					{
+						continue;
+					}
+					const FLOAT s = length_squared > 0.0f ? std::clamp(
+						XMVectorGetX(XMVector3Dot(offset, segment)) / length_squared, 0.0f, 1.0f) : 0.0f;
+					const XMVECTOR nearest = XMVectorSubtract(offset, XMVectorScale(segment, s));
+					if (XMVectorGetX(XMVector3LengthSq(nearest)) <= range * range) {
+						marks[t] = mark;
+						dirty.push_back(t);
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+ * A light that changed color is treated as one that moved from its
+ * old position, in the range of the brighter of its two colors, so the
+ * tiles lit by it before and now are both marked.
+ */
+void LightingCache::update(const vs_const_buffer_t& constants, JobSystem& jobs,
+	std::vector<tile_lighting_t>& refreshed)
+{
+	mark++;
+	dirty.clear();
+	if (!has_lights || !same(lights.ambient, constants.ambientLight)) {
+		for (UINT32 t = 0; t < tiles.size(); t++) {
+			marks[t] = mark;
+			dirty.push_back(t);
+		}
+	}
+	else {
+		for (size_t l = 0; l < LIGHT_COUNT; l++) {
+			if (!same(lights.position[l], constants.pointLight[l])
+				|| !same(lights.color[l], constants.colLight[l]))
+			{
+				mark_near_segment(XMLoadFloat4(&lights.position[l]),
+					XMLoadFloat4(&constants.pointLight[l]), light_range((std::max)(
+						brightest(lights.color[l]), brightest(constants.colLight[l]))));
+			}
+		}
+	}
+	std::copy_n(constants.pointLight, LIGHT_COUNT, lights.position);
+	std::copy_n(constants.colLight, LIGHT_COUNT, lights.color);
+	lights.ambient = constants.ambientLight;
+	has_lights = true;
+
+	// the lighting does not depend on the view, lit in world space so
+	// tiles lit in different frames match
+	kernel.set_lights(constants.pointLight, constants.colLight,
+		constants.ambientLight, XMMatrixIdentity());
+	refreshed.resize(dirty.size());
+	jobs.parallel_for(dirty.size(), TILES_PER_JOB, [&](size_t begin, size_t end) {
+		FLOAT center[3][LIGHT_BATCH];
+		FLOAT direction[3][LIGHT_BATCH];
+		FLOAT color[4][LIGHT_BATCH];
+		FLOAT ambient[4][LIGHT_BATCH];
+		FLOAT result[4][LIGHT_BATCH];
+		light_batch_t batch = {
+			{ center[0], center[1], center[2] },
+			{ direction[0], direction[1], direction[2] },
+			{ color[0], color[1], color[2], color[3] },
+			{ ambient[0], ambient[1], ambient[2], ambient[3] },
+			{ result[0], result[1], result[2], result[3] },
+			0
+		};
+
+		for (size_t first = begin; first < end; first += LIGHT_BATCH) {
+			const size_t count = (std::min)(LIGHT_BATCH, end - first);
+			for (size_t k = 0; k < lane_padded(count); k++) {
+				// padding lanes repeat the last tile
+				const UINT32 t = dirty[first + (std::min)(k, count - 1)];
+				for (size_t c = 0; c < 3; c++) {
+					center[c][k] = position[c][t];
+					direction[c][k] = normal[c][t];
+				}
+				// the base square is white
+				for (size_t c = 0; c < 4; c++) {
+					color[c][k] = 1.0f;
+				}
+				ambient[0][k] = constants.ambientLight.x * exposure[t] + bounce[0][t];
+				ambient[1][k] = constants.ambientLight.y * exposure[t] + bounce[1][t];
+				ambient[2][k] = constants.ambientLight.z * exposure[t] + bounce[2][t];
+				ambient[3][k] = constants.ambientLight.w;
+			}
+
+			batch.count = lane_padded(count);
+			kernel.evaluate(batch);
+
+			for (size_t k = 0; k < count; k++) {
+				refreshed[first + k] = {
+					tiles[dirty[first + k]],
+					{ result[0][k], result[1][k], result[2][k], 1.0f }
+				};
+			}
+		}
+	});
+}
\ No newline at end of file
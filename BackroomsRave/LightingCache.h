@@ -0,0 +1,92 @@
+#ifndef LIGHTING_CACHE_H
+#define LIGHTING_CACHE_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "JobSystem.h"
+#include "PointLightKernel.h"
+#include "types.h"
+
+/*
+ * New color of a static instance.
+ */
+struct tile_lighting_t {
+	UINT32 tile;
+	DirectX::XMFLOAT4 color;
+};
+
+/*
+ * Lighting of the static tiles computed on the CPU and kept between
+ * frames, for levels where most tiles are far from every lamp.
+ *
+ * A tile is lit once, at its center, by PointLightKernel with the lights
+ * of the vertex shader constants and its baked lighting. Its color gets
+ * an alpha of 1, so the vertex shader takes it as it is. A light of
+ * color c at a distance d adds at most c / (1 + ATTENUATION * d^2) to a
+ * color channel, less than one 8-bit step, COLOR_STEP, farther than
+ * light_range of its brightest channel. So when a light moves or changes
+ * color, only the tiles within that range of the segment it moved along
+ * are lit again, and of those only the ones facing it at either end.
+ *
+ * Tiles are bucketed in a grid of CELL_SIZE cells, so finding the ones
+ * near a light does not depend on the size of the level, and lit again
+ * in parallel, in jobs of TILES_PER_JOB tiles.
+ */
+class LightingCache {
+public:
+	static constexpr FLOAT COLOR_STEP = 1.0f / 255.0f;
+	static constexpr FLOAT CELL_SIZE = 8.0f;
+	static constexpr size_t TILES_PER_JOB = 1024;
+	static constexpr size_t LIGHT_COUNT = std::extent_v<decltype(vs_const_buffer_t::pointLight)>;
+
+	// Takes the static instances, lamp instances among them are left out.
+	LightingCache(std::span<const square_instance_t> instances);
+
+	// Lights again the tiles whose lighting may have changed since the last
+	// update, all of them the first time, and replaces `refreshed` with their
+	// new colors. Does not allocate once `refreshed` has room for every tile.
+	void update(const vs_const_buffer_t& constants, JobSystem& jobs,
+		std::vector<tile_lighting_t>& refreshed);
+
+	size_t get_tile_count() const;
+
+	// Distance beyond which a light whose brightest color channel is
+	// `brightness` changes a color by less than COLOR_STEP.
+	static FLOAT light_range(FLOAT brightness);
+
+private:
+	// Lights of the last update
+	struct light_state_t {
+		DirectX::XMFLOAT4 position[LIGHT_COUNT];
+		DirectX::XMFLOAT4 color[LIGHT_COUNT];
+		DirectX::XMFLOAT4 ambient;
+	};
+
+	void mark_near_segment(DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, FLOAT range);
+
+	// lit static instances, structure of arrays
+	std::vector<UINT32> tiles;      // index among the static instances
+	std::vector<FLOAT> position[3];
+	std::vector<FLOAT> normal[3];
+	std::vector<FLOAT> bounce[3];   // baked lighting, see Scene::set_static_lighting
+	std::vector<FLOAT> exposure;
+
+	// tiles by cell, cell c holds cell_tiles[cell_start[c], cell_start[c + 1])
+	DirectX::XMFLOAT3 grid_origin;
+	size_t grid_size[3];
+	std::vector<UINT32> cell_start;
+	std::vector<UINT32> cell_tiles;
+
+	PointLightKernel kernel;
+	light_state_t lights = {};
+	bool has_lights = false;
+	// tiles to light, deduplicated by the update they were marked in
+	std::vector<UINT32> marks;
+	UINT32 mark = 0;
+	std::vector<UINT32> dirty;
+};
+
+#endif // LIGHTING_CACHE_H
\ No newline at end of file
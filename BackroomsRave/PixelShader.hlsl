@@ -3,6 +3,7 @@ struct ps_input_t
     float4 position : SV_POSITION;
     float4 color : COLOR;
     float2 tex : TEXCOORD;
+    nointerpolation float4 atlas : TEXCOORD1;
 };
 
 Texture2D texture_ps;
@@ -10,5 +11,8 @@ SamplerState sampler_ps;
 
 float4 main(ps_input_t input) : SV_TARGET
 {
-    return input.color * texture_ps.Sample(sampler_ps, input.tex);
+    // a quarter of the atlas per tile, larger tiles repeat it
+    float2 tile = clamp(floor(input.tex), 0.0f, input.atlas.zw - 1.0f);
+    float2 tex = input.atlas.xy + (input.tex - tile) * 0.5f;
+    return input.color * texture_ps.Sample(sampler_ps, tex);
 }
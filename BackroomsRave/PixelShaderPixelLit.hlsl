@@ -0,0 +1,57 @@
+cbuffer vs_const_buffer_t
+{
+    float4x4 matViewProj;
+    float4x4 matView;
+    float4 colMaterial;
+    float4 colLight[7];
+    float4 pointLight[7];
+    float4 ambientLight;
+    float4 padding;
+};
+
+
+struct ps_input_t
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float4 material : COLOR1;
+    float2 tex : TEXCOORD;
+    nointerpolation float4 atlas : TEXCOORD1;
+    float3 world_pos : POSITION;
+    float3 normal : NORMAL;
+    nointerpolation float lit : LIT;
+};
+
+Texture2D texture_ps;
+SamplerState sampler_ps;
+
+float4 main(ps_input_t input) : SV_TARGET
+{
+    float4 color = input.color;
+    if (input.lit > 0.0f) {
+        // the point lights of VertexShader.hlsl, for every pixel
+        float3 normal = normalize(input.normal);
+        float4 NW = mul(float4(normal, 0.0f), matView);
+        for (uint i = 0; i < 7; i++) {
+            float4 dirLight = float4(input.world_pos, 0.0f) - pointLight[i];
+            float4 LW = mul(dirLight, matView);
+            float4 new_color = mul(
+                max(-dot(normalize(LW), normalize(NW)), 0.0f),
+                colLight[i] * input.material
+            );
+            float dist = length(dirLight);
+
+            // attenuation
+            new_color = new_color / (1.0f + 0.1 * dist * dist);
+
+            // sum colors from all lights
+            color += new_color;
+        }
+        color = saturate(color);
+    }
+
+    // a quarter of the atlas per tile of the quad
+    float2 tile = clamp(floor(input.tex), 0.0f, input.atlas.zw - 1.0f);
+    float2 tex = input.atlas.xy + (input.tex - tile) * 0.5f;
+    return color * texture_ps.Sample(sampler_ps, tex);
+}
@@ -0,0 +1,152 @@
+#include "PointLightKernel.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace {
+	constexpr size_t LANES = 4;
+
+	XMVECTOR load_lanes(const FLOAT* data, size_t i) {
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(data + i));
+	}
+
+	void store_lanes(FLOAT* data, size_t i, FXMVECTOR v) {
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(data + i), v);
+	}
+
+	/*
+	 * Row vector (x, y, z, w) times column `j` of `m`, for four vectors.
+	 */
+	XMVECTOR transform_lanes(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z,
+		const FLOAT m[4][4], size_t j, FLOAT w_term)
+	{
+		return XMVectorAdd(XMVectorAdd(
+			XMVectorScale(x, m[0][j]), XMVectorScale(y, m[1][j])),
+			XMVectorAdd(XMVectorScale(z, m[2][j]), XMVectorReplicate(w_term)));
+	}
+
+	/*
+	 * 1 / sqrt(length_squared), or 0 where the length is 0,
+	 * where XMVector4Normalize returns a zero vector.
+	 */
+	XMVECTOR inverse_length(FXMVECTOR length_squared) {
+		const XMVECTOR zero = XMVectorZero();
+		return XMVectorSelect(zero,
+			XMVectorDivide(XMVectorSplatOne(), XMVectorSqrt(length_squared)),
+			XMVectorGreater(length_squared, zero));
+	}
+}
+
+PointLightKernel::PointLightKernel(std::span<const XMFLOAT4> positions,
+	std::span<const XMFLOAT4> colors, const XMFLOAT4& ambient, FXMMATRIX view)
+{
+	set_lights(positions, colors, ambient, view);
+}
+
+PointLightKernel::PointLightKernel(const vs_const_buffer_t& constants) :
+	PointLightKernel(constants.pointLight, constants.colLight, constants.ambientLight,
+		XMMatrixTranspose(XMLoadFloat4x4(&constants.matView)))
+{
+}
+
+void PointLightKernel::set_lights(std::span<const XMFLOAT4> positions,
+	std::span<const XMFLOAT4> colors, const XMFLOAT4& ambient, FXMMATRIX view)
+{
+	XMFLOAT4X4 matrix;
+	XMStoreFloat4x4(&matrix, view);
+	for (size_t i = 0; i < 4; i++) {
+		for (size_t j = 0; j < 4; j++) {
+			this->view[i][j] = matrix.m[i][j];
+		}
+	}
+	this->ambient[0] = ambient.x;
+	this->ambient[1] = ambient.y;
+	this->ambient[2] = ambient.z;
+	this->ambient[3] = ambient.w;
+
+	lights.resize((std::min)(positions.size(), colors.size()));
+	for (size_t l = 0; l < lights.size(); l++) {
+		const XMFLOAT4& position = positions[l];
+		const XMFLOAT4& color = colors[l];
+		light_t& light = lights[l];
+		light.position[0] = position.x;
+		light.position[1] = position.y;
+		light.position[2] = position.z;
+		for (size_t j = 0; j < 4; j++) {
+			light.view_w[j] = -position.w * this->view[3][j];
+		}
+		light.w_squared = position.w * position.w;
+		light.color[0] = color.x;
+		light.color[1] = color.y;
+		light.color[2] = color.z;
+		light.color[3] = color.w;
+	}
+}
+
+size_t PointLightKernel::get_light_count() const {
+	return lights.size();
+}
+
+void PointLightKernel::evaluate(const light_batch_t& batch) const {
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+	for (size_t i = 0; i < batch.count; i += LANES) {
+		const XMVECTOR px = load_lanes(batch.position[0], i);
+		const XMVECTOR py = load_lanes(batch.position[1], i);
+		const XMVECTOR pz = load_lanes(batch.position[2], i);
+		XMVECTOR color[4];
+		XMVECTOR result[4];
+		for (size_t c = 0; c < 4; c++) {
+			color[c] = load_lanes(batch.color[c], i);
+			result[c] = batch.ambient[0]
+				? XMVectorMultiply(color[c], load_lanes(batch.ambient[c], i))
+				: XMVectorScale(color[c], ambient[c]);
+		}
+
+		// normalized normal in view space
+		const XMVECTOR nx = load_lanes(batch.normal[0], i);
+		const XMVECTOR ny = load_lanes(batch.normal[1], i);
+		const XMVECTOR nz = load_lanes(batch.normal[2], i);
+		XMVECTOR normal[4];
+		XMVECTOR normal_length_squared = zero;
+		for (size_t j = 0; j < 4; j++) {
+			normal[j] = transform_lanes(nx, ny, nz, view, j, 0.0f);
+			normal_length_squared = XMVectorMultiplyAdd(normal[j], normal[j], normal_length_squared);
+		}
+		const XMVECTOR normal_scale = inverse_length(normal_length_squared);
+
+		for (const light_t& light : lights) {
+			// direction from the light in world space, then in view space
+			const XMVECTOR dx = XMVectorSubtract(px, XMVectorReplicate(light.position[0]));
+			const XMVECTOR dy = XMVectorSubtract(py, XMVectorReplicate(light.position[1]));
+			const XMVECTOR dz = XMVectorSubtract(pz, XMVectorReplicate(light.position[2]));
+			XMVECTOR dot = zero;
+			XMVECTOR length_squared = zero;
+			for (size_t j = 0; j < 4; j++) {
+				const XMVECTOR direction = transform_lanes(dx, dy, dz, view, j, light.view_w[j]);
+				dot = XMVectorMultiplyAdd(direction, normal[j], dot);
+				length_squared = XMVectorMultiplyAdd(direction, direction, length_squared);
+			}
+			const XMVECTOR cosine = XMVectorMultiply(
+				XMVectorMultiply(dot, normal_scale), inverse_length(length_squared));
+			const XMVECTOR intensity = XMVectorMax(XMVectorNegate(cosine), zero);
+
+			// attenuation
+			const XMVECTOR distance_squared = XMVectorAdd(
+				XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))),
+				XMVectorReplicate(light.w_squared));
+			const XMVECTOR scale = XMVectorDivide(intensity,
+				XMVectorMultiplyAdd(distance_squared, XMVectorReplicate(ATTENUATION), one));
+
+			for (size_t c = 0; c < 4; c++) {
+				result[c] = XMVectorMultiplyAdd(
+					XMVectorScale(color[c], light.color[c]), scale, result[c]);
+			}
+		}
+
+		for (size_t c = 0; c < 4; c++) {
+			store_lanes(batch.result[c], i, XMVectorSaturate(result[c]));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef POINT_LIGHT_KERNEL_H
+#define POINT_LIGHT_KERNEL_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <span>
+#include <vector>
+#include "types.h"
+
+/*
+ * Vertices lit by a batch evaluation, as structure of arrays.
+ * `count` must be a multiple of 4, see lane_padded.
+ */
+struct light_batch_t {
+	const FLOAT* position[3];   // world space
+	const FLOAT* normal[3];     // world space, normalized
+	const FLOAT* color[4];      // material color of the vertex
+	const FLOAT* ambient[4];    // null for the ambient light of the kernel
+	FLOAT* result[4];
+	size_t count;
+};
+
+/*
+ * The point lighting of VertexShader.hlsl for four vertices at a time:
+ * ambient light plus every light times the cosine between the normal
+ * and the light direction in view space, attenuated by
+ * 1 + ATTENUATION * distance^2, saturated at the end. As in the shader, the
+ * fourth component of a light position takes part in the direction
+ * and the distance.
+ */
+class PointLightKernel {
+public:
+	static constexpr FLOAT ATTENUATION = 0.1f;
+
+	// `view` is the view matrix, not transposed for the shader.
+	PointLightKernel(std::span<const DirectX::XMFLOAT4> positions,
+		std::span<const DirectX::XMFLOAT4> colors,
+		const DirectX::XMFLOAT4& ambient, DirectX::FXMMATRIX view);
+	// Takes the lights of the vertex shader constants.
+	PointLightKernel(const vs_const_buffer_t& constants);
+
+	// Replaces the lights, reusing the memory of the old ones.
+	void set_lights(std::span<const DirectX::XMFLOAT4> positions,
+		std::span<const DirectX::XMFLOAT4> colors,
+		const DirectX::XMFLOAT4& ambient, DirectX::FXMMATRIX view);
+
+	size_t get_light_count() const;
+	void evaluate(const light_batch_t& batch) const;
+
+private:
+	// Per light terms that do not depend on the vertex
+	struct light_t {
+		FLOAT position[3];
+		FLOAT view_w[4];        // -w times the last row of the view matrix
+		FLOAT w_squared;
+		FLOAT color[4];
+	};
+
+	std::vector<light_t> lights;
+	FLOAT ambient[4];
+	FLOAT view[4][4];
+};
+
+#endif // POINT_LIGHT_KERNEL_H
\ No newline at end of file
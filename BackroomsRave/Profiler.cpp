@@ -0,0 +1,237 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+	/*
+	 * Ring buffer of the events of one thread. Only the owner writes:
+	 * `reserved` is raised before an entry is overwritten and `head`
+	 * after it is complete, so a reader can tell which of the entries
+	 * it copied may have been overwritten meanwhile.
+	 */
+	struct thread_ring_t {
+		struct entry_t {
+			std::atomic<INT64> start;
+			std::atomic<INT64> end;
+			std::atomic<UINT32> phase;
+		};
+
+		DWORD thread = GetCurrentThreadId();
+		std::atomic<UINT64> reserved = 0;
+		std::atomic<UINT64> head = 0;
+		std::array<entry_t, Profiler::RING_CAPACITY> entries;
+	};
+
+	struct registry_t {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<thread_ring_t>> rings;
+	};
+
+	registry_t& registry() {
+		static registry_t instance;
+		return instance;
+	}
+
+	thread_local thread_ring_t* current_ring = nullptr;
+
+	thread_ring_t& register_thread() {
+		registry_t& rings = registry();
+		std::lock_guard<std::mutex> lock(rings.mutex);
+		rings.rings.push_back(std::make_unique<thread_ring_t>());
+		return *rings.rings.back();
+	}
+
+	/*
+	 * Nearest-rank percentile of `values`, which get reordered.
+	 */
+	double percentile(std::vector<double>& values, double p) {
+		const size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+}
+
+Profiler::Profiler() :
+	epoch(now())
+{
+	// start collecting from the current positions
+	registry_t& rings = registry();
+	std::lock_guard<std::mutex> lock(rings.mutex);
+	for (const auto& ring : rings.rings) {
+		tails.push_back(ring->head.load(std::memory_order_acquire));
+	}
+	// collecting does not allocate until the trace is full
+	for (auto& window : windows) {
+		window.durations_ms.reserve(WINDOW_SIZE);
+	}
+	trace.reserve(MAX_TRACE_EVENTS + RING_CAPACITY);
+}
+
+INT64 Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(profile_phase_t phase, INT64 start, INT64 end) {
+	if (!current_ring) {
+		current_ring = &register_thread();
+	}
+	thread_ring_t& ring = *current_ring;
+
+	const UINT64 index = ring.head.load(std::memory_order_relaxed);
+	ring.reserved.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	auto& entry = ring.entries[index & (RING_CAPACITY - 1)];
+	entry.start.store(start, std::memory_order_relaxed);
+	entry.end.store(end, std::memory_order_relaxed);
+	entry.phase.store(static_cast<UINT32>(phase), std::memory_order_relaxed);
+	ring.head.store(index + 1, std::memory_order_release);
+}
+
+const char* Profiler::get_phase_name(profile_phase_t phase) {
+	static constexpr const char* names[] = {
+		"frame",
+		"upload_frame",
+		"flush_uploads",
+		"record_commands",
+		"execute",
+		"present",
+		"fence_wait",
+		"simulate",
+		"camera_update",
+		"scene_update",
+		"write_snapshot",
+		"audio_update",
+		"rasterize",
+		"light_cache",
+		"tile_lod",
+		"sort_instances",
+	};
+	static_assert(std::size(names) == PHASE_COUNT);
+	return names[static_cast<size_t>(phase)];
+}
+
+profile_phase_t Profiler::get_current_phase() {
+	return current_phase;
+}
+
+void Profiler::collect() {
+	registry_t& rings = registry();
+	std::lock_guard<std::mutex> lock(rings.mutex);
+	// threads registered after this profiler was created start at 0
+	tails.resize(rings.rings.size(), 0);
+
+	for (size_t r = 0; r < rings.rings.size(); r++) {
+		thread_ring_t& ring = *rings.rings[r];
+		const UINT64 head = ring.head.load(std::memory_order_acquire);
+		UINT64 tail = tails[r];
+		if (head - tail > RING_CAPACITY) {
+			lost_events += head - tail - RING_CAPACITY;
+			tail = head - RING_CAPACITY;
+		}
+
+		const size_t first_new = trace.size();
+		for (UINT64 i = tail; i < head; i++) {
+			const auto& entry = ring.entries[i & (RING_CAPACITY - 1)];
+			trace.push_back({
+				static_cast<profile_phase_t>(entry.phase.load(std::memory_order_relaxed)),
+				ring.thread,
+				entry.start.load(std::memory_order_relaxed),
+				entry.end.load(std::memory_order_relaxed)
+			});
+		}
+
+		// drop the entries the owner may have overwritten while they were copied
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const UINT64 reserved = ring.reserved.load(std::memory_order_relaxed);
+		const UINT64 valid_from = reserved > RING_CAPACITY ? reserved - RING_CAPACITY : 0;
+		if (valid_from > tail) {
+			const size_t overwritten = static_cast<size_t>((std::min)(valid_from, head) - tail);
+			trace.erase(trace.begin() + first_new, trace.begin() + first_new + overwritten);
+			lost_events += overwritten;
+		}
+		tails[r] = head;
+
+		for (size_t i = first_new; i < trace.size(); i++) {
+			window_t& window = windows[static_cast<size_t>(trace[i].phase)];
+			const double duration_ms = (trace[i].end - trace[i].start) / 1e6;
+			if (window.durations_ms.size() < WINDOW_SIZE) {
+				window.durations_ms.push_back(duration_ms);
+			}
+			else {
+				window.durations_ms[window.next] = duration_ms;
+			}
+			window.next = (window.next + 1) % WINDOW_SIZE;
+		}
+
+		// only durations are kept once the trace is full
+		if (trace.size() > MAX_TRACE_EVENTS) {
+			trace.resize(MAX_TRACE_EVENTS);
+		}
+	}
+}
+
+Profiler::percentiles_t Profiler::get_percentiles(profile_phase_t phase) const {
+	std::vector<double> durations = windows[static_cast<size_t>(phase)].durations_ms;
+	if (durations.empty()) {
+		return { 0.0, 0.0, 0.0, 0 };
+	}
+	return {
+		percentile(durations, 0.50),
+		percentile(durations, 0.95),
+		percentile(durations, 0.99),
+		durations.size()
+	};
+}
+
+UINT64 Profiler::get_lost_events() const {
+	return lost_events;
+}
+
+bool Profiler::write_chrome_trace(PCWSTR path) const {
+	std::ofstream file{ std::filesystem::path(path) };
+	if (!file) {
+		return false;
+	}
+
+	// complete events, times in microseconds since the profiler was created
+	file << "{\"traceEvents\":[";
+	char line[192];
+	for (size_t i = 0; i < trace.size(); i++) {
+		const profile_event_t& event = trace[i];
+		snprintf(line, sizeof(line),
+			"%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":1,\"tid\":%lu}",
+			i > 0 ? "," : "", get_phase_name(event.phase),
+			(event.start - epoch) / 1e3, (event.end - event.start) / 1e3,
+			static_cast<unsigned long>(event.thread));
+		file << line;
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return static_cast<bool>(file);
+}
+
+bool Profiler::write_csv(PCWSTR path) const {
+	std::ofstream file{ std::filesystem::path(path) };
+	if (!file) {
+		return false;
+	}
+
+	file << "phase,thread,start_us,duration_us\n";
+	char line[128];
+	for (const profile_event_t& event : trace) {
+		snprintf(line, sizeof(line), "%s,%lu,%.3f,%.3f\n",
+			get_phase_name(event.phase), static_cast<unsigned long>(event.thread),
+			(event.start - epoch) / 1e3, (event.end - event.start) / 1e3);
+		file << line;
+	}
+	return static_cast<bool>(file);
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Windows.h>
+#include <array>
+#include <vector>
+
+// Profiling scopes are compiled in unless NO_PROFILER is defined
+#ifndef NO_PROFILER
+#define PROFILER_ENABLED
+#endif
+
+/*
+ * Phases of a frame measured by the profiler.
+ */
+enum class profile_phase_t : UINT8 {
+	frame,              // whole RenderFrame
+	upload_frame,       // copying a snapshot into the upload ring
+	flush_uploads,
+	record_commands,    // PrepareCommandList
+	execute,
+	present,
+	fence_wait,         // waiting for the GPU in PrepareNextFrame
+	simulate,           // whole SimulateFrame
+	camera_update,
+	scene_update,
+	write_snapshot,
+	audio_update,
+	rasterize,          // software rendering of a headless frame
+	light_cache,        // relighting static tiles on the CPU
+	tile_lod,           // selecting the static tiles to draw
+	sort_instances,     // front-to-back order of the static instances
+	count
+};
+
+/*
+ * A measured scope, times are steady clock nanoseconds.
+ */
+struct profile_event_t {
+	profile_phase_t phase;
+	DWORD thread;
+	INT64 start;
+	INT64 end;
+};
+
+/*
+ * Frame-phase CPU profiler.
+ *
+ * Every thread records its scopes into a ring buffer of its own, so
+ * recording takes no locks: two clock reads and a few stores. Rings
+ * are shared by all profilers, each one collects them independently.
+ *
+ * collect() drains the rings. Events overwritten before they were
+ * collected are counted as lost. Collected durations feed a rolling
+ * window per phase for percentiles, and the events are kept for
+ * export as a Chrome trace (chrome://tracing) or CSV.
+ *
+ * The innermost phase a thread is in is also tracked, so heap
+ * allocations can be attributed to it (see AllocationTracker.h).
+ */
+class Profiler {
+public:
+	static constexpr size_t RING_CAPACITY = 4096;          // events per thread, power of 2
+	static constexpr size_t WINDOW_SIZE = 1024;            // durations per phase
+	static constexpr size_t MAX_TRACE_EVENTS = 1 << 20;    // events kept for export
+
+	struct percentiles_t {
+		double p50_ms;
+		double p95_ms;
+		double p99_ms;
+		size_t samples;
+	};
+
+	Profiler();
+
+	static INT64 now();
+	static void record(profile_phase_t phase, INT64 start, INT64 end);
+	static const char* get_phase_name(profile_phase_t phase);
+	// profile_phase_t::count outside of all phases
+	static profile_phase_t get_current_phase();
+
+	void collect();
+	percentiles_t get_percentiles(profile_phase_t phase) const;
+	UINT64 get_lost_events() const;
+
+	// Return false if the file cannot be written.
+	bool write_chrome_trace(PCWSTR path) const;
+	bool write_csv(PCWSTR path) const;
+
+private:
+	friend class ProfileScope;
+
+	static constexpr size_t PHASE_COUNT = static_cast<size_t>(profile_phase_t::count);
+	static inline thread_local profile_phase_t current_phase = profile_phase_t::count;
+
+	struct window_t {
+		std::vector<double> durations_ms;
+		size_t next = 0;
+	};
+
+	INT64 epoch;
+	std::vector<UINT64> tails;      // read position in every ring
+	std::array<window_t, PHASE_COUNT> windows;
+	std::vector<profile_event_t> trace;
+	UINT64 lost_events = 0;
+};
+
+/*
+ * Records the time until it goes out of scope as a phase.
+ */
+class ProfileScope {
+public:
+	ProfileScope(profile_phase_t phase) :
+		phase(phase),
+		outer_phase(Profiler::current_phase),
+		start(Profiler::now())
+	{
+		Profiler::current_phase = phase;
+	}
+
+	~ProfileScope() {
+		Profiler::record(phase, start, Profiler::now());
+		Profiler::current_phase = outer_phase;
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	profile_phase_t phase;
+	profile_phase_t outer_phase;
+	INT64 start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(profile_phase_t::phase)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#endif
+
+#endif // PROFILER_H
\ No newline at end of file
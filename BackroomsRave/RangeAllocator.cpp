@@ -0,0 +1,308 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <bit>
+
+RangeAllocator::RangeAllocator(UINT64 capacity) : capacity(0) {
+	for (auto& bin : bins) {
+		bin.fill(NONE);
+	}
+	grow(capacity);
+}
+
+/*
+ * Bin of a free range of the given size.
+ */
+void RangeAllocator::mapping(UINT64 size, UINT32& fl, UINT32& sl) {
+	fl = static_cast<UINT32>(std::bit_width(size)) - 1;
+	if (fl < SL_BITS) {
+		sl = static_cast<UINT32>((size ^ (UINT64(1) << fl)) << (SL_BITS - fl));
+	}
+	else {
+		sl = static_cast<UINT32>((size >> (fl - SL_BITS)) ^ SL_COUNT);
+	}
+}
+
+/*
+ * Finds a free block of at least `size`. Searches the bins
+ * where every block is large enough first, then the bin the
+ * size itself falls into.
+ */
+UINT32 RangeAllocator::find_free(UINT64 size) const {
+	UINT32 fl, sl;
+	const UINT32 size_fl = static_cast<UINT32>(std::bit_width(size)) - 1;
+	UINT64 rounded = size;
+	if (size_fl >= SL_BITS) {
+		rounded += (UINT64(1) << (size_fl - SL_BITS)) - 1;
+	}
+	mapping(rounded, fl, sl);
+
+	UINT32 sl_map = fl < FL_COUNT ? sl_bitmap[fl] & (~UINT32(0) << sl) : 0;
+	if (sl_map == 0) {
+		const UINT64 fl_map = fl + 1 < FL_COUNT ? fl_bitmap & (~UINT64(0) << (fl + 1)) : 0;
+		if (fl_map != 0) {
+			fl = std::countr_zero(fl_map);
+			sl_map = sl_bitmap[fl];
+		}
+	}
+	if (sl_map != 0) {
+		return bins[fl][std::countr_zero(sl_map)];
+	}
+
+	// blocks in the bin of `size` may still be large enough
+	mapping(size, fl, sl);
+	for (UINT32 b = bins[fl][sl]; b != NONE; b = blocks[b].next_free) {
+		if (blocks[b].size >= size) {
+			return b;
+		}
+	}
+	return NONE;
+}
+
+UINT32 RangeAllocator::new_block() {
+	if (!unused_blocks.empty()) {
+		UINT32 b = unused_blocks.back();
+		unused_blocks.pop_back();
+		return b;
+	}
+	blocks.push_back({});
+	return static_cast<UINT32>(blocks.size() - 1);
+}
+
+void RangeAllocator::insert_free(UINT32 b) {
+	UINT32 fl, sl;
+	mapping(blocks[b].size, fl, sl);
+	blocks[b].free = true;
+	blocks[b].prev_free = NONE;
+	blocks[b].next_free = bins[fl][sl];
+	if (bins[fl][sl] != NONE) {
+		blocks[bins[fl][sl]].prev_free = b;
+	}
+	bins[fl][sl] = b;
+	fl_bitmap |= UINT64(1) << fl;
+	sl_bitmap[fl] |= UINT32(1) << sl;
+}
+
+void RangeAllocator::remove_free(UINT32 b) {
+	UINT32 fl, sl;
+	mapping(blocks[b].size, fl, sl);
+	const UINT32 prev = blocks[b].prev_free;
+	const UINT32 next = blocks[b].next_free;
+	if (prev != NONE) {
+		blocks[prev].next_free = next;
+	}
+	else {
+		bins[fl][sl] = next;
+	}
+	if (next != NONE) {
+		blocks[next].prev_free = prev;
+	}
+	if (bins[fl][sl] == NONE) {
+		sl_bitmap[fl] &= ~(UINT32(1) << sl);
+		if (sl_bitmap[fl] == 0) {
+			fl_bitmap &= ~(UINT64(1) << fl);
+		}
+	}
+	blocks[b].free = false;
+}
+
+/*
+ * Merges the next block in the buffer into `b`.
+ * The next block must not be in any bin.
+ */
+void RangeAllocator::absorb_next(UINT32 b) {
+	const UINT32 next = blocks[b].next_phys;
+	blocks[b].size += blocks[next].size;
+	blocks[b].next_phys = blocks[next].next_phys;
+	if (blocks[b].next_phys != NONE) {
+		blocks[blocks[b].next_phys].prev_phys = b;
+	}
+	if (last_block == next) {
+		last_block = b;
+	}
+	unused_blocks.push_back(next);
+}
+
+/*
+ * Takes the first `size` units of free block `b`,
+ * the rest becomes a new free block.
+ */
+UINT32 RangeAllocator::allocate_from(UINT32 b, UINT64 size) {
+	remove_free(b);
+	if (blocks[b].size > size) {
+		const UINT32 rest = new_block();
+		blocks[rest].offset = blocks[b].offset + size;
+		blocks[rest].size = blocks[b].size - size;
+		blocks[rest].prev_phys = b;
+		blocks[rest].next_phys = blocks[b].next_phys;
+		if (blocks[rest].next_phys != NONE) {
+			blocks[blocks[rest].next_phys].prev_phys = rest;
+		}
+		blocks[b].next_phys = rest;
+		blocks[b].size = size;
+		if (last_block == b) {
+			last_block = rest;
+		}
+		insert_free(rest);
+	}
+	used += size;
+	return b;
+}
+
+/*
+ * Returns block `b` to the free ranges, merging it with free neighbours.
+ */
+void RangeAllocator::release(UINT32 b) {
+	used -= blocks[b].size;
+	const UINT32 next = blocks[b].next_phys;
+	if (next != NONE && blocks[next].free) {
+		remove_free(next);
+		absorb_next(b);
+	}
+	const UINT32 prev = blocks[b].prev_phys;
+	if (prev != NONE && blocks[prev].free) {
+		remove_free(prev);
+		absorb_next(prev);
+		b = prev;
+	}
+	insert_free(b);
+}
+
+RangeAllocator::handle_t RangeAllocator::allocate(UINT64 size) {
+	if (size == 0) {
+		return INVALID_HANDLE;
+	}
+	const UINT32 free_block = find_free(size);
+	if (free_block == NONE) {
+		return INVALID_HANDLE;
+	}
+	const UINT32 b = allocate_from(free_block, size);
+
+	handle_t handle;
+	if (!unused_handles.empty()) {
+		handle = unused_handles.back();
+		unused_handles.pop_back();
+	}
+	else {
+		handle = static_cast<handle_t>(handle_blocks.size());
+		handle_blocks.push_back(NONE);
+	}
+	handle_blocks[handle] = b;
+	blocks[b].handle = handle;
+	return handle;
+}
+
+void RangeAllocator::free(handle_t handle) {
+	release(handle_blocks[handle]);
+	handle_blocks[handle] = NONE;
+	unused_handles.push_back(handle);
+}
+
+void RangeAllocator::grow(UINT64 new_capacity) {
+	if (new_capacity <= capacity) {
+		return;
+	}
+	const UINT64 extra = new_capacity - capacity;
+	if (last_block != NONE && blocks[last_block].free) {
+		remove_free(last_block);
+		blocks[last_block].size += extra;
+		insert_free(last_block);
+	}
+	else {
+		const UINT32 b = new_block();
+		blocks[b].offset = capacity;
+		blocks[b].size = extra;
+		blocks[b].prev_phys = last_block;
+		blocks[b].next_phys = NONE;
+		if (last_block != NONE) {
+			blocks[last_block].next_phys = b;
+		}
+		else {
+			first_block = b;
+		}
+		last_block = b;
+		insert_free(b);
+	}
+	capacity = new_capacity;
+}
+
+std::vector<RangeAllocator::move_t> RangeAllocator::defragment() {
+	// allocations from the end of the buffer to the start
+	std::vector<handle_t> handles;
+	for (UINT32 b = last_block; b != NONE; b = blocks[b].prev_phys) {
+		if (!blocks[b].free) {
+			handles.push_back(blocks[b].handle);
+		}
+	}
+
+	std::vector<move_t> moves;
+	for (handle_t handle : handles) {
+		const UINT32 b = handle_blocks[handle];
+		const UINT64 size = blocks[b].size;
+
+		// lowest hole before the allocation that can hold it
+		UINT32 target = NONE;
+		for (UINT32 f = first_block; f != NONE && blocks[f].offset < blocks[b].offset;
+			f = blocks[f].next_phys) {
+			if (blocks[f].free && blocks[f].size >= size) {
+				target = f;
+				break;
+			}
+		}
+		if (target == NONE) {
+			continue;
+		}
+
+		const UINT32 moved = allocate_from(target, size);
+		moves.push_back({ handle, blocks[b].offset, blocks[moved].offset, size });
+		blocks[moved].handle = handle;
+		handle_blocks[handle] = moved;
+		release(b);
+	}
+	return moves;
+}
+
+UINT64 RangeAllocator::get_offset(handle_t handle) const {
+	return blocks[handle_blocks[handle]].offset;
+}
+
+UINT64 RangeAllocator::get_size(handle_t handle) const {
+	return blocks[handle_blocks[handle]].size;
+}
+
+UINT64 RangeAllocator::get_capacity() const {
+	return capacity;
+}
+
+UINT64 RangeAllocator::get_used() const {
+	return used;
+}
+
+UINT64 RangeAllocator::get_end() const {
+	if (last_block != NONE && blocks[last_block].free) {
+		return blocks[last_block].offset;
+	}
+	return capacity;
+}
+
+UINT64 RangeAllocator::get_largest_free() const {
+	if (fl_bitmap == 0) {
+		return 0;
+	}
+	// the largest block is in the highest non-empty bin
+	const UINT32 fl = 63 - std::countl_zero(fl_bitmap);
+	const UINT32 sl = 31 - std::countl_zero(sl_bitmap[fl]);
+	UINT64 largest = 0;
+	for (UINT32 b = bins[fl][sl]; b != NONE; b = blocks[b].next_free) {
+		largest = (std::max)(largest, blocks[b].size);
+	}
+	return largest;
+}
+
+float RangeAllocator::get_fragmentation() const {
+	const UINT64 free_space = capacity - used;
+	if (free_space == 0) {
+		return 0.0f;
+	}
+	return 1.0f - static_cast<float>(get_largest_free()) / free_space;
+}
\ No newline at end of file
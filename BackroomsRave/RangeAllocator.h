@@ -0,0 +1,96 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <Windows.h>
+#include <array>
+#include <vector>
+
+/*
+ * Two-level segregated fit (TLSF) allocator of ranges inside
+ * a buffer. It only manages offsets, so the same allocator works
+ * for any resource and any unit (bytes, instances, ...).
+ *
+ * Free ranges are kept in bins by size: the first level is the
+ * power of two, the second level splits it linearly into
+ * SL_COUNT parts. Allocation and free are constant time,
+ * neighbouring free ranges are merged immediately.
+ *
+ * Allocations are referred to by handles, which stay valid when
+ * defragment moves the allocation to another offset.
+ */
+class RangeAllocator {
+public:
+	using handle_t = UINT32;
+	static constexpr handle_t INVALID_HANDLE = ~handle_t(0);
+
+	struct move_t {
+		handle_t handle;
+		UINT64 from;
+		UINT64 to;
+		UINT64 size;
+	};
+
+	RangeAllocator(UINT64 capacity);
+
+	// Returns INVALID_HANDLE when there is no free range large enough.
+	handle_t allocate(UINT64 size);
+	void free(handle_t handle);
+	// Adds space at the end of the buffer.
+	void grow(UINT64 new_capacity);
+	// Moves allocations from the end into free ranges before them.
+	// Allocations that already have no hole below stay in place.
+	// The caller has to copy the data as described by the moves.
+	std::vector<move_t> defragment();
+
+	UINT64 get_offset(handle_t handle) const;
+	UINT64 get_size(handle_t handle) const;
+	UINT64 get_capacity() const;
+	UINT64 get_used() const;
+	// End of the last allocation, everything past it is free.
+	UINT64 get_end() const;
+	UINT64 get_largest_free() const;
+	// 0 when all free space is a single range, close to 1 when
+	// it is split into many small ones.
+	float get_fragmentation() const;
+
+private:
+	static constexpr UINT32 SL_BITS = 2;
+	static constexpr UINT32 SL_COUNT = 1 << SL_BITS;
+	static constexpr UINT32 FL_COUNT = 64;
+	static constexpr UINT32 NONE = ~UINT32(0);
+
+	struct block_t {
+		UINT64 offset;
+		UINT64 size;
+		UINT32 prev_phys;       // neighbours in the buffer
+		UINT32 next_phys;
+		UINT32 prev_free;       // neighbours in the bin
+		UINT32 next_free;
+		handle_t handle;
+		bool free;
+	};
+
+	static void mapping(UINT64 size, UINT32& fl, UINT32& sl);
+	UINT32 find_free(UINT64 size) const;
+	UINT32 new_block();
+	void insert_free(UINT32 block);
+	void remove_free(UINT32 block);
+	void absorb_next(UINT32 block);
+	UINT32 allocate_from(UINT32 block, UINT64 size);
+	void release(UINT32 block);
+
+	UINT64 capacity;
+	UINT64 used = 0;
+	std::vector<block_t> blocks;
+	std::vector<UINT32> unused_blocks;
+	std::vector<UINT32> handle_blocks;      // block of every handle
+	std::vector<handle_t> unused_handles;
+	UINT32 first_block = NONE;              // blocks at both ends of the buffer
+	UINT32 last_block = NONE;
+
+	UINT64 fl_bitmap = 0;
+	std::array<UINT32, FL_COUNT> sl_bitmap = {};
+	std::array<std::array<UINT32, SL_COUNT>, FL_COUNT> bins;
+};
+
+#endif // RANGE_ALLOCATOR_H
\ No newline at end of file
@@ -1,5 +1,112 @@
 #include "Rectangle.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace {
+	/*
+	 * Tiling of a rectangle: the world matrix of a tile centered at the
+	 * origin and the number of tiles along both planar axes.
+	 */
+	struct tiling_t {
+		int axis;
+		DirectX::XMFLOAT4X4 base_world;
+		size_t tiles_x;
+		size_t tiles_y;
+	};
+
+	tiling_t make_tiling(const rectangle_desc_t& desc) {
+		const DirectX::XMFLOAT3& pos_lower_left = desc.pos_lower_left;
+		const DirectX::XMFLOAT3& pos_upper_right = desc.pos_upper_right;
+		const FLOAT tile_size = desc.tile_size;
+
+		int axis = 0;
+		DirectX::XMFLOAT2 planar_lower_left;
+		DirectX::XMFLOAT2 planar_upper_right;
+		if (pos_lower_left.x == pos_upper_right.x) {
+			planar_lower_left = { pos_lower_left.y, pos_lower_left.z };
+			planar_upper_right = { pos_upper_right.y, pos_upper_right.z };
+			axis = 0;
+		}
+		else if (pos_lower_left.y == pos_upper_right.y) {
+			planar_lower_left = { pos_lower_left.x, pos_lower_left.z };
+			planar_upper_right = { pos_upper_right.x, pos_upper_right.z };
+			axis = 1;
+		}
+		else if (pos_lower_left.z == pos_upper_right.z) {
+			planar_lower_left = { pos_lower_left.x, pos_lower_left.y };
+			planar_upper_right = { pos_upper_right.x, pos_upper_right.y };
+			axis = 2;
+		}
+		else {
+			throw "Invalid rectangle axis";
+		}
+
+		// rotate the initial square to align with the right axes
+		DirectX::XMMATRIX base_world;
+		switch (axis) {
+		case 0:
+			base_world = DirectX::XMMatrixRotationY(DirectX::XM_PIDIV2);
+			break;
+		case 1:
+			base_world = DirectX::XMMatrixRotationX(-DirectX::XM_PIDIV2);
+			break;
+		default:
+			base_world = DirectX::XMMatrixIdentity();
+		}
+
+		// scale the square to the correct size
+		base_world = DirectX::XMMatrixMultiply(
+			base_world,
+			DirectX::XMMatrixScaling(
+				tile_size / 2.0f,
+				tile_size / 2.0f,
+				tile_size / 2.0f
+			)
+		);
+
+		// orient the square correctly
+		if (desc.change_orientation) {
+			if (axis != 1) {
+				base_world = DirectX::XMMatrixMultiply(
+					base_world,
+					DirectX::XMMatrixRotationY(DirectX::XM_PI)
+				);
+			}
+			else {
+				base_world = DirectX::XMMatrixMultiply(
+					base_world,
+					DirectX::XMMatrixRotationX(DirectX::XM_PI)
+				);
+			}
+		}
+
+		tiling_t tiling;
+		tiling.axis = axis;
+		DirectX::XMStoreFloat4x4(&tiling.base_world, base_world);
+
+		// get number of tiles
+		tiling.tiles_x = static_cast<size_t>(round(
+			std::abs(planar_upper_right.x - planar_lower_left.x) / tile_size
+		));
+		tiling.tiles_y = static_cast<size_t>(round(
+			std::abs(planar_upper_right.y - planar_lower_left.y) / tile_size
+		));
+		return tiling;
+	}
+
+	/*
+	 * Square block of a tiling, `size` tiles wide, whose lower left
+	 * tile is in column `i` and row `j`.
+	 */
+	struct block_t {
+		size_t i;
+		size_t j;
+		size_t size;
+	};
+}
+
 AxisRectangle::AxisRectangle(
 	DirectX::XMFLOAT3 pos_lower_left,
 	DirectX::XMFLOAT3 pos_upper_right,
@@ -7,123 +114,275 @@ AxisRectangle::AxisRectangle(
 	bool change_orientation,
 	FLOAT tile_size,
 	DirectX::XMFLOAT4 color
-) {
-	int axis = 0;
-	DirectX::XMFLOAT2 planar_lower_left;
-	DirectX::XMFLOAT2 planar_upper_right;
-	if (pos_lower_left.x == pos_upper_right.x) {
-		planar_lower_left = { pos_lower_left.y, pos_lower_left.z };
-		planar_upper_right = { pos_upper_right.y, pos_upper_right.z };
-		axis = 0;
-	}
-	else if (pos_lower_left.y == pos_upper_right.y) {
-		planar_lower_left = { pos_lower_left.x, pos_lower_left.z };
-		planar_upper_right = { pos_upper_right.x, pos_upper_right.z };
-		axis = 1;
-	}
-	else if (pos_lower_left.z == pos_upper_right.z) {
-		planar_lower_left = { pos_lower_left.x, pos_lower_left.y };
-		planar_upper_right = { pos_upper_right.x, pos_upper_right.y };
-		axis = 2;
-	}
-	else {
-		throw "Invalid rectangle axis";
-	}
+) :
+	AxisRectangle(rectangle_desc_t{ pos_lower_left, pos_upper_right, tex_lower_left,
+		change_orientation, tile_size, color })
+{}
+
+AxisRectangle::AxisRectangle(const rectangle_desc_t& desc) :
+	instances(tile_count(desc))
+{
+	write_tiles(desc, 0, instances);
+}
+
+std::span<const square_instance_t> AxisRectangle::get_instances() const {
+	return instances;
+}
+
+size_t AxisRectangle::tile_count(const rectangle_desc_t& desc) {
+	const tiling_t tiling = make_tiling(desc);
+	return tiling.tiles_x * tiling.tiles_y;
+}
 
-	// rotate the initial square to align with the right axes
-	DirectX::XMMATRIX base_world;
-	switch (axis) {
-	case 0:
-		base_world = DirectX::XMMatrixRotationY(DirectX::XM_PIDIV2);
-		break;
-	case 1:
-		base_world = DirectX::XMMatrixRotationX(-DirectX::XM_PIDIV2);
-		break;
-	default:
-		base_world = DirectX::XMMatrixIdentity();
+/*
+ * Tile k is at column k / tiles_y and row k % tiles_y, which is the order
+ * the tiles were always built in.
+ */
+void AxisRectangle::write_tiles(const rectangle_desc_t& desc, size_t first,
+	std::span<square_instance_t> out)
+{
+	if (out.empty()) {
+		return;
 	}
+	const tiling_t tiling = make_tiling(desc);
+	const DirectX::XMMATRIX base_world = DirectX::XMLoadFloat4x4(&tiling.base_world);
+	const DirectX::XMFLOAT3& pos_lower_left = desc.pos_lower_left;
+	const FLOAT tile_size = desc.tile_size;
 
-	// scale the square to the correct size
-	base_world = DirectX::XMMatrixMultiply(
-		base_world,
-		DirectX::XMMatrixScaling(
-			tile_size / 2.0f,
-			tile_size / 2.0f,
-			tile_size / 2.0f
-		)
-	);
-
-	// orient the square correctly
-	if (change_orientation) {
-		if (axis != 1) {
-			base_world = DirectX::XMMatrixMultiply(
+	size_t i = first / tiling.tiles_y;
+	size_t j = first % tiling.tiles_y;
+	for (auto& instance : out) {
+		DirectX::XMMATRIX world;
+		switch (tiling.axis) {
+		case 0:
+			world = DirectX::XMMatrixMultiply(
 				base_world,
-				DirectX::XMMatrixRotationY(DirectX::XM_PI)
+				DirectX::XMMatrixTranslation(
+					pos_lower_left.x,
+					pos_lower_left.y + i * tile_size + tile_size / 2.0f,
+					pos_lower_left.z + j * tile_size + tile_size / 2.0f
+				)
 			);
-		}
-		else {
-			base_world = DirectX::XMMatrixMultiply(
+			break;
+		case 1:
+			world = DirectX::XMMatrixMultiply(
 				base_world,
-				DirectX::XMMatrixRotationX(DirectX::XM_PI)
+				DirectX::XMMatrixTranslation(
+					pos_lower_left.x + i * tile_size + tile_size / 2.0f,
+					pos_lower_left.y,
+					pos_lower_left.z + j * tile_size + tile_size / 2.0f
+				)
 			);
+			break;
+		default:
+			world = DirectX::XMMatrixMultiply(
+				base_world,
+				DirectX::XMMatrixTranslation(
+					pos_lower_left.x + i * tile_size + tile_size / 2.0f,
+					pos_lower_left.y + j * tile_size + tile_size / 2.0f,
+					pos_lower_left.z
+				)
+			);
+			break;
+		}
+
+		instance.tex_coord[0] = desc.tex_lower_left.x;
+		instance.tex_coord[1] = desc.tex_lower_left.y;
+		instance.tex_scale[0] = 1.0f;
+		instance.tex_scale[1] = 1.0f;
+		DirectX::XMStoreFloat4x4(&instance.world, world);
+		instance.color = desc.color;
+
+		if (++j == tiling.tiles_y) {
+			j = 0;
+			i++;
 		}
 	}
+}
 
-	// get number of tiles
-	size_t tiles_x = static_cast<size_t>(round(
-		std::abs(planar_upper_right.x - planar_lower_left.x) / tile_size
-	));
-	size_t tiles_y = static_cast<size_t>(round(
-		std::abs(planar_upper_right.y - planar_lower_left.y) / tile_size
-	));
-
-	// create the instance data
-	for (size_t i = 0; i < tiles_x; i++) {
-		for (size_t j = 0; j < tiles_y; j++) {
-			DirectX::XMMATRIX world;
-			switch (axis) {
-			case 0:
-				world = DirectX::XMMatrixMultiply(
-					base_world,
-					DirectX::XMMatrixTranslation(
-						pos_lower_left.x,
-						pos_lower_left.y + i * tile_size + tile_size / 2.0f,
-						pos_lower_left.z + j * tile_size + tile_size / 2.0f
-					)
-				);
-				break;
-			case 1:
-				world = DirectX::XMMatrixMultiply(
-					base_world,
-					DirectX::XMMatrixTranslation(
-						pos_lower_left.x + i * tile_size + tile_size / 2.0f,
-						pos_lower_left.y,
-						pos_lower_left.z + j * tile_size + tile_size / 2.0f
-					)
-				);
-				break;
-			default:
-				world = DirectX::XMMatrixMultiply(
-					base_world,
-					DirectX::XMMatrixTranslation(
-						pos_lower_left.x + i * tile_size + tile_size / 2.0f,
-						pos_lower_left.y + j * tile_size + tile_size / 2.0f,
-						pos_lower_left.z
-					)
-				);
-				break;
+std::array<size_t, 2> AxisRectangle::tile_grid(const rectangle_desc_t& desc) {
+	const tiling_t tiling = make_tiling(desc);
+	return { tiling.tiles_x, tiling.tiles_y };
+}
+
+/*
+ * The block is centered on the tiles it covers and its texture
+ * repeats once per tile, see square_instance_t::tex_scale.
+ */
+square_instance_t AxisRectangle::block_tile(const rectangle_desc_t& desc,
+	size_t i, size_t j, size_t size, FLOAT overlap)
+{
+	const tiling_t tiling = make_tiling(desc);
+	const DirectX::XMMATRIX base_world = DirectX::XMLoadFloat4x4(&tiling.base_world);
+	const FLOAT tile_size = desc.tile_size;
+	const int column_axis = tiling.axis == 0 ? 1 : 0;
+	const int row_axis = tiling.axis == 2 ? 1 : 2;
+	const FLOAT scale = static_cast<FLOAT>(size) * (1.0f + overlap);
+	FLOAT center[3] = { desc.pos_lower_left.x, desc.pos_lower_left.y, desc.pos_lower_left.z };
+	center[column_axis] += i * tile_size + size * tile_size / 2.0f;
+	center[row_axis] += j * tile_size + size * tile_size / 2.0f;
+
+	square_instance_t instance;
+	instance.tex_coord[0] = desc.tex_lower_left.x;
+	instance.tex_coord[1] = desc.tex_lower_left.y;
+	DirectX::XMStoreFloat4x4(&instance.world, DirectX::XMMatrixMultiply(
+		DirectX::XMMatrixMultiply(DirectX::XMMatrixScaling(scale, scale, 1.0f), base_world),
+		DirectX::XMMatrixTranslation(center[0], center[1], center[2])));
+	instance.color = desc.color;
+	instance.tex_scale[0] = static_cast<FLOAT>(size);
+	instance.tex_scale[1] = static_cast<FLOAT>(size);
+	return instance;
+}
+
+/*
+ * The columns of write_tiles run along the first planar axis,
+ * the rows along the second one.
+ */
+size_t AxisRectangle::tile_at(const rectangle_desc_t& desc, DirectX::XMFLOAT3 position) {
+	const tiling_t tiling = make_tiling(desc);
+	const FLOAT point[3] = { position.x, position.y, position.z };
+	const FLOAT lower_left[3] = {
+		desc.pos_lower_left.x, desc.pos_lower_left.y, desc.pos_lower_left.z
+	};
+	auto index = [&](int axis, size_t count) {
+		const FLOAT i = std::floor((point[axis] - lower_left[axis]) / desc.tile_size);
+		return static_cast<size_t>(std::clamp(i, 0.0f, static_cast<FLOAT>(count) - 1.0f));
+	};
+	const int column_axis = tiling.axis == 0 ? 1 : 0;
+	const int row_axis = tiling.axis == 2 ? 1 : 2;
+	return index(column_axis, tiling.tiles_x) * tiling.tiles_y + index(row_axis, tiling.tiles_y);
+}
+
+/*
+ * The blocks are the leaves of a quadtree aligned to the lower left corner.
+ * A block is split while it sticks out of the rectangle or the light of
+ * a point, interpolated between its corners like the vertex lighting,
+ * misses by more than SUBDIVISION_ERROR at the middle of the block or
+ * of one of its edges. Then blocks next to ones less than half their
+ * size are split, so no edge has more than one T-junction and the
+ * vertex lighting on both sides of it differs little.
+ * Blocks next to smaller ones are grown by T_JUNCTION_OVERLAP, so the
+ * vertex in the middle of their edge does not leave a crack.
+ */
+void AxisRectangle::write_adaptive_tiles(const rectangle_desc_t& desc,
+	std::span<const DirectX::XMFLOAT3> lights, std::vector<square_instance_t>& out)
+{
+	const tiling_t tiling = make_tiling(desc);
+	const size_t tiles_x = tiling.tiles_x;
+	const size_t tiles_y = tiling.tiles_y;
+	if (tiles_x == 0 || tiles_y == 0) {
+		return;
+	}
+	const FLOAT tile_size = desc.tile_size;
+	const FLOAT lower_left[3] = {
+		desc.pos_lower_left.x, desc.pos_lower_left.y, desc.pos_lower_left.z
+	};
+	const int column_axis = tiling.axis == 0 ? 1 : 0;
+	const int row_axis = tiling.axis == 2 ? 1 : 2;
+
+	// light of `point` at planar coordinates (x, y) of the rectangle
+	auto light = [&](const DirectX::XMFLOAT3& point, FLOAT x, FLOAT y) {
+		const FLOAT lamp[3] = { point.x, point.y, point.z };
+		const FLOAT dx = x - lamp[column_axis];
+		const FLOAT dy = y - lamp[row_axis];
+		const FLOAT dz = lower_left[tiling.axis] - lamp[tiling.axis];
+		const FLOAT distance_squared = dx * dx + dy * dy + dz * dz;
+		// cosine with the normal, either side of the rectangle
+		const FLOAT cosine = distance_squared > 0.0f ? std::abs(dz) / std::sqrt(distance_squared) : 1.0f;
+		return cosine / (1.0f + 0.1f * distance_squared);
+	};
+	auto light_error = [&](const block_t& block) {
+		const FLOAT x0 = lower_left[column_axis] + block.i * tile_size;
+		const FLOAT y0 = lower_left[row_axis] + block.j * tile_size;
+		const FLOAT x1 = x0 + block.size * tile_size;
+		const FLOAT y1 = y0 + block.size * tile_size;
+		const FLOAT xm = (x0 + x1) / 2.0f;
+		const FLOAT ym = (y0 + y1) / 2.0f;
+		FLOAT error = 0.0f;
+		for (const DirectX::XMFLOAT3& point : lights) {
+			const FLOAT corners[4] = {
+				light(point, x0, y0), light(point, x1, y0), light(point, x0, y1), light(point, x1, y1)
+			};
+			// the vertex lighting interpolates the corners
+			const FLOAT errors[5] = {
+				light(point, xm, ym) - (corners[0] + corners[1] + corners[2] + corners[3]) / 4.0f,
+				light(point, xm, y0) - (corners[0] + corners[1]) / 2.0f,
+				light(point, xm, y1) - (corners[2] + corners[3]) / 2.0f,
+				light(point, x0, ym) - (corners[0] + corners[2]) / 2.0f,
+				light(point, x1, ym) - (corners[1] + corners[3]) / 2.0f
+			};
+			for (FLOAT e : errors) {
+				error = (std::max)(error, std::abs(e));
 			}
+		}
+		return error;
+	};
 
-			square_instance_t instance;
-			instance.tex_coord[0] = tex_lower_left.x;
-			instance.tex_coord[1] = tex_lower_left.y;
-			DirectX::XMStoreFloat4x4(&instance.world, world);
-			instance.color = color;
-			instances.push_back(instance);
+	// block size of every tile, column by column
+	std::vector<size_t> sizes(tiles_x * tiles_y, 0);
+	auto fill = [&](const block_t& block, size_t size) {
+		for (size_t i = block.i; i < block.i + block.size; i++) {
+			std::fill_n(sizes.begin() + i * tiles_y + block.j, block.size, size);
+		}
+	};
+	std::vector<block_t> stack = { { 0, 0, std::bit_ceil((std::max)(tiles_x, tiles_y)) } };
+	while (!stack.empty()) {
+		const block_t block = stack.back();
+		stack.pop_back();
+		if (block.i >= tiles_x || block.j >= tiles_y) {
+			continue;
 		}
+		const bool inside = block.i + block.size <= tiles_x && block.j + block.size <= tiles_y;
+		if (block.size > 1 && (!inside || light_error(block) > SUBDIVISION_ERROR)) {
+			const size_t half = block.size / 2;
+			stack.push_back({ block.i, block.j, half });
+			stack.push_back({ block.i + half, block.j, half });
+			stack.push_back({ block.i, block.j + half, half });
+			stack.push_back({ block.i + half, block.j + half, half });
+			continue;
+		}
+		fill(block, block.size);
 	}
-}
 
-std::vector<square_instance_t> AxisRectangle::get_instances() {
-	return instances;
+	// smallest block along the edges of a block, its own size if none
+	auto smallest_neighbour = [&](const block_t& block) {
+		size_t smallest = block.size;
+		auto visit = [&](size_t i, size_t j) {
+			if (i < tiles_x && j < tiles_y) {
+				smallest = (std::min)(smallest, sizes[i * tiles_y + j]);
+			}
+		};
+		for (size_t k = 0; k < block.size; k++) {
+			// wraps around below the first column or row, out of the rectangle
+			visit(block.i - 1, block.j + k);
+			visit(block.i + block.size, block.j + k);
+			visit(block.i + k, block.j - 1);
+			visit(block.i + k, block.j + block.size);
+		}
+		return smallest;
+	};
+	auto for_each_block = [&](auto&& body) {
+		for (size_t i = 0; i < tiles_x; i++) {
+			for (size_t j = 0; j < tiles_y; j++) {
+				const size_t size = sizes[i * tiles_y + j];
+				if (i % size == 0 && j % size == 0) {
+					body(block_t{ i, j, size });
+				}
+			}
+		}
+	};
+	for (bool split = true; split;) {
+		split = false;
+		for_each_block([&](const block_t& block) {
+			if (block.size > 2 && smallest_neighbour(block) < block.size / 2) {
+				fill(block, block.size / 2);
+				split = true;
+			}
+		});
+	}
+
+	for_each_block([&](const block_t& block) {
+		out.push_back(block_tile(desc, block.i, block.j, block.size,
+			smallest_neighbour(block) < block.size ? T_JUNCTION_OVERLAP : 0.0f));
+	});
 }
\ No newline at end of file
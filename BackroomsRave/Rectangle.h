@@ -3,13 +3,31 @@
 
 #include <DirectXMath.h>
 #include <Windows.h>
+#include <array>
+#include <span>
 #include <vector>
 
 #include "types.h"
 
+/**
+ * Parameters of an AxisRectangle, as listed in the scene configuration.
+ */
+struct rectangle_desc_t {
+	DirectX::XMFLOAT3 pos_lower_left;
+	DirectX::XMFLOAT3 pos_upper_right;
+	DirectX::XMFLOAT2 tex_lower_left;
+	bool change_orientation;
+	FLOAT tile_size;
+	DirectX::XMFLOAT4 color = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
 /**
  * A rectangle in 3D space along some two axes.
  * Constructed with smaller square tiles for better vertex lighting.
+ *
+ * Tiles are numbered column by column, so any range of them can be
+ * written without building the whole rectangle. Adaptive tilings use
+ * larger tiles away from the lamps instead.
  */
 class AxisRectangle {
 	public:
@@ -23,8 +41,34 @@ class AxisRectangle {
 			// change to ignore lighting and set a fixed color (used for lamps)
 			DirectX::XMFLOAT4 color = { 0.0f, 0.0f, 0.0f, 0.0f }
 		);
+		AxisRectangle(const rectangle_desc_t& desc);
+
+	std::span<const square_instance_t> get_instances() const;
+
+	// Number of tiles of the rectangle described by `desc`.
+	static size_t tile_count(const rectangle_desc_t& desc);
+	// Writes tiles [first, first + out.size()) of the rectangle into `out`.
+	static void write_tiles(const rectangle_desc_t& desc, size_t first,
+		std::span<square_instance_t> out);
+	// Columns and rows of tiles of the rectangle described by `desc`.
+	static std::array<size_t, 2> tile_grid(const rectangle_desc_t& desc);
+	// Square tile over `size` by `size` tiles of the rectangle described by
+	// `desc`, from column `i` and row `j`, grown by `overlap` of its size.
+	static square_instance_t block_tile(const rectangle_desc_t& desc,
+		size_t i, size_t j, size_t size, FLOAT overlap);
+	// Tile of the rectangle described by `desc` containing `position`,
+	// a point in its plane. Points outside belong to the nearest tile.
+	static size_t tile_at(const rectangle_desc_t& desc, DirectX::XMFLOAT3 position);
 
-	std::vector<square_instance_t> get_instances();
+	// Largest error of the vertex lighting of a tile of write_adaptive_tiles
+	static constexpr FLOAT SUBDIVISION_ERROR = 1.0f / 32.0f;
+	// Part of a tile size larger tiles reach over their smaller neighbours
+	static constexpr FLOAT T_JUNCTION_OVERLAP = 1.0f / 256.0f;
+	// Appends the tiles of the rectangle described by `desc` to `out`, merged
+	// into square blocks of 2^k tiles where the light of `lights`, points
+	// along the lamp paths, changes little across them.
+	static void write_adaptive_tiles(const rectangle_desc_t& desc,
+		std::span<const DirectX::XMFLOAT3> lights, std::vector<square_instance_t>& out);
 
 	private:
 		std::vector<square_instance_t> instances;
@@ -1,49 +1,114 @@
 #include "Scene.h"
 
-Scene::Scene(SceneConfig config) {
-	lamps = config.get_lamps();
-	auto rectangles = config.get_rectangles();
-	for (AxisRectangle rectangle : rectangles) {
-		auto square_instances = rectangle.get_instances();
-		const_instances.insert(const_instances.end(), square_instances.begin(),
-			square_instances.end());
+#include <algorithm>
+#include "TileMerger.h"
+
+Scene::Scene(const SceneConfig& config, JobSystem& jobs) :
+	lamps(config.get_lamps(), config.get_seed(), jobs),
+	static_instances(build_static_instances(config.get_rectangles(), jobs))
+{}
+
+/*
+ * Tile counts are summed up first, so every tile has a fixed slot
+ * and jobs fill any range of the output independently.
+ */
+std::vector<square_instance_t> Scene::build_static_instances(
+	std::span<const rectangle_desc_t> rectangles, JobSystem& jobs)
+{
+	std::vector<size_t> offsets(rectangles.size() + 1, 0);
+	for (size_t i = 0; i < rectangles.size(); i++) {
+		offsets[i + 1] = offsets[i] + AxisRectangle::tile_count(rectangles[i]);
 	}
-	update_instances();
+
+	std::vector<square_instance_t> instances(offsets.back());
+	jobs.parallel_for(instances.size(), TILES_PER_JOB, [&](size_t begin, size_t end) {
+		// last rectangle starting at or before `begin`
+		size_t r = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+		while (begin < end) {
+			const size_t last = (std::min)(end, offsets[r + 1]);
+			AxisRectangle::write_tiles(rectangles[r], begin - offsets[r],
+				std::span(instances).subspan(begin, last - begin));
+			begin = last;
+			r++;
+		}
+	});
+	return instances;
 }
 
-void Scene::update_instances() {
-	instances = const_instances;
-	for (auto lamp : lamps) {
-		lamp->update();
-		auto lamp_instances = lamp->get_instances();
-		instances.insert(instances.end(), lamp_instances.begin(),
-			lamp_instances.end());
-	}
+void Scene::update(uint64_t tick, uint64_t time_ms) {
+	lamps.update(tick, time_ms);
 }
 
-std::vector<square_instance_t> Scene::get_instances() {
-	return instances;
+size_t Scene::get_instance_count() const {
+	return static_instances.size() + lamps.size() * LampSystem::INSTANCES_PER_LAMP;
+}
+
+size_t Scene::get_lamp_count() const {
+	return lamps.size();
+}
+
+std::span<const square_instance_t> Scene::get_static_instances() const {
+	return static_instances;
+}
+
+const LampSystem& Scene::get_lamps() const {
+	return lamps;
 }
 
-std::vector<DirectX::XMFLOAT4> Scene::get_lamp_positions() const {
-	std::vector<DirectX::XMFLOAT4> positions;
-	for (auto lamp : lamps) {
-		auto position = lamp->get_position();
-		positions.push_back({
-			position.x,
-			position.y,
-			position.z,
-			0.0f
-		});
+/*
+ * Bounce light goes into rgb and the occlusion into the alpha, negated
+ * so the vertex shader still lights the instance, see VertexShader.hlsl.
+ */
+void Scene::set_static_lighting(std::span<const baked_tile_t> tiles) {
+	const size_t n = (std::min)(tiles.size(), static_instances.size());
+	for (size_t i = 0; i < n; i++) {
+		DirectX::XMFLOAT4& color = static_instances[i].color;
+		if (color.w <= 0.0f) {
+			color = { tiles[i].bounce.x, tiles[i].bounce.y, tiles[i].bounce.z, -tiles[i].occlusion };
+		}
 	}
-	return positions;
 }
 
-std::vector<DirectX::XMFLOAT4> Scene::get_lamp_colors() const {
-	std::vector<DirectX::XMFLOAT4> colors;
-	for (auto lamp : lamps) {
-		auto color = lamp->get_color();
-		colors.push_back(color);
+void Scene::merge_static_instances() {
+	static_instances = merge_tiles(static_instances);
+}
+
+/*
+ * Rectangles are tiled in parallel, then appended in configuration order.
+ */
+void Scene::subdivide_static_instances(std::span<const rectangle_desc_t> rectangles,
+	std::span<const lamp_desc_t> lamps, JobSystem& jobs)
+{
+	std::vector<DirectX::XMFLOAT3> lights;
+	for (const lamp_desc_t& lamp : lamps) {
+		const std::vector<DirectX::XMFLOAT3> samples = build_arc_length_table(lamp);
+		lights.insert(lights.end(), samples.begin(), samples.end());
+	}
+
+	std::vector<std::vector<square_instance_t>> tiles(rectangles.size());
+	jobs.parallel_for(rectangles.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t r = begin; r < end; r++) {
+			AxisRectangle::write_adaptive_tiles(rectangles[r], lights, tiles[r]);
+		}
+	});
+	static_instances.clear();
+	for (const std::vector<square_instance_t>& rectangle_tiles : tiles) {
+		static_instances.insert(static_instances.end(), rectangle_tiles.begin(), rectangle_tiles.end());
 	}
-	return colors;
+}
+
+void Scene::write_dynamic_instances(std::span<square_instance_t> out) const {
+	lamps.write_instances(out);
+}
+
+void Scene::write_lamp_positions(std::span<DirectX::XMFLOAT4> out) const {
+	lamps.write_positions(out);
+}
+
+void Scene::write_lamp_colors(std::span<DirectX::XMFLOAT4> out) const {
+	lamps.write_colors(out);
+}
+
+void Scene::write_lamp_velocities(std::span<DirectX::XMFLOAT3> out) const {
+	lamps.write_velocities(out);
 }
\ No newline at end of file
@@ -1,26 +1,62 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <span>
 #include <vector>
+#include "JobSystem.h"
+#include "LampSystem.h"
+#include "LightBaker.h"
 #include "SceneConfig.h"
 #include "types.h"
 
 /*
- * Class storing current state of the scene
+ * Class storing current state of the scene.
+ *
+ * Instances are static ones (walls, floor, ceiling) followed by
+ * dynamic ones (lamps). Static instances have to be uploaded once,
+ * dynamic ones are written straight into the destination memory
+ * after every update.
+ *
+ * Building and updating the scene is split into jobs. Static instances
+ * are tiled straight into their final place, in configuration order.
  */
 class Scene {
 	public:
-		Scene(SceneConfig config);
+		static constexpr size_t TILES_PER_JOB = 4096;
 
-		std::vector<square_instance_t> get_instances();
-		void update_instances();
-		std::vector<DirectX::XMFLOAT4> get_lamp_positions() const;
-		std::vector<DirectX::XMFLOAT4> get_lamp_colors() const;
+		Scene(const SceneConfig& config, JobSystem& jobs);
+
+		static std::vector<square_instance_t> build_static_instances(
+			std::span<const rectangle_desc_t> rectangles, JobSystem& jobs);
+
+		// `tick` counts the simulation steps from the start,
+		// `time_ms` is the animation time of the frame
+		void update(uint64_t tick, uint64_t time_ms);
+		size_t get_instance_count() const;
+		size_t get_lamp_count() const;
+		std::span<const square_instance_t> get_static_instances() const;
+		const LampSystem& get_lamps() const;
+
+		// Puts baked lighting, one per static instance, into the colors
+		// of the lit static instances.
+		void set_static_lighting(std::span<const baked_tile_t> tiles);
+		// Replaces the static tiles with the quads of merge_tiles, which
+		// have no baked lighting and no longer match the rectangles.
+		void merge_static_instances();
+		// Replaces the static tiles with the adaptive tiling of `rectangles`,
+		// fine only near the paths of `lamps`, which has no baked lighting.
+		void subdivide_static_instances(std::span<const rectangle_desc_t> rectangles,
+			std::span<const lamp_desc_t> lamps, JobSystem& jobs);
+
+		// Writers fill `out` with as much data as it fits.
+		void write_dynamic_instances(std::span<square_instance_t> out) const;
+		void write_lamp_positions(std::span<DirectX::XMFLOAT4> out) const;
+		void write_lamp_colors(std::span<DirectX::XMFLOAT4> out) const;
+		void write_lamp_velocities(std::span<DirectX::XMFLOAT3> out) const;
 
 	private:
-		std::vector<square_instance_t> const_instances;
-		std::vector<std::shared_ptr<MovingLamp>> lamps;
-		std::vector<square_instance_t> instances;
+		LampSystem lamps;
+		std::vector<square_instance_t> static_instances;
 };
 
 #endif // SCENE_H
\ No newline at end of file
@@ -4,6 +4,9 @@ const float TILE_SIZE = 1.0f;
 
 SceneConfig::SceneConfig() {
 	texture_path = L"assets/full_texture.png";
+	music_path = L"assets/caramelldansen.wav";
+	// fixes lamp colors on every beat
+	seed = 165;
 
 	base_square = {
 		// Position (x, y, z)       Color RGBA                   Texture coords Normal
@@ -16,171 +19,178 @@ SceneConfig::SceneConfig() {
 	};
 		
 	// floor
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, -15.0f },
 		{  5.0f, -1.0f,  15.0f },
 		{ 0.5f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// ceiling
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f,  3.0f, -15.0f },
 		{  5.0f,  3.0f,  15.0f },
 		{ 0.0f, 0.0f },
 		false,
 		TILE_SIZE
-	));
+	});
 	// north room north wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, 15.0f },
 		{  5.0f,  3.0f, 15.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 	// north room west wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, 5.0f },
 		{ -5.0f,  3.0f, 15.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// north room east wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ 5.0f, -1.0f, 5.0f },
 		{ 5.0f,  3.0f, 15.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 	// north room southwest wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, 5.0f },
 		{ -2.0f,  3.0f, 5.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// north room southeast wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ 2.0f, -1.0f, 5.0f },
 		{ 5.0f,  3.0f, 5.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// corridor west wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -2.0f, -1.0f, -5.0f },
 		{ -2.0f,  3.0f, 5.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// corridor east wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ 2.0f, -1.0f, -5.0f },
 		{ 2.0f,  3.0f, 5.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 
 	// south room south wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, -15.0f },
 		{  5.0f,  3.0f, -15.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// south room west wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, -15.0f },
 		{ -5.0f,  3.0f, -5.0f },
 		{ 0.0f, 0.5f },
 		true,
 		TILE_SIZE
-	));
+	});
 	// south room east wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ 5.0f, -1.0f, -15.0f },
 		{ 5.0f,  3.0f, -5.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 	// south room northwest wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ -5.0f, -1.0f, -5.0f },
 		{ -2.0f,  3.0f, -5.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 	// south room northeast wall
-	rectangles.push_back(AxisRectangle(
+	rectangles.push_back({
 		{ 2.0f, -1.0f, -5.0f },
 		{ 5.0f,  3.0f, -5.0f },
 		{ 0.0f, 0.5f },
 		false,
 		TILE_SIZE
-	));
+	});
 
 	// corridor lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(0.0f, 2.75f, -9.5f),
-		DirectX::XMFLOAT3(0.0f, 2.75f, 9.5f),
+	lamps.push_back({
+		{ { 0.0f, 2.75f, -9.5f }, { 0.0f, 2.75f, 9.5f } },
 		0.003f
-	));
-
-	// north horizontal lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(-3.0f, 2.75f, 10.0f),
-		DirectX::XMFLOAT3(3.0f, 2.75f, 10.0f),
-		0.002f
-	));
-
-	// south horizontal lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(-3.0f, 2.75f, -10.0f),
-		DirectX::XMFLOAT3(3.0f, 2.75f, -10.0f),
-		0.002f
-	));
+	});
+
+	// north circling lamp
+	lamps.push_back({
+		{
+			{ -2.5f, 2.75f, 10.0f },
+			{ 0.0f, 2.75f, 12.5f },
+			{ 2.5f, 2.75f, 10.0f },
+			{ 0.0f, 2.75f, 7.5f }
+		},
+		0.00075f,
+		path_type_t::CATMULL_ROM,
+		true
+	});
+
+	// south square circuit lamp
+	lamps.push_back({
+		{
+			{ -2.5f, 2.75f, -12.5f },
+			{ 2.5f, 2.75f, -12.5f },
+			{ 2.5f, 2.75f, -7.5f },
+			{ -2.5f, 2.75f, -7.5f }
+		},
+		0.0006f,
+		path_type_t::WAYPOINTS,
+		true
+	});
 
 	// northwest vertical lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(-3.5f, 2.75f, 6.0f),
-		DirectX::XMFLOAT3(-3.5f, 2.75f, 14.0f),
+	lamps.push_back({
+		{ { -3.5f, 2.75f, 6.0f }, { -3.5f, 2.75f, 14.0f } },
 		0.002f
-	));
+	});
 
 	// northeast vertical lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(3.5f, 2.75f, 14.0f),
-		DirectX::XMFLOAT3(3.5f, 2.75f, 6.0f),
+	lamps.push_back({
+		{ { 3.5f, 2.75f, 14.0f }, { 3.5f, 2.75f, 6.0f } },
 		0.002f
-	));
+	});
 
 	// southwest vertical lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(-3.5f, 2.75f, -6.0f),
-		DirectX::XMFLOAT3(-3.5f, 2.75f, -14.0f),
+	lamps.push_back({
+		{ { -3.5f, 2.75f, -6.0f }, { -3.5f, 2.75f, -14.0f } },
 		0.002f
-	));
+	});
 
 	// southeast vertical lamp
-	lamps.push_back(std::make_shared<MovingLamp>(
-		DirectX::XMFLOAT3(3.5f, 2.75f, -14.0f),
-		DirectX::XMFLOAT3(3.5f, 2.75f, -6.0f),
+	lamps.push_back({
+		{ { 3.5f, 2.75f, -14.0f }, { 3.5f, 2.75f, -6.0f } },
 		0.002f
-	));
+	});
 
 }
 
-std::vector<vertex_t> SceneConfig::get_base_square() const {
+std::span<const vertex_t> SceneConfig::get_base_square() const {
 	return base_square;
 }
 
@@ -188,10 +198,18 @@ PCWSTR SceneConfig::get_texture_path() const {
 	return texture_path;
 }
 
-std::vector<AxisRectangle> SceneConfig::get_rectangles() const {
+PCWSTR SceneConfig::get_music_path() const {
+	return music_path;
+}
+
+uint64_t SceneConfig::get_seed() const {
+	return seed;
+}
+
+std::span<const rectangle_desc_t> SceneConfig::get_rectangles() const {
 	return rectangles;
 }
 
-std::vector<std::shared_ptr<MovingLamp>> SceneConfig::get_lamps() const {
+std::span<const lamp_desc_t> SceneConfig::get_lamps() const {
 	return lamps;
 }
\ No newline at end of file
@@ -2,10 +2,10 @@
 #define SCENE_CONFIG_H
 
 #include <Windows.h>
+#include <span>
 #include <vector>
-#include <memory>
 #include "Rectangle.h"
-#include "MovingLamp.h"
+#include "LampSystem.h"
 #include "types.h"
 
 /*
@@ -15,16 +15,20 @@
 class SceneConfig {
 public:
 	SceneConfig();
-	std::vector<vertex_t> get_base_square() const;
+	std::span<const vertex_t> get_base_square() const;
 	PCWSTR get_texture_path() const;
-	std::vector<AxisRectangle> get_rectangles() const;
-	std::vector<std::shared_ptr<MovingLamp>> get_lamps() const;
+	PCWSTR get_music_path() const;
+	uint64_t get_seed() const;
+	std::span<const rectangle_desc_t> get_rectangles() const;
+	std::span<const lamp_desc_t> get_lamps() const;
 
 private:
 	PCWSTR texture_path;
+	PCWSTR music_path;
+	uint64_t seed;
 	std::vector<vertex_t> base_square;
-	std::vector<AxisRectangle> rectangles;
-	std::vector<std::shared_ptr<MovingLamp>> lamps;
+	std::vector<rectangle_desc_t> rectangles;
+	std::vector<lamp_desc_t> lamps;
 };
 
 #endif // SCENE_CONFIG_H
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "PointLightKernel.h"
+#include "simd.h"
+
+using namespace DirectX;
+
+namespace {
+	constexpr size_t INSTANCES_PER_JOB = 1024;
+	constexpr size_t TRIANGLES_PER_JOB = 4096;
+	// vertices lit at once, a multiple of the lanes
+	constexpr size_t LIGHT_BATCH = 256;
+	constexpr UINT LANES = 4;
+	constexpr INT32 SUBPIXEL_BITS = 8;
+	constexpr INT32 SUBPIXELS = 1 << SUBPIXEL_BITS;
+	// screen positions are clamped to this many pixels around the origin,
+	// so they fit 24.8 fixed point
+	constexpr FLOAT GUARD_BAND = 1 << 22;
+
+	UINT32 to_unorm8(FLOAT value) {
+		return static_cast<UINT32>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	UINT32 pack_color(const FLOAT color[4]) {
+		return to_unorm8(color[0]) | to_unorm8(color[1]) << 8
+			| to_unorm8(color[2]) << 16 | to_unorm8(color[3]) << 24;
+	}
+
+	XMVECTOR load_lanes(const FLOAT lanes[LANES]) {
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(lanes));
+	}
+
+	void store_lanes(FLOAT lanes[LANES], FXMVECTOR v) {
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(lanes), v);
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(UINT width, UINT height, JobSystem& jobs) :
+	width(width),
+	height(height),
+	tiles_x((width + TILE_SIZE - 1) / TILE_SIZE),
+	tiles_y((height + TILE_SIZE - 1) / TILE_SIZE),
+	jobs(jobs),
+	colors(size_t(width) * height),
+	depths(size_t(width) * height + LANES - 1, 1.0f),
+	bins(size_t(tiles_x) * tiles_y),
+	shaded_pixels(bins.size(), 0)
+{
+}
+
+void SoftwareRasterizer::set_texture(UINT width, UINT height, const BYTE* bits) {
+	texture_width = width;
+	texture_height = height;
+	texture.resize(size_t(width) * height);
+	memcpy(texture.data(), bits, texture.size() * sizeof(UINT32));
+}
+
+void SoftwareRasterizer::clear(const FLOAT color[4]) {
+	std::fill(colors.begin(), colors.end(), pack_color(color));
+	std::fill(depths.begin(), depths.end(), 1.0f);
+	std::fill(shaded_pixels.begin(), shaded_pixels.end(), 0);
+}
+
+void SoftwareRasterizer::draw(const vs_const_buffer_t& constants,
+	std::span<const vertex_t> base, std::span<const square_instance_t> instances)
+{
+	const size_t triangles_per_instance = base.size() / 3;
+	const size_t triangle_count = instances.size() * triangles_per_instance;
+	if (triangle_count == 0) {
+		return;
+	}
+
+	shade_vertices(constants, base, instances);
+
+	// a triangle cut by the near plane may become two
+	triangles.resize(2 * triangle_count);
+	jobs.parallel_for(triangle_count, TRIANGLES_PER_JOB, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; t++) {
+			const size_t instance = t / triangles_per_instance;
+			const size_t first_vertex = instance * base.size()
+				+ 3 * (t - instance * triangles_per_instance);
+			setup_triangle(t, &vertices[first_vertex]);
+		}
+	});
+
+	jobs.parallel_for(tiles_y, 1, [this](size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++) {
+			bin_row(static_cast<UINT>(row));
+		}
+	});
+	jobs.parallel_for(bins.size(), 1, [this](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			rasterize_tile(static_cast<UINT>(tile));
+		}
+	});
+}
+
+UINT SoftwareRasterizer::get_width() const {
+	return width;
+}
+
+UINT SoftwareRasterizer::get_height() const {
+	return height;
+}
+
+double SoftwareRasterizer::get_overdraw() const {
+	UINT64 shaded = 0;
+	for (UINT64 pixels : shaded_pixels) {
+		shaded += pixels;
+	}
+	return static_cast<double>(shaded) / (static_cast<double>(width) * height);
+}
+
+std::span<const UINT32> SoftwareRasterizer::get_pixels() const {
+	return colors;
+}
+
+bool SoftwareRasterizer::write_ppm(PCWSTR path) const {
+	std::ofstream file{ std::filesystem::path(path), std::ios::binary };
+	if (!file) {
+		return false;
+	}
+
+	char header[64];
+	const int header_size = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+	file.write(header, header_size);
+	std::vector<char> row(size_t(width) * 3);
+	for (UINT y = 0; y < height; y++) {
+		for (UINT x = 0; x < width; x++) {
+			const UINT32 color = colors[size_t(y) * width + x];
+			row[3 * x] = static_cast<char>(color & 0xff);
+			row[3 * x + 1] = static_cast<char>((color >> 8) & 0xff);
+			row[3 * x + 2] = static_cast<char>((color >> 16) & 0xff);
+		}
+		file.write(row.data(), row.size());
+	}
+	return static_cast<bool>(file);
+}
+
+/*
+ * Runs the vertex shader for every vertex of every instance, following
+ * VertexShader.hlsl. The matrices of the constant buffer are stored
+ * transposed for the shader. Vertices are lit in batches by the point
+ * light kernel, lamps keep the color of their instance.
+ */
+void SoftwareRasterizer::shade_vertices(const vs_const_buffer_t& constants,
+	std::span<const vertex_t> base, std::span<const square_instance_t> instances)
+{
+	vertices.resize(instances.size() * base.size());
+	const XMMATRIX view_proj = XMMatrixTranspose(XMLoadFloat4x4(&constants.matViewProj));
+	const PointLightKernel lights(constants);
+
+	jobs.parallel_for(instances.size(), INSTANCES_PER_JOB, [&](size_t begin, size_t end) {
+		// world space vertices of a batch, padded to whole lanes
+		FLOAT position[3][LIGHT_BATCH];
+		FLOAT normal[3][LIGHT_BATCH];
+		FLOAT color[4][LIGHT_BATCH];
+		FLOAT ambient[4][LIGHT_BATCH];
+		FLOAT lit[4][LIGHT_BATCH];
+		light_batch_t batch = {
+			{ position[0], position[1], position[2] },
+			{ normal[0], normal[1], normal[2] },
+			{ color[0], color[1], color[2], color[3] },
+			{ ambient[0], ambient[1], ambient[2], ambient[3] },
+			{ lit[0], lit[1], lit[2], lit[3] },
+			0
+		};
+
+		const size_t last = end * base.size();
+		for (size_t first = begin * base.size(); first < last; first += LIGHT_BATCH) {
+			const size_t count = (std::min)(LIGHT_BATCH, last - first);
+			for (size_t k = 0; k < lane_padded(count); k++) {
+				if (k >= count) {
+					// padding lanes are lit but not used
+					for (size_t c = 0; c < 3; c++) {
+						position[c][k] = normal[c][k] = 0.0f;
+					}
+					for (size_t c = 0; c < 4; c++) {
+						color[c][k] = ambient[c][k] = 0.0f;
+					}
+					continue;
+				}
+				const square_instance_t& instance = instances[(first + k) / base.size()];
+				const vertex_t& vertex = base[(first + k) % base.size()];
+				shaded_vertex_t& out = vertices[first + k];
+				const XMMATRIX world = XMLoadFloat4x4(&instance.world);
+
+				XMFLOAT3 world_position;
+				const XMVECTOR world_position_vector = XMVectorSetW(XMVector4Transform(
+					XMVectorSet(vertex.position[0], vertex.position[1], vertex.position[2], 1.0f),
+					world), 1.0f);
+				XMStoreFloat3(&world_position, world_position_vector);
+				XMStoreFloat4(&out.position, XMVector4Transform(world_position_vector, view_proj));
+				// tiles with one copy of the texture are mapped into the atlas
+				// here, larger ones repeat it per pixel, see PixelShader.hlsl
+				if (instance.tex_scale[0] == 1.0f && instance.tex_scale[1] == 1.0f) {
+					XMStoreFloat2(&out.tex, XMVectorMultiplyAdd(
+						XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(vertex.tex_coord)),
+						XMVectorReplicate(0.5f),
+						XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(instance.tex_coord))));
+				}
+				else {
+					out.tex = {
+						vertex.tex_coord[0] * instance.tex_scale[0],
+						vertex.tex_coord[1] * instance.tex_scale[1]
+					};
+				}
+				out.atlas = {
+					instance.tex_coord[0], instance.tex_coord[1],
+					instance.tex_scale[0], instance.tex_scale[1]
+				};
+
+				XMFLOAT3 world_normal;
+				XMStoreFloat3(&world_normal, XMVector3Normalize(XMVector4Transform(
+					XMVectorSet(vertex.normal[0], vertex.normal[1], vertex.normal[2], 0.0f),
+					world)));
+				position[0][k] = world_position.x;
+				position[1][k] = world_position.y;
+				position[2][k] = world_position.z;
+				normal[0][k] = world_normal.x;
+				normal[1][k] = world_normal.y;
+				normal[2][k] = world_normal.z;
+				for (size_t c = 0; c < 4; c++) {
+					color[c][k] = vertex.color[c];
+				}
+				// baked lighting of static tiles, see VertexShader.hlsl
+				const FLOAT exposure = 1.0f + instance.color.w;
+				ambient[0][k] = constants.ambientLight.x * exposure + instance.color.x;
+				ambient[1][k] = constants.ambientLight.y * exposure + instance.color.y;
+				ambient[2][k] = constants.ambientLight.z * exposure + instance.color.z;
+				ambient[3][k] = constants.ambientLight.w;
+			}
+
+			batch.count = lane_padded(count);
+			lights.evaluate(batch);
+
+			for (size_t k = 0; k < count; k++) {
+				const square_instance_t& instance = instances[(first + k) / base.size()];
+				shaded_vertex_t& out = vertices[first + k];
+				// if opacity nonzero we ignore lighting (used for lamps)
+				if (instance.color.w > 0.0f) {
+					out.color = instance.color;
+				}
+				else {
+					out.color = { lit[0][k], lit[1][k], lit[2][k], lit[3][k] };
+				}
+			}
+		}
+	});
+}
+
+/*
+ * Clips source triangle `index` at the near plane and sets up
+ * the one or two triangles that remain.
+ */
+void SoftwareRasterizer::setup_triangle(size_t index, const shaded_vertex_t* source) {
+	triangle_t& first = triangles[2 * index];
+	triangle_t& second = triangles[2 * index + 1];
+	first.min_x = second.min_x = 0;
+	first.max_x = second.max_x = -1;
+
+	const bool inside[3] = {
+		source[0].position.z >= 0.0f,
+		source[1].position.z >= 0.0f,
+		source[2].position.z >= 0.0f
+	};
+	if (inside[0] && inside[1] && inside[2]) {
+		const shaded_vertex_t* corners[3] = { &source[0], &source[1], &source[2] };
+		add_triangle(first, corners);
+		return;
+	}
+
+	// Sutherland-Hodgman against z >= 0, attributes interpolated in clip space
+	shaded_vertex_t clipped[4];
+	size_t count = 0;
+	for (size_t k = 0; k < 3; k++) {
+		const shaded_vertex_t& a = source[k];
+		const shaded_vertex_t& b = source[(k + 1) % 3];
+		const bool inside_b = inside[(k + 1) % 3];
+		if (inside[k]) {
+			clipped[count++] = a;
+		}
+		if (inside[k] != inside_b) {
+			const FLOAT t = a.position.z / (a.position.z - b.position.z);
+			shaded_vertex_t& cut = clipped[count++];
+			cut.atlas = a.atlas;
+			XMStoreFloat4(&cut.position, XMVectorLerp(
+				XMLoadFloat4(&a.position), XMLoadFloat4(&b.position), t));
+			XMStoreFloat4(&cut.color, XMVectorLerp(
+				XMLoadFloat4(&a.color), XMLoadFloat4(&b.color), t));
+			XMStoreFloat2(&cut.tex, XMVectorLerp(
+				XMLoadFloat2(&a.tex), XMLoadFloat2(&b.tex), t));
+		}
+	}
+	if (count >= 3) {
+		const shaded_vertex_t* corners[3] = { &clipped[0], &clipped[1], &clipped[2] };
+		add_triangle(first, corners);
+	}
+	if (count == 4) {
+		const shaded_vertex_t* corners[3] = { &clipped[0], &clipped[2], &clipped[3] };
+		add_triangle(second, corners);
+	}
+}
+
+/*
+ * Projects a clipped triangle to the viewport. Back faces, which wind
+ * counterclockwise on the screen, and triangles without area stay empty.
+ */
+void SoftwareRasterizer::add_triangle(triangle_t& triangle, const shaded_vertex_t* corners[3]) {
+	for (size_t k = 0; k < 3; k++) {
+		const shaded_vertex_t& corner = *corners[k];
+		if (!(corner.position.w > 0.0f)) {
+			return;
+		}
+		const FLOAT inv_w = 1.0f / corner.position.w;
+		const FLOAT screen_x = (corner.position.x * inv_w + 1.0f) * 0.5f * width;
+		const FLOAT screen_y = (1.0f - corner.position.y * inv_w) * 0.5f * height;
+		triangle.x[k] = static_cast<INT32>(std::lround(
+			std::clamp(screen_x, -GUARD_BAND, GUARD_BAND) * SUBPIXELS));
+		triangle.y[k] = static_cast<INT32>(std::lround(
+			std::clamp(screen_y, -GUARD_BAND, GUARD_BAND) * SUBPIXELS));
+		triangle.z[k] = corner.position.z * inv_w;
+		triangle.inv_w[k] = inv_w;
+
+		const FLOAT attributes[6] = {
+			corner.color.x, corner.color.y, corner.color.z, corner.color.w,
+			corner.tex.x, corner.tex.y
+		};
+		for (size_t a = 0; a < 6; a++) {
+			triangle.attributes[k][a] = attributes[a] * inv_w;
+		}
+	}
+	triangle.atlas[0] = corners[0]->atlas.x;
+	triangle.atlas[1] = corners[0]->atlas.y;
+	triangle.atlas[2] = corners[0]->atlas.z;
+	triangle.atlas[3] = corners[0]->atlas.w;
+
+	triangle.area = INT64(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0])
+		- INT64(triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+	if (triangle.area <= 0) {
+		return;
+	}
+	triangle.inv_area = static_cast<FLOAT>(1.0 / static_cast<double>(triangle.area));
+
+	// pixels whose centers may be covered
+	const auto [min_x, max_x] = std::minmax({ triangle.x[0], triangle.x[1], triangle.x[2] });
+	const auto [min_y, max_y] = std::minmax({ triangle.y[0], triangle.y[1], triangle.y[2] });
+	const INT32 half = SUBPIXELS / 2;
+	triangle.min_x = (std::max)((min_x - half + SUBPIXELS - 1) >> SUBPIXEL_BITS, 0);
+	triangle.min_y = (std::max)((min_y - half + SUBPIXELS - 1) >> SUBPIXEL_BITS, 0);
+	triangle.max_x = (std::min)((max_x - half) >> SUBPIXEL_BITS, INT32(width) - 1);
+	triangle.max_y = (std::min)((max_y - half) >> SUBPIXEL_BITS, INT32(height) - 1);
+	if (triangle.min_y > triangle.max_y) {
+		triangle.max_x = -1;
+	}
+}
+
+/*
+ * Lists the triangles overlapping every tile of a row of tiles,
+ * in submission order.
+ */
+void SoftwareRasterizer::bin_row(UINT row) {
+	const INT32 row_min_y = row * TILE_SIZE;
+	const INT32 row_max_y = row_min_y + TILE_SIZE - 1;
+	for (UINT column = 0; column < tiles_x; column++) {
+		bins[size_t(row) * tiles_x + column].clear();
+	}
+	for (size_t i = 0; i < triangles.size(); i++) {
+		const triangle_t& triangle = triangles[i];
+		if (triangle.max_x < triangle.min_x
+			|| triangle.max_y < row_min_y || triangle.min_y > row_max_y) {
+			continue;
+		}
+		const UINT last_column = triangle.max_x / TILE_SIZE;
+		for (UINT column = triangle.min_x / TILE_SIZE; column <= last_column; column++) {
+			bins[size_t(row) * tiles_x + column].push_back(static_cast<UINT32>(i));
+		}
+	}
+}
+
+void SoftwareRasterizer::rasterize_tile(UINT tile) {
+	const INT32 tile_x = (tile % tiles_x) * TILE_SIZE;
+	const INT32 tile_y = (tile / tiles_x) * TILE_SIZE;
+	const INT32 tile_max_x = (std::min)(tile_x + INT32(TILE_SIZE), INT32(width)) - 1;
+	const INT32 tile_max_y = (std::min)(tile_y + INT32(TILE_SIZE), INT32(height)) - 1;
+	for (UINT32 index : bins[tile]) {
+		const triangle_t& triangle = triangles[index];
+		shaded_pixels[tile] += rasterize_triangle(triangle,
+			(std::max)(triangle.min_x, tile_x), (std::max)(triangle.min_y, tile_y),
+			(std::min)(triangle.max_x, tile_max_x), (std::min)(triangle.max_y, tile_max_y));
+	}
+}
+
+/*
+ * Fills the pixels of a triangle within [x0, x1] x [y0, y1], four
+ * horizontal neighbours at a time. Edge functions are evaluated exactly
+ * at pixel centers, a center on an edge is covered if the edge is a top
+ * or a left edge. Depth is interpolated linearly on the screen, colors
+ * and texture coordinates with perspective correction, like Direct3D.
+ * Returns the number of pixels shaded.
+ */
+UINT64 SoftwareRasterizer::rasterize_triangle(const triangle_t& triangle,
+	INT32 x0, INT32 y0, INT32 x1, INT32 y1)
+{
+	if (x0 > x1 || y0 > y1) {
+		return 0;
+	}
+
+	// edge e is opposite of corner e: its value at a corner is the area
+	INT64 step_x[3];
+	INT64 step_y[3];
+	INT64 row_start[3];
+	INT64 bias[3];
+	const INT64 start_x = INT64(x0) * SUBPIXELS + SUBPIXELS / 2;
+	const INT64 start_y = INT64(y0) * SUBPIXELS + SUBPIXELS / 2;
+	for (size_t e = 0; e < 3; e++) {
+		const size_t a = (e + 1) % 3;
+		const size_t b = (e + 2) % 3;
+		const INT64 dx = INT64(triangle.x[b]) - triangle.x[a];
+		const INT64 dy = INT64(triangle.y[b]) - triangle.y[a];
+		step_x[e] = -dy * SUBPIXELS;
+		step_y[e] = dx * SUBPIXELS;
+		row_start[e] = dx * (start_y - triangle.y[a]) - dy * (start_x - triangle.x[a]);
+		// clockwise on the screen, left edges go up and top edges go right
+		const bool top_left = dy < 0 || (dy == 0 && dx > 0);
+		bias[e] = top_left ? 0 : -1;
+	}
+
+	UINT64 shaded = 0;
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+	const bool repeated = triangle.atlas[2] != 1.0f || triangle.atlas[3] != 1.0f;
+	for (INT32 y = y0; y <= y1; y++) {
+		INT64 edge[3] = { row_start[0], row_start[1], row_start[2] };
+		for (INT32 x = x0; x <= x1; x += LANES) {
+			// coverage and barycentric weights of the lanes
+			bool covered[LANES];
+			FLOAT weights[3][LANES];
+			bool any_covered = false;
+			for (UINT l = 0; l < LANES; l++) {
+				const INT64 e0 = edge[0] + step_x[0] * l;
+				const INT64 e1 = edge[1] + step_x[1] * l;
+				const INT64 e2 = edge[2] + step_x[2] * l;
+				covered[l] = x + INT32(l) <= x1
+					&& e0 + bias[0] >= 0 && e1 + bias[1] >= 0 && e2 + bias[2] >= 0;
+				any_covered |= covered[l];
+				weights[0][l] = static_cast<FLOAT>(e0);
+				weights[1][l] = static_cast<FLOAT>(e1);
+				weights[2][l] = static_cast<FLOAT>(e2);
+			}
+			for (size_t e = 0; e < 3; e++) {
+				edge[e] += step_x[e] * LANES;
+			}
+			if (!any_covered) {
+				continue;
+			}
+
+			const XMVECTOR b0 = XMVectorScale(load_lanes(weights[0]), triangle.inv_area);
+			const XMVECTOR b1 = XMVectorScale(load_lanes(weights[1]), triangle.inv_area);
+			const XMVECTOR b2 = XMVectorScale(load_lanes(weights[2]), triangle.inv_area);
+
+			// depth test
+			const size_t pixel = size_t(y) * width + x;
+			const XMVECTOR z = XMVectorAdd(XMVectorAdd(
+				XMVectorScale(b0, triangle.z[0]),
+				XMVectorScale(b1, triangle.z[1])),
+				XMVectorScale(b2, triangle.z[2]));
+			UINT32 closer[LANES];
+			XMStoreInt4(closer, XMVectorLess(z, load_lanes(&depths[pixel])));
+			bool any_visible = false;
+			for (UINT l = 0; l < LANES; l++) {
+				covered[l] = covered[l] && closer[l] != 0;
+				any_visible |= covered[l];
+			}
+			if (!any_visible) {
+				continue;
+			}
+
+			// perspective-correct attributes
+			const XMVECTOR b0_w = XMVectorScale(b0, triangle.inv_w[0]);
+			const XMVECTOR b1_w = XMVectorScale(b1, triangle.inv_w[1]);
+			const XMVECTOR b2_w = XMVectorScale(b2, triangle.inv_w[2]);
+			const XMVECTOR w = XMVectorDivide(one, XMVectorAdd(XMVectorAdd(b0_w, b1_w), b2_w));
+			FLOAT attributes[6][LANES];
+			for (size_t a = 0; a < 6; a++) {
+				store_lanes(attributes[a], XMVectorMultiply(XMVectorAdd(XMVectorAdd(
+					XMVectorScale(b0, triangle.attributes[0][a]),
+					XMVectorScale(b1, triangle.attributes[1][a])),
+					XMVectorScale(b2, triangle.attributes[2][a])), w));
+			}
+			FLOAT depth[LANES];
+			store_lanes(depth, z);
+
+			// pixel shader: color modulated by the nearest texel, wrapped
+			for (UINT l = 0; l < LANES; l++) {
+				if (!covered[l]) {
+					continue;
+				}
+				FLOAT u = attributes[4][l];
+				FLOAT v = attributes[5][l];
+				if (repeated) {
+					// a quarter of the atlas per tile
+					u = triangle.atlas[0] + 0.5f * (u - std::clamp(std::floor(u), 0.0f, triangle.atlas[2] - 1.0f));
+					v = triangle.atlas[1] + 0.5f * (v - std::clamp(std::floor(v), 0.0f, triangle.atlas[3] - 1.0f));
+				}
+				u -= std::floor(u);
+				v -= std::floor(v);
+				const UINT texel_x = (std::min)(static_cast<UINT>(u * texture_width), texture_width - 1);
+				const UINT texel_y = (std::min)(static_cast<UINT>(v * texture_height), texture_height - 1);
+				const UINT32 texel = texture[size_t(texel_y) * texture_width + texel_x];
+				FLOAT color[4];
+				for (UINT c = 0; c < 4; c++) {
+					color[c] = attributes[c][l] * ((texel >> (8 * c)) & 0xff) / 255.0f;
+				}
+				colors[pixel + l] = pack_color(color);
+				depths[pixel + l] = depth[l];
+				shaded++;
+			}
+		}
+		for (size_t e = 0; e < 3; e++) {
+			row_start[e] += step_y[e];
+		}
+	}
+	return shaded;
+}
\ No newline at end of file
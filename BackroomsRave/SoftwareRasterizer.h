@@ -0,0 +1,110 @@
+#ifndef SOFTWARE_RASTERIZER_H
+#define SOFTWARE_RASTERIZER_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <span>
+#include <vector>
+#include "JobSystem.h"
+#include "types.h"
+
+/*
+ * Reference renderer on the CPU, producing the frames of the Direct3D
+ * pipeline without a device: instanced triangle lists with the lighting
+ * of VertexShader.hlsl, the textured colors of PixelShader.hlsl, back
+ * face culling, clipping at the near plane and a LESS depth test.
+ *
+ * Triangles are set up in parallel, sorted into bins of screen tiles,
+ * and the tiles are rasterized in parallel, four pixels at a time.
+ * Coverage uses exact fixed-point edge functions with the top-left
+ * rule, and every tile draws its triangles in submission order, so
+ * the image does not depend on the number of threads.
+ */
+class SoftwareRasterizer {
+public:
+	static constexpr UINT TILE_SIZE = 64;
+
+	SoftwareRasterizer(UINT width, UINT height, JobSystem& jobs);
+
+	// RGBA texture with 8 bits per channel, sampled like sampler_ps:
+	// nearest texel, wrapped. The bits are copied.
+	void set_texture(UINT width, UINT height, const BYTE* bits);
+
+	// Clears the colors to `color` and the depth to 1.
+	void clear(const FLOAT color[4]);
+
+	// Draws the triangle list `base` once per instance, like DrawInstanced.
+	void draw(const vs_const_buffer_t& constants,
+		std::span<const vertex_t> base, std::span<const square_instance_t> instances);
+
+	UINT get_width() const;
+	UINT get_height() const;
+
+	// Pixels that passed the depth test and were shaded since the last
+	// clear, over the pixels of the image: 1 without any overdraw.
+	double get_overdraw() const;
+
+	// RGBA with 8 bits per channel, red in the lowest byte, top row first.
+	std::span<const UINT32> get_pixels() const;
+
+	// Writes the colors as a binary PPM image.
+	bool write_ppm(PCWSTR path) const;
+
+private:
+	// Output of the vertex shader
+	struct shaded_vertex_t {
+		DirectX::XMFLOAT4 position;
+		DirectX::XMFLOAT4 color;
+		DirectX::XMFLOAT2 tex;      // in the atlas, in tiles if tex_scale is not 1
+		DirectX::XMFLOAT4 atlas;    // texture in the atlas, tex_scale
+	};
+
+	// Triangle in 24.8 fixed-point pixel coordinates with its
+	// attributes divided by w for perspective-correct interpolation.
+	// Empty when `max_x` < `min_x`.
+	struct triangle_t {
+		INT32 x[3];
+		INT32 y[3];
+		INT64 area;
+		FLOAT inv_area;
+		FLOAT z[3];
+		FLOAT inv_w[3];
+		FLOAT attributes[3][6];     // color, tex
+		FLOAT atlas[4];
+		INT32 min_x;
+		INT32 min_y;
+		INT32 max_x;
+		INT32 max_y;
+	};
+
+	void shade_vertices(const vs_const_buffer_t& constants,
+		std::span<const vertex_t> base, std::span<const square_instance_t> instances);
+	void setup_triangle(size_t index, const shaded_vertex_t* vertices);
+	void add_triangle(triangle_t& triangle, const shaded_vertex_t* vertices[3]);
+	void bin_row(UINT row);
+	void rasterize_tile(UINT tile);
+	UINT64 rasterize_triangle(const triangle_t& triangle,
+		INT32 x0, INT32 y0, INT32 x1, INT32 y1);
+
+	UINT width;
+	UINT height;
+	UINT tiles_x;
+	UINT tiles_y;
+	JobSystem& jobs;
+
+	// padded by a lane so four depths can be loaded from any pixel
+	std::vector<UINT32> colors;
+	std::vector<FLOAT> depths;
+
+	UINT texture_width = 1;
+	UINT texture_height = 1;
+	std::vector<UINT32> texture = { 0xffffffff };
+
+	// Work of the current draw, reused by the next ones
+	std::vector<shaded_vertex_t> vertices;
+	std::vector<triangle_t> triangles;      // two per source triangle
+	std::vector<std::vector<UINT32>> bins;  // triangle indices per tile
+	std::vector<UINT64> shaded_pixels;      // per tile, since the last clear
+};
+
+#endif // SOFTWARE_RASTERIZER_H
\ No newline at end of file
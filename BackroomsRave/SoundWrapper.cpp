@@ -1,13 +1,82 @@
 #include "SoundWrapper.h"
 
-#include <mmsystem.h>
+#include <algorithm>
 
 #pragma comment(lib, "winmm.lib")
 
-SoundWrapper::SoundWrapper(PCWSTR path) {
-	PlaySound(path, nullptr, SND_FILENAME | SND_ASYNC | SND_LOOP);
+SoundWrapper::SoundWrapper(AudioMixer& mixer) : mixer(mixer) {
+	WAVEFORMATEX format = {
+		.wFormatTag = WAVE_FORMAT_PCM,
+		.nChannels = 2,
+		.nSamplesPerSec = mixer.get_sample_rate(),
+		.nAvgBytesPerSec = static_cast<DWORD>(
+			mixer.get_sample_rate() * 2 * sizeof(SHORT)),
+		.nBlockAlign = 2 * sizeof(SHORT),
+		.wBitsPerSample = 8 * sizeof(SHORT),
+		.cbSize = 0
+	};
+
+	buffer_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (buffer_event == nullptr || waveOutOpen(&wave_out, WAVE_MAPPER, &format,
+		reinterpret_cast<DWORD_PTR>(buffer_event), 0,
+		CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+		// no event or no audio device, run silently
+		wave_out = nullptr;
+		return;
+	}
+
+	mix_buffer.resize(2 * BUFFER_FRAMES);
+	for (size_t i = 0; i < BUFFER_COUNT; i++) {
+		buffers[i].resize(2 * BUFFER_FRAMES);
+		headers[i].lpData = reinterpret_cast<LPSTR>(buffers[i].data());
+		headers[i].dwBufferLength =
+			static_cast<DWORD>(buffers[i].size() * sizeof(SHORT));
+		waveOutPrepareHeader(wave_out, &headers[i], sizeof(WAVEHDR));
+	}
+
+	running = true;
+	thread = std::thread(&SoundWrapper::stream, this);
 }
 
 SoundWrapper::~SoundWrapper() {
-	PlaySound(nullptr, nullptr, 0);
-}
\ No newline at end of file
+	if (wave_out != nullptr) {
+		running = false;
+		SetEvent(buffer_event);
+		thread.join();
+
+		waveOutReset(wave_out);
+		for (auto& header : headers) {
+			waveOutUnprepareHeader(wave_out, &header, sizeof(WAVEHDR));
+		}
+		waveOutClose(wave_out);
+	}
+	if (buffer_event != nullptr) {
+		CloseHandle(buffer_event);
+	}
+}
+
+/*
+ * Keeps all buffers queued, refilling each one as soon as
+ * the device is done playing it.
+ */
+void SoundWrapper::stream() {
+	for (size_t i = 0; i < BUFFER_COUNT; i++) {
+		submit(i);
+	}
+	while (running) {
+		WaitForSingleObject(buffer_event, INFINITE);
+		for (size_t i = 0; i < BUFFER_COUNT && running; i++) {
+			if (headers[i].dwFlags & WHDR_DONE) {
+				submit(i);
+			}
+		}
+	}
+}
+
+void SoundWrapper::submit(size_t buffer) {
+	mixer.render(mix_buffer.data(), BUFFER_FRAMES);
+	std::transform(mix_buffer.begin(), mix_buffer.end(), buffers[buffer].begin(),
+		[](FLOAT sample) { return static_cast<SHORT>(sample * 32767.0f); });
+	headers[buffer].dwFlags &= ~WHDR_DONE;
+	waveOutWrite(wave_out, &headers[buffer], sizeof(WAVEHDR));
+}
@@ -2,15 +2,37 @@
 #define SOUND_WRAPPER_H
 
 #include <Windows.h>
+#include <mmsystem.h>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "AudioMixer.h"
 
 /*
- * Wrapper for PlaySound function.
+ * Streams the output of an AudioMixer to the default waveOut device.
  * Plays sound on construction and stops it on destruction.
  */
 class SoundWrapper {
 public:
-	SoundWrapper(PCWSTR path);
+	SoundWrapper(AudioMixer& mixer);
 	~SoundWrapper();
+
+private:
+	void stream();
+	void submit(size_t buffer);
+
+	static constexpr size_t BUFFER_COUNT = 3;
+	static constexpr size_t BUFFER_FRAMES = 4 * AudioMixer::BLOCK_SIZE;
+
+	AudioMixer& mixer;
+	HWAVEOUT wave_out = nullptr;
+	HANDLE buffer_event = nullptr;
+	std::array<WAVEHDR, BUFFER_COUNT> headers = {};
+	std::array<std::vector<SHORT>, BUFFER_COUNT> buffers;
+	std::vector<FLOAT> mix_buffer;
+	std::atomic<bool> running = false;
+	std::thread thread;
 };
 
-#endif // SOUND_WRAPPER_H
\ No newline at end of file
+#endif // SOUND_WRAPPER_H
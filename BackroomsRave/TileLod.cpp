@@ -0,0 +1,218 @@
+#include "TileLod.h"
+
+#include <algorithm>
+#include <cmath>
+#include "simd.h"
+
+using namespace DirectX;
+
+namespace {
+	/*
+	 * Node of the quadtree while it is built: a tile, or a block
+	 * of `size` by `size` tiles from column `i` and row `j`.
+	 */
+	struct build_node_t {
+		UINT32 children[4];
+		UINT32 rectangle;
+		UINT32 i;
+		UINT32 j;
+		UINT32 size;
+		XMFLOAT4 color;
+		bool has_parent;
+	};
+}
+
+/*
+ * Every level of a rectangle is a grid of blocks, column by column like
+ * the tiles, with half the columns and rows of the level below. Nodes are
+ * then laid out breadth first, so the children of a node are consecutive.
+ */
+TileLod::TileLod(std::span<const rectangle_desc_t> rectangles,
+	std::span<const square_instance_t> tiles) :
+	tile_count(tiles.size())
+{
+	std::vector<build_node_t> nodes;
+	std::vector<size_t> offsets(rectangles.size() + 1, 0);
+	std::vector<size_t> rows(rectangles.size());
+	std::vector<UINT32> below;
+	std::vector<UINT32> above;
+	for (size_t r = 0; r < rectangles.size(); r++) {
+		const auto [tiles_x, tiles_y] = AxisRectangle::tile_grid(rectangles[r]);
+		offsets[r + 1] = offsets[r] + tiles_x * tiles_y;
+		rows[r] = tiles_y;
+		if (offsets[r + 1] > tiles.size()) {
+			throw "Tiles do not match the rectangles";
+		}
+
+		below.resize(tiles_x * tiles_y);
+		for (size_t i = 0; i < tiles_x; i++) {
+			for (size_t j = 0; j < tiles_y; j++) {
+				below[i * tiles_y + j] = static_cast<UINT32>(nodes.size());
+				nodes.push_back({ { NO_CHILDREN, NO_CHILDREN, NO_CHILDREN, NO_CHILDREN },
+					static_cast<UINT32>(r), static_cast<UINT32>(i), static_cast<UINT32>(j), 1,
+					tiles[offsets[r] + i * tiles_y + j].color, false });
+			}
+		}
+		size_t columns = tiles_x;
+		size_t level_rows = tiles_y;
+		for (UINT32 size = 2; columns >= 2 && level_rows >= 2; size *= 2) {
+			above.resize((columns / 2) * (level_rows / 2));
+			for (size_t i = 0; i < columns / 2; i++) {
+				for (size_t j = 0; j < level_rows / 2; j++) {
+					build_node_t node = { {
+							below[(2 * i) * level_rows + 2 * j],
+							below[(2 * i + 1) * level_rows + 2 * j],
+							below[(2 * i) * level_rows + 2 * j + 1],
+							below[(2 * i + 1) * level_rows + 2 * j + 1]
+						}, static_cast<UINT32>(r), static_cast<UINT32>(i * size),
+						static_cast<UINT32>(j * size), size, {}, false };
+					XMVECTOR color = XMVectorZero();
+					for (UINT32 child : node.children) {
+						nodes[child].has_parent = true;
+						color = XMVectorAdd(color, XMLoadFloat4(&nodes[child].color));
+					}
+					XMStoreFloat4(&node.color, XMVectorScale(color, 0.25f));
+					above[i * (level_rows / 2) + j] = static_cast<UINT32>(nodes.size());
+					nodes.push_back(node);
+				}
+			}
+			below.swap(above);
+			columns /= 2;
+			level_rows /= 2;
+		}
+	}
+
+	// build node of every node, padding lanes of the roots have none
+	std::vector<UINT32> order;
+	order.reserve(lane_padded(nodes.size()));
+	for (UINT32 n = 0; n < nodes.size(); n++) {
+		if (!nodes[n].has_parent) {
+			order.push_back(n);
+		}
+	}
+	root_count = order.size();
+	order.resize(lane_padded(root_count), NO_CHILDREN);
+	first_child.reserve(order.capacity());
+	for (size_t k = 0; k < order.size(); k++) {
+		if (order[k] == NO_CHILDREN || nodes[order[k]].children[0] == NO_CHILDREN) {
+			first_child.push_back(NO_CHILDREN);
+			continue;
+		}
+		first_child.push_back(static_cast<UINT32>(order.size()));
+		order.insert(order.end(), std::begin(nodes[order[k]].children), std::end(nodes[order[k]].children));
+	}
+
+	for (std::vector<FLOAT>& axis : center) {
+		axis.resize(order.size(), 0.0f);
+	}
+	radius.resize(order.size(), 0.0f);
+	extent.resize(order.size(), 0.0f);
+	instances.resize(order.size(), {});
+	for (size_t k = 0; k < order.size(); k++) {
+		if (order[k] == NO_CHILDREN) {
+			continue;
+		}
+		const build_node_t& node = nodes[order[k]];
+		const rectangle_desc_t& desc = rectangles[node.rectangle];
+		square_instance_t& instance = instances[k];
+		if (node.size == 1) {
+			instance = tiles[offsets[node.rectangle] + node.i * rows[node.rectangle] + node.j];
+		}
+		else {
+			instance = AxisRectangle::block_tile(desc, node.i, node.j, node.size,
+				AxisRectangle::T_JUNCTION_OVERLAP);
+			instance.color = node.color;
+		}
+		center[0][k] = instance.world._41;
+		center[1][k] = instance.world._42;
+		center[2][k] = instance.world._43;
+		extent[k] = node.size * desc.tile_size;
+		radius[k] = extent[k] * std::sqrt(0.5f);
+	}
+
+	split.assign(order.size(), 0);
+	selection.reserve(tile_count);
+	// a group pushes at most four more
+	stack.reserve(order.size() / 4 + 1);
+}
+
+size_t TileLod::get_tile_count() const {
+	return tile_count;
+}
+
+size_t TileLod::get_node_count() const {
+	return instances.size() - (lane_padded(root_count) - root_count);
+}
+
+/*
+ * The tree is walked depth first with a stack of sibling groups. The
+ * projected size of a node is measured from the nearest point of its
+ * bounding sphere, so a node never looks smaller than any of its tiles.
+ */
+bool TileLod::select(const XMFLOAT3& eye, FLOAT focal, std::vector<square_instance_t>& out) {
+	const XMVECTOR position = XMLoadFloat3(&eye);
+	if (has_selection && XMVectorGetX(XMVector3LengthSq(
+		XMVectorSubtract(position, XMLoadFloat3(&last_eye)))) < MOVE_EPSILON * MOVE_EPSILON)
+	{
+		return false;
+	}
+	bool changed = !has_selection;
+	has_selection = true;
+	last_eye = eye;
+
+	const XMVECTOR eye_x = XMVectorReplicate(eye.x);
+	const XMVECTOR eye_y = XMVectorReplicate(eye.y);
+	const XMVECTOR eye_z = XMVectorReplicate(eye.z);
+	const XMVECTOR near_distance = XMVectorReplicate(NEAR_DISTANCE);
+	const size_t root_lanes = lane_padded(root_count);
+	selection.clear();
+	stack.clear();
+	for (size_t g = root_lanes; g > 0; g -= 4) {
+		stack.push_back(static_cast<UINT32>(g - 4));
+	}
+	while (!stack.empty()) {
+		const UINT32 group = stack.back();
+		stack.pop_back();
+		const XMVECTOR dx = XMVectorSubtract(load_lane(center[0], group), eye_x);
+		const XMVECTOR dy = XMVectorSubtract(load_lane(center[1], group), eye_y);
+		const XMVECTOR dz = XMVectorSubtract(load_lane(center[2], group), eye_z);
+		const XMVECTOR distance = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx,
+			XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+		const XMVECTOR nearest = XMVectorMax(
+			XMVectorSubtract(distance, load_lane(radius, group)), near_distance);
+		XMFLOAT4 sizes;
+		XMStoreFloat4(&sizes, XMVectorDivide(
+			XMVectorScale(load_lane(extent, group), focal), nearest));
+		const FLOAT projected[4] = { sizes.x, sizes.y, sizes.z, sizes.w };
+
+		for (UINT32 k = 0; k < 4; k++) {
+			const UINT32 n = group + k;
+			if (n >= root_count && n < root_lanes) {
+				continue;
+			}
+			if (first_child[n] == NO_CHILDREN) {
+				selection.push_back(n);
+				continue;
+			}
+			const bool split_now = projected[k] > (split[n] ? MERGE_PIXELS : SPLIT_PIXELS);
+			if (split_now != (split[n] != 0)) {
+				split[n] = split_now;
+				changed = true;
+			}
+			if (split_now) {
+				stack.push_back(first_child[n]);
+			}
+			else {
+				selection.push_back(n);
+			}
+		}
+	}
+	if (!changed) {
+		return false;
+	}
+	out.resize(selection.size());
+	for (size_t i = 0; i < selection.size(); i++) {
+		out[i] = instances[selection[i]];
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef TILE_LOD_H
+#define TILE_LOD_H
+
+#include <DirectXMath.h>
+#include <Windows.h>
+#include <span>
+#include <vector>
+#include "Rectangle.h"
+#include "types.h"
+
+/*
+ * Distance-based level of detail of the uniform static tiles.
+ *
+ * Over the tiles of every rectangle there is a quadtree of square blocks
+ * of 2x2, 4x4, ... tiles, built once. A block exists where its four
+ * children do, so blocks never stick out of their rectangle. A block has
+ * the average color of its tiles, baked lighting included, and reaches
+ * T_JUNCTION_OVERLAP of its size over its neighbours, which may be finer.
+ *
+ * Every frame the quadtree is walked from its roots and a node is drawn
+ * instead of its children while its projected size, its size over its
+ * distance from the camera, stays below SPLIT_PIXELS. Nodes already split
+ * merge again only below MERGE_PIXELS, so nodes near the threshold do not
+ * pop back and forth. The four children of a node are stored next to each
+ * other and sized as one SIMD batch.
+ *
+ * The selection depends on the position of the camera only: turning does
+ * not change it, and a camera that moved less than MOVE_EPSILON keeps it
+ * without walking the tree.
+ */
+class TileLod {
+public:
+	static constexpr FLOAT SPLIT_PIXELS = 96.0f;
+	static constexpr FLOAT MERGE_PIXELS = 80.0f;
+	static constexpr FLOAT MOVE_EPSILON = 1.0f / 1024.0f;
+	// nodes nearer than this are sized as if they were this far
+	static constexpr FLOAT NEAR_DISTANCE = 0.5f;
+
+	// Takes the tiles of `rectangles` in the order of
+	// Scene::build_static_instances.
+	TileLod(std::span<const rectangle_desc_t> rectangles,
+		std::span<const square_instance_t> tiles);
+
+	// Selects the nodes to draw for a camera at `eye`, `focal` pixels per
+	// unit of size at a distance of 1. Replaces `out` with their instances
+	// and returns true if they differ from the last selection, leaves it
+	// otherwise. Does not allocate once `out` has room for every tile.
+	bool select(const DirectX::XMFLOAT3& eye, FLOAT focal,
+		std::vector<square_instance_t>& out);
+
+	size_t get_tile_count() const;
+	size_t get_node_count() const;
+
+private:
+	static constexpr UINT32 NO_CHILDREN = UINT32_MAX;
+
+	// nodes, structure of arrays, children of a node are
+	// first_child[n] to first_child[n] + 3
+	std::vector<FLOAT> center[3];
+	std::vector<FLOAT> radius;      // of the bounding sphere
+	std::vector<FLOAT> extent;      // length of a side
+	std::vector<UINT32> first_child;
+	std::vector<square_instance_t> instances;
+	// roots come first, padded to a whole number of lanes
+	size_t root_count = 0;
+	size_t tile_count = 0;
+
+	// nodes split in the last selection they were reached in
+	std::vector<UINT8> split;
+	std::vector<UINT32> selection;
+	std::vector<UINT32> stack;
+	DirectX::XMFLOAT3 last_eye = {};
+	bool has_selection = false;
+};
+
+#endif // TILE_LOD_H
\ No newline at end of file
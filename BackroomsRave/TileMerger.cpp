@@ -0,0 +1,160 @@
+#include "TileMerger.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+
+using namespace DirectX;
+
+namespace {
+	// planes and offsets of grids closer than 1 / PHASE_STEPS of a tile
+	// are the same, world matrices of rotated tiles are not exact
+	constexpr FLOAT PHASE_STEPS = 1024.0f;
+	constexpr UINT32 EMPTY = UINT32_MAX;
+
+	/*
+	 * What tiles merged together share: texture coordinates, color,
+	 * the rows of the world matrix but the translation, the plane
+	 * and the offset of the grid along both planar axes.
+	 */
+	using group_key_t = std::array<FLOAT, 18>;
+
+	struct cell_t {
+		UINT32 group;
+		INT32 u;
+		INT32 v;
+		UINT32 tile;
+	};
+
+	/*
+	 * Position of `p` along `axis` in lengths of `axis`.
+	 */
+	FLOAT along(const XMFLOAT4X4& world, int axis, FXMVECTOR p) {
+		const XMVECTOR a = XMVectorSet(world.m[axis][0], world.m[axis][1], world.m[axis][2], 0.0f);
+		return XMVectorGetX(XMVector3Dot(p, a)) / XMVectorGetX(XMVector3LengthSq(a));
+	}
+
+	/*
+	 * Tile `tile` stretched over w by h cells, from its own cell
+	 * towards the positive planar axes.
+	 */
+	square_instance_t stretch(const square_instance_t& tile, INT32 w, INT32 h) {
+		const XMMATRIX world = XMLoadFloat4x4(&tile.world);
+		XMMATRIX quad = world;
+		quad.r[0] = XMVectorScale(world.r[0], static_cast<FLOAT>(w));
+		quad.r[1] = XMVectorScale(world.r[1], static_cast<FLOAT>(h));
+		quad.r[3] = XMVectorAdd(world.r[3], XMVectorAdd(
+			XMVectorScale(world.r[0], static_cast<FLOAT>(w - 1)),
+			XMVectorScale(world.r[1], static_cast<FLOAT>(h - 1))));
+
+		square_instance_t result = tile;
+		XMStoreFloat4x4(&result.world, quad);
+		result.tex_scale[0] = tile.tex_scale[0] * w;
+		result.tex_scale[1] = tile.tex_scale[1] * h;
+		return result;
+	}
+}
+
+/*
+ * The world matrix of a tile maps the base square, from -1 to 1, so
+ * neighbouring tiles are 2 lengths of a planar axis apart.
+ */
+std::vector<square_instance_t> merge_tiles(std::span<const square_instance_t> tiles) {
+	std::vector<square_instance_t> quads;
+	std::map<group_key_t, UINT32> groups;
+	std::vector<cell_t> cells;
+	cells.reserve(tiles.size());
+	group_key_t last_key = {};
+	UINT32 group = 0;
+	for (size_t i = 0; i < tiles.size(); i++) {
+		const square_instance_t& tile = tiles[i];
+		const XMFLOAT4X4& world = tile.world;
+		const XMVECTOR p = XMVectorSet(world._41, world._42, world._43, 0.0f);
+		if (XMVector3Equal(XMVector3Cross(
+			XMVectorSet(world._11, world._12, world._13, 0.0f),
+			XMVectorSet(world._21, world._22, world._23, 0.0f)), XMVectorZero()))
+		{
+			// a flat tile has no plane to merge in
+			quads.push_back(tile);
+			continue;
+		}
+
+		// cells start half a phase step early, so a grid offset
+		// does not round to a whole cell
+		const FLOAT u = along(world, 0, p) / 2.0f;
+		const FLOAT v = along(world, 1, p) / 2.0f;
+		const FLOAT u_cell = std::floor(u + 0.5f / PHASE_STEPS);
+		const FLOAT v_cell = std::floor(v + 0.5f / PHASE_STEPS);
+		const group_key_t key = {
+			tile.tex_coord[0], tile.tex_coord[1],
+			tile.color.x, tile.color.y, tile.color.z, tile.color.w,
+			world._11, world._12, world._13,
+			world._21, world._22, world._23,
+			world._31, world._32, world._33,
+			std::round(along(world, 2, p) * PHASE_STEPS),
+			std::round((u - u_cell) * PHASE_STEPS),
+			std::round((v - v_cell) * PHASE_STEPS)
+		};
+		// tiles of a rectangle come in a row and share a group
+		if (groups.empty() || key != last_key) {
+			group = groups.try_emplace(key, static_cast<UINT32>(groups.size())).first->second;
+			last_key = key;
+		}
+		cells.push_back({ group,
+			static_cast<INT32>(u_cell), static_cast<INT32>(v_cell),
+			static_cast<UINT32>(i) });
+	}
+	std::sort(cells.begin(), cells.end(), [](const cell_t& a, const cell_t& b) {
+		if (a.group != b.group) {
+			return a.group < b.group;
+		}
+		return a.v != b.v ? a.v < b.v : a.u < b.u;
+	});
+
+	std::vector<UINT32> grid;
+	for (size_t first = 0; first < cells.size();) {
+		size_t last = first;
+		INT32 u_min = cells[first].u;
+		INT32 u_max = cells[first].u;
+		while (last < cells.size() && cells[last].group == cells[first].group) {
+			u_min = (std::min)(u_min, cells[last].u);
+			u_max = (std::max)(u_max, cells[last].u);
+			last++;
+		}
+		const INT32 v_min = cells[first].v;
+		const size_t width = static_cast<size_t>(u_max - u_min) + 1;
+		const size_t height = static_cast<size_t>(cells[last - 1].v - v_min) + 1;
+		grid.assign(width * height, EMPTY);
+		for (size_t c = first; c < last; c++) {
+			grid[(cells[c].v - v_min) * width + (cells[c].u - u_min)] = cells[c].tile;
+		}
+
+		// cells are emptied once covered by a quad
+		for (size_t y = 0; y < height; y++) {
+			for (size_t x = 0; x < width; x++) {
+				const UINT32 corner = grid[y * width + x];
+				if (corner == EMPTY) {
+					continue;
+				}
+				size_t w = 1;
+				while (x + w < width && grid[y * width + x + w] != EMPTY) {
+					w++;
+				}
+				size_t h = 1;
+				while (y + h < height && std::none_of(grid.begin() + (y + h) * width + x,
+					grid.begin() + (y + h) * width + x + w, [](UINT32 t) { return t == EMPTY; }))
+				{
+					h++;
+				}
+				for (size_t row = y; row < y + h; row++) {
+					std::fill_n(grid.begin() + row * width + x, w, EMPTY);
+				}
+				quads.push_back(stretch(tiles[corner], static_cast<INT32>(w), static_cast<INT32>(h)));
+			}
+		}
+		first = last;
+	}
+	return quads;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef TILE_MERGER_H
+#define TILE_MERGER_H
+
+#include <span>
+#include <vector>
+#include "types.h"
+
+/*
+ * Greedy meshing of square tiles into as few large quads as it finds.
+ *
+ * Tiles are merged when they differ only by their position in a common
+ * plane: the same orientation, size, texture and color, on the same grid.
+ * Tiles of adjacent rectangles in one plane are merged as well. Every
+ * such group is laid out on a grid of cells, and quads are grown from
+ * the first free cell, row by row, as wide and then as tall as the
+ * free cells allow.
+ *
+ * A quad covering w by h tiles has the world matrix of its corner tile
+ * with its planar axes scaled by w and h, and a texture scale of
+ * (w, h), so a shader repeating the texture of the instance draws it
+ * like the tiles. Tiles covering the same cell are drawn once.
+ */
+std::vector<square_instance_t> merge_tiles(std::span<const square_instance_t> tiles);
+
+#endif // TILE_MERGER_H
\ No newline at end of file
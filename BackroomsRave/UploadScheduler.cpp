@@ -0,0 +1,82 @@
+#include "UploadScheduler.h"
+
+UploadScheduler::UploadScheduler(BYTE* staging, UINT64 capacity, UINT64 frame_budget,
+	UploadQueue& queue, FrameFence& fence) :
+	staging(staging),
+	ring(capacity, fence),
+	frame_budget(frame_budget),
+	queue(queue),
+	fence(fence)
+{}
+
+UINT64 UploadScheduler::enqueue(upload_t upload) {
+	pending_bytes += upload.size;
+	pending.push_back(std::move(upload));
+	return ++last_ticket;
+}
+
+void UploadScheduler::flush() {
+	ring.begin_frame();
+
+	UINT64 batch_bytes = 0;
+	bool batch_open = false;
+	while (!pending.empty()) {
+		upload_t& upload = pending.front();
+		// the first upload of a batch may exceed the budget on its own
+		if (batch_bytes > 0 && batch_bytes + upload.size > frame_budget) {
+			break;
+		}
+		UINT64 offset;
+		if (!ring.try_allocate(upload.size, upload.alignment, offset)) {
+			break;      // staging ring is full until older batches finish
+		}
+		if (!batch_open) {
+			queue.begin_batch();
+			batch_open = true;
+		}
+		upload.write(staging + offset);
+		upload.record(offset);
+
+		batch_bytes += upload.size;
+		pending_bytes -= upload.size;
+		pending.pop_front();
+		submitted_ticket++;
+	}
+
+	if (batch_open) {
+		const UINT64 fence_value = queue.submit_batch();
+		ring.end_frame(fence_value);
+		batches.push_back({ submitted_ticket, fence_value });
+	}
+}
+
+void UploadScheduler::finish() {
+	while (!pending.empty() || !batches.empty()) {
+		flush();
+		if (!batches.empty()) {
+			fence.wait_for_value(batches.back().fence_value);
+		}
+		retire();
+	}
+}
+
+bool UploadScheduler::is_complete(UINT64 ticket) {
+	retire();
+	return ticket <= completed_ticket;
+}
+
+void UploadScheduler::retire() {
+	const UINT64 completed_value = fence.get_completed_value();
+	while (!batches.empty() && batches.front().fence_value <= completed_value) {
+		completed_ticket = batches.front().last_ticket;
+		batches.pop_front();
+	}
+}
+
+size_t UploadScheduler::get_pending_count() const {
+	return pending.size();
+}
+
+UINT64 UploadScheduler::get_pending_bytes() const {
+	return pending_bytes;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <Windows.h>
+#include <deque>
+#include <functional>
+#include "FrameRing.h"
+
+/*
+ * GPU side of the upload scheduler: records copies out of
+ * the staging buffer and submits them in batches.
+ */
+class UploadQueue {
+public:
+	virtual ~UploadQueue() = default;
+	virtual void begin_batch() = 0;
+	// Submits the copies recorded since begin_batch and returns
+	// the fence value that is reached when they are done.
+	virtual UINT64 submit_batch() = 0;
+};
+
+/*
+ * A single buffer or texture upload.
+ */
+struct upload_t {
+	UINT64 size;
+	UINT64 alignment;
+	// fills the staging memory of the upload
+	std::function<void(BYTE* staging)> write;
+	// records the copy from `staging_offset` of the staging buffer
+	std::function<void(UINT64 staging_offset)> record;
+};
+
+/*
+ * Streams uploads through a persistent staging ring.
+ *
+ * Uploads are queued and written out by flush, which puts as many of
+ * them as fit in the staging ring and the per-frame byte budget into
+ * one batch. Staging space of a batch is reused once the fence passes
+ * the batch, so flush never waits for the GPU.
+ */
+class UploadScheduler {
+public:
+	UploadScheduler(BYTE* staging, UINT64 capacity, UINT64 frame_budget,
+		UploadQueue& queue, FrameFence& fence);
+
+	// Returns a ticket to check for completion of the upload.
+	UINT64 enqueue(upload_t upload);
+	// Submits the next batch of uploads, meant to run once per frame.
+	void flush();
+	// Submits all uploads and waits until they are done.
+	void finish();
+	bool is_complete(UINT64 ticket);
+
+	size_t get_pending_count() const;
+	UINT64 get_pending_bytes() const;
+
+private:
+	void retire();
+
+	struct batch_t {
+		UINT64 last_ticket;
+		UINT64 fence_value;
+	};
+
+	BYTE* staging;
+	FrameRing ring;
+	UINT64 frame_budget;
+	UploadQueue& queue;
+	FrameFence& fence;
+
+	std::deque<upload_t> pending;
+	UINT64 pending_bytes = 0;
+	std::deque<batch_t> batches;        // submitted, not yet complete
+
+	// tickets are handed out in order, 0 is always complete
+	UINT64 last_ticket = 0;
+	UINT64 submitted_ticket = 0;
+	UINT64 completed_ticket = 0;
+};
+
+#endif // UPLOAD_SCHEDULER_H
\ No newline at end of file
@@ -15,27 +15,33 @@ struct vs_output_t
     float4 position : SV_POSITION;
     float4 color : COLOR;
     float2 tex : TEXCOORD;
+    // texture of the instance in the atlas, tiles across the instance
+    nointerpolation float4 atlas : TEXCOORD1;
 };
 
 vs_output_t main(
     float3 pos : POSITION, float4 col : COLOR, float2 tex : TEXCOORD, float3 normal : NORMAL,
     float2 inst_tex : INSTANCE_TEXCOORD, float4 inst_col : INSTANCE_COLOR, row_major float4x4 mat_w : WORLD,
-    uint instance_id : SV_InstanceID
+    float2 inst_tex_scale : INSTANCE_TEXSCALE, uint instance_id : SV_InstanceID
 )
 {
     vs_output_t result;
     pos = mul(float4(pos, 1.0f), mat_w).xyz;
     result.position = mul(float4(pos, 1.0f), matViewProj);
+    result.tex = tex * inst_tex_scale;
+    result.atlas = float4(inst_tex, inst_tex_scale);
     // if opacity nonzero we ignore lighting (used for lamps)
     if (inst_col.a > 0.0f) {
         result.color = inst_col;
-        result.tex = inst_tex + tex * 0.5f;
         return result;
     }
     
     normal = mul(float4(normal, 0.0f), mat_w).xyz;
     normal = normalize(normal);
-    result.color = ambientLight * col;
+    // static tiles carry baked lighting in their color: bounce light
+    // in rgb, the occluded part of the ambient light as negative alpha
+    float4 ambient = ambientLight * float4((1.0f + inst_col.a).xxx, 1.0f);
+    result.color = (ambient + float4(inst_col.rgb, 0.0f)) * col;
     
     for (uint i = 0; i < 7; i++) {
         float4 dirLight = float4(pos, 0.0f) - pointLight[i];
@@ -55,6 +61,5 @@ vs_output_t main(
     }
 
     result.color = saturate(result.color);
-    result.tex = inst_tex + tex * 0.5f;
     return result;
 }
@@ -0,0 +1,56 @@
+cbuffer vs_const_buffer_t
+{
+    float4x4 matViewProj;
+    float4x4 matView;
+    float4 colMaterial;
+    float4 colLight[7];
+    float4 pointLight[7];
+    float4 ambientLight;
+    float4 padding;
+};
+
+
+struct vs_output_t
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float4 material : COLOR1;
+    float2 tex : TEXCOORD;
+    nointerpolation float4 atlas : TEXCOORD1;
+    float3 world_pos : POSITION;
+    float3 normal : NORMAL;
+    nointerpolation float lit : LIT;
+};
+
+/*
+ * Vertex shader of the per-pixel lighting, for instances merged into
+ * large quads: the point lights are left to the pixel shader. The
+ * texture is repeated like in PixelShader.hlsl.
+ */
+vs_output_t main(
+    float3 pos : POSITION, float4 col : COLOR, float2 tex : TEXCOORD, float3 normal : NORMAL,
+    float2 inst_tex : INSTANCE_TEXCOORD, float4 inst_col : INSTANCE_COLOR, row_major float4x4 mat_w : WORLD,
+    float2 inst_tex_scale : INSTANCE_TEXSCALE
+)
+{
+    vs_output_t result;
+    pos = mul(float4(pos, 1.0f), mat_w).xyz;
+    result.position = mul(float4(pos, 1.0f), matViewProj);
+    result.world_pos = pos;
+    result.normal = mul(float4(normal, 0.0f), mat_w).xyz;
+    result.tex = tex * inst_tex_scale;
+    result.atlas = float4(inst_tex, inst_tex_scale);
+    result.material = col;
+    // if opacity nonzero we ignore lighting (used for lamps)
+    if (inst_col.a > 0.0f) {
+        result.color = inst_col;
+        result.lit = 0.0f;
+        return result;
+    }
+
+    // ambient and baked lighting, as in VertexShader.hlsl
+    float4 ambient = ambientLight * float4((1.0f + inst_col.a).xxx, 1.0f);
+    result.color = (ambient + float4(inst_col.rgb, 0.0f)) * col;
+    result.lit = 1.0f;
+    return result;
+}
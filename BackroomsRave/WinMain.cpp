@@ -7,11 +7,14 @@
 #endif
 #include <Windows.h>
 #include <mmsystem.h>
+#include <shellapi.h>
+#include <cwchar>
+#include <string>
 
 #pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "shell32.lib")
 
 #include "ApplicationD3D.h"
-#include "SoundWrapper.h"
 inline constinit TCHAR const APP_NAME[] = TEXT(
     "Backrooms Rave"
 );
@@ -21,6 +24,45 @@ LRESULT CALLBACK WindowProc(HWND, UINT, WPARAM, LPARAM);
 namespace {
 
     constexpr TCHAR CLASS_NAME[] = TEXT("MainWindowClass");
+    constexpr UINT HEADLESS_FRAME_COUNT = 1000;
+    // frames of a benchmark or an offline sequence without --frames
+    constexpr UINT SEQUENCE_FRAME_COUNT = 600;
+
+    /*
+     * Returns the argument following `option` on the command line,
+     * or an empty string if the option is not there.
+     */
+    std::wstring get_option_value(PCWSTR option) {
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        std::wstring value;
+        for (int i = 0; argv != nullptr && i + 1 < argc; i++) {
+            if (wcscmp(argv[i], option) == 0) {
+                value = argv[i + 1];
+                break;
+            }
+        }
+        LocalFree(argv);
+        return value;
+    }
+
+    /*
+     * Returns true if `option` is one of the arguments on the command
+     * line, not just a part of one.
+     */
+    bool has_option(PCWSTR option) {
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        bool found = false;
+        for (int i = 1; argv != nullptr && i < argc; i++) {
+            if (wcscmp(argv[i], option) == 0) {
+                found = true;
+                break;
+            }
+        }
+        LocalFree(argv);
+        return found;
+    }
 
     /*
      * Registers a window class.
@@ -92,12 +134,89 @@ namespace {
 int WINAPI wWinMain(
     _In_     HINSTANCE instance,
     _In_opt_ [[maybe_unused]] HINSTANCE prev_instance,
-    _In_ [[maybe_unused]] PWSTR cmd_line,
+    _In_     [[maybe_unused]] PWSTR cmd_line,
     _In_     INT cmd_show
 ) {
     WNDCLASSEX wc;
     HWND hwnd;
 
+    // record the input of this run or replay an earlier one
+    const std::wstring record_path = get_option_value(L"--record");
+    if (!record_path.empty()) {
+        SetInputRecording(record_path.c_str());
+    }
+    const std::wstring replay_path = get_option_value(L"--replay");
+    if (!replay_path.empty() && !SetInputReplay(replay_path.c_str())) {
+        return 1;
+    }
+
+    const std::wstring frames = get_option_value(L"--frames");
+    const UINT frame_count = frames.empty()
+        ? SEQUENCE_FRAME_COUNT : wcstoul(frames.c_str(), nullptr, 10);
+
+    // light the static tiles on the CPU, only where lamps changed
+    if (has_option(L"--light-cache")) {
+        SetLightingCache();
+    }
+
+    // merge the static tiles into large quads lit per pixel
+    if (has_option(L"--per-pixel")) {
+        SetPerPixelLighting();
+    }
+
+    // use large tiles away from the lamps
+    if (has_option(L"--adaptive-tiles")) {
+        SetAdaptiveTiles();
+    }
+
+    // draw distant tiles as larger blocks
+    if (has_option(L"--tile-lod")) {
+        SetTileLod();
+    }
+
+    // draw the static instances front to back
+    if (has_option(L"--sort-instances")) {
+        SetInstanceSorting();
+    }
+
+    // measure the CPU work behind the frames
+    if (has_option(L"--bench")) {
+        RunBenchmarks();
+        return 0;
+    }
+
+    // render an animation sequence on the CPU to a video or images
+    const std::wstring offline_path = get_option_value(L"--offline");
+    if (!offline_path.empty()) {
+        const std::wstring camera_path = get_option_value(L"--camera-path");
+        return frame_count > 0 && RenderOffline(offline_path.c_str(), frame_count,
+            camera_path.empty() ? nullptr : camera_path.c_str()) ? 0 : 1;
+    }
+
+    // fly the camera along a scripted path and report the frame times
+    const std::wstring benchmark_path = get_option_value(L"--benchmark");
+    if (!benchmark_path.empty()) {
+        const std::wstring report_path = get_option_value(L"--report");
+        if (frame_count == 0 || !SetBenchmark(benchmark_path.c_str(), frame_count,
+                report_path.empty() ? L"benchmark_report.csv" : report_path.c_str())) {
+            return 1;
+        }
+    }
+
+    // render the headless frames on the CPU, compared with golden ones
+    const std::wstring raster_prefix = get_option_value(L"--raster");
+    const std::wstring golden_path = get_option_value(L"--golden");
+    if (!raster_prefix.empty() || !golden_path.empty()) {
+        SetSoftwareRendering(raster_prefix.empty() ? L"frame_" : raster_prefix.c_str(),
+            golden_path.empty() ? nullptr : golden_path.c_str());
+    }
+
+    // measure the frame pipeline without opening a window
+    if (has_option(L"--headless")) {
+        // fails when a steady-state frame allocates
+        return RunHeadless(HEADLESS_FRAME_COUNT) ? 0 : 1;
+    }
+
     if (!register_window_class(instance, wc))
         return 1;
     if (!create_window(instance, hwnd))
@@ -109,9 +228,6 @@ int WINAPI wWinMain(
     // hide cursor
     while (ShowCursor(FALSE) >= 0);
 
-    // play music
-    SoundWrapper sound(TEXT("assets/caramelldansen.wav"));
-
     return message_loop();
 }
 
@@ -123,11 +239,13 @@ LRESULT CALLBACK WindowProc(
 ) {
     switch (msg) {
     case WM_CREATE:
-        InitDirect3D(hwnd);
+        if (!InitDirect3D(hwnd)) {
+            return -1;  // CreateWindowEx fails
+        }
         InitTimer(hwnd);
         return 0;
     case WM_TIMER:
-        OnTimer();
+        OnTimer(hwnd);
         InvalidateRect(hwnd, nullptr, FALSE);
         return 0;
     case WM_PAINT:
@@ -136,6 +254,8 @@ LRESULT CALLBACK WindowProc(
         return 0;
     case WM_DESTROY:
         ReleaseTimer(hwnd);
+        EndDirect3D();
+        EndAudio();
         PostQuitMessage(0);
         return 0;
     }
@@ -0,0 +1,68 @@
+#include "Y4mWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+namespace {
+	BYTE to_byte(FLOAT value) {
+		return static_cast<BYTE>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+	}
+
+	FLOAT channel(UINT32 pixel, UINT c) {
+		return static_cast<FLOAT>((pixel >> (8 * c)) & 0xff);
+	}
+}
+
+Y4mWriter::Y4mWriter(PCWSTR path, UINT width, UINT height,
+	UINT rate_numerator, UINT rate_denominator) :
+	width(width),
+	height(height),
+	file(std::filesystem::path(path), std::ios::binary)
+{
+	const size_t chroma_size = size_t((width + 1) / 2) * ((height + 1) / 2);
+	planes.resize(size_t(width) * height + 2 * chroma_size);
+
+	char header[128];
+	const int header_size = snprintf(header, sizeof(header),
+		"YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+		width, height, rate_numerator, rate_denominator);
+	file.write(header, header_size);
+}
+
+bool Y4mWriter::write(std::span<const UINT32> pixels) {
+	BYTE* luma = planes.data();
+	const UINT chroma_width = (width + 1) / 2;
+	const UINT chroma_height = (height + 1) / 2;
+	BYTE* cb = luma + size_t(width) * height;
+	BYTE* cr = cb + size_t(chroma_width) * chroma_height;
+
+	for (size_t i = 0; i < size_t(width) * height; i++) {
+		const UINT32 pixel = pixels[i];
+		luma[i] = to_byte(0.299f * channel(pixel, 0)
+			+ 0.587f * channel(pixel, 1) + 0.114f * channel(pixel, 2));
+	}
+	for (UINT y = 0; y < chroma_height; y++) {
+		for (UINT x = 0; x < chroma_width; x++) {
+			// average of the pixels of the 2x2 block, clamped at odd edges
+			FLOAT rgb[3] = { 0.0f, 0.0f, 0.0f };
+			for (UINT dy = 0; dy < 2; dy++) {
+				for (UINT dx = 0; dx < 2; dx++) {
+					const UINT px = (std::min)(2 * x + dx, width - 1);
+					const UINT py = (std::min)(2 * y + dy, height - 1);
+					const UINT32 pixel = pixels[size_t(py) * width + px];
+					for (UINT c = 0; c < 3; c++) {
+						rgb[c] += 0.25f * channel(pixel, c);
+					}
+				}
+			}
+			const size_t i = size_t(y) * chroma_width + x;
+			cb[i] = to_byte(128.0f - 0.168736f * rgb[0] - 0.331264f * rgb[1] + 0.5f * rgb[2]);
+			cr[i] = to_byte(128.0f + 0.5f * rgb[0] - 0.418688f * rgb[1] - 0.081312f * rgb[2]);
+		}
+	}
+
+	file.write("FRAME\n", 6);
+	file.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+	return static_cast<bool>(file);
+}
\ No newline at end of file
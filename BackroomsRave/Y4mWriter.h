@@ -0,0 +1,32 @@
+#ifndef Y4M_WRITER_H
+#define Y4M_WRITER_H
+
+#include <Windows.h>
+#include <fstream>
+#include <span>
+#include <vector>
+
+/*
+ * Writes frames to a YUV4MPEG2 video, which ffmpeg and most players
+ * read directly. Colors are converted to full-range BT.601 YCbCr with
+ * chroma averaged over 2x2 pixels (4:2:0).
+ */
+class Y4mWriter {
+public:
+	// Frames are `width` x `height` pixels, shown at
+	// `rate_numerator` / `rate_denominator` frames per second.
+	Y4mWriter(PCWSTR path, UINT width, UINT height,
+		UINT rate_numerator, UINT rate_denominator);
+
+	// `pixels` are RGBA with red in the lowest byte, top row first.
+	// Returns false if the file cannot be written.
+	bool write(std::span<const UINT32> pixels);
+
+private:
+	UINT width;
+	UINT height;
+	std::ofstream file;
+	std::vector<BYTE> planes;   // Y, then Cb, then Cr
+};
+
+#endif // Y4M_WRITER_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstdint>
+
+/*
+ * Counter-based random number generation (Widynski's "Squares").
+ * Every output is a pure function of a key and a 64-bit counter,
+ * so any element of a random sequence can be computed in O(1),
+ * in any order and for many counters at once.
+ */
+
+/*
+ * Turns an arbitrary seed into a key with well mixed bits
+ * (splitmix64 finalizer). Squares needs an odd key.
+ */
+constexpr uint64_t rng_key(uint64_t seed) {
+	uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z = z ^ (z >> 31);
+	return z | 1;
+}
+
+/*
+ * Returns 32 random bits for the given counter.
+ */
+constexpr uint32_t squares32(uint64_t counter, uint64_t key) {
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	x = x * x + z; x = (x >> 32) | (x << 32);
+	x = x * x + y; x = (x >> 32) | (x << 32);
+	return static_cast<uint32_t>((x * x + z) >> 32);
+}
+
+/*
+ * Maps 32 random bits to a float in [0, 1).
+ */
+constexpr float rng_unit_float(uint32_t bits) {
+	return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif // COUNTER_RNG_H
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <DirectXMath.h>
+#include <vector>
+
+/*
+ * Helpers for structure-of-arrays data processed four elements
+ * at a time. Arrays must be padded to a multiple of 4.
+ */
+
+/*
+ * Loads 4 consecutive floats starting at index i.
+ */
+inline DirectX::XMVECTOR load_lane(const std::vector<float>& data, size_t i) {
+	return DirectX::XMLoadFloat4(
+		reinterpret_cast<const DirectX::XMFLOAT4*>(&data[i]));
+}
+
+/*
+ * Stores a vector to 4 consecutive floats starting at index i.
+ */
+inline void store_lane(std::vector<float>& data, size_t i, DirectX::FXMVECTOR v) {
+	DirectX::XMStoreFloat4(
+		reinterpret_cast<DirectX::XMFLOAT4*>(&data[i]), v);
+}
+
+/*
+ * Rounds an element count up to a whole number of lanes.
+ */
+constexpr size_t lane_padded(size_t count) {
+	return (count + 3) & ~static_cast<size_t>(3);
+}
+
+#endif // SIMD_H
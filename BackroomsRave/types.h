@@ -22,6 +22,25 @@ struct square_instance_t {
 	FLOAT tex_coord[2];
 	DirectX::XMFLOAT4 color;
 	DirectX::XMFLOAT4X4 world;
+	FLOAT tex_scale[2];     // tiles of texture across the square
+};
+
+
+/*
+ * Struct for the constant buffer of the vertex shader,
+ * padded to the placement alignment of constant buffers
+ */
+constexpr UINT CONST_BUFFER_ALIGN = 512;
+
+struct vs_const_buffer_t {
+	DirectX::XMFLOAT4X4 matViewProj;
+	DirectX::XMFLOAT4X4 matView;
+	DirectX::XMFLOAT4 colMaterial;
+	DirectX::XMFLOAT4 colLight[7];
+	DirectX::XMFLOAT4 pointLight[7];
+	DirectX::XMFLOAT4 ambientLight;
+	DirectX::XMFLOAT4 padding[(CONST_BUFFER_ALIGN
+		- 2 * sizeof(DirectX::XMFLOAT4X4) - 16 * sizeof(DirectX::XMFLOAT4)) / sizeof(DirectX::XMFLOAT4)];
 };
 
 #endif // TYPES_H
\ No newline at end of file
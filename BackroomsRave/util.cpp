@@ -2,6 +2,14 @@
 
 #include <wincodec.h>
 #include <comdef.h>
+#include <mmsystem.h>
+#include <mmreg.h>
+#include <msacm.h>
+#include <algorithm>
+#include <cwchar>
+
+#pragma comment(lib, "winmm.lib")
+#pragma comment(lib, "msacm32.lib")
 
 void hr_check(HRESULT hr) {
 	if (FAILED(hr)) {
@@ -14,43 +22,195 @@ BYTE* load_bitmap(PCWSTR uri, UINT& width, UINT& height) {
     IWICBitmapDecoder* wic_decoder = nullptr;
     IWICBitmapFrameDecode* wic_frame = nullptr;
     IWICFormatConverter* wic_converter = nullptr;
+    BYTE* res = nullptr;
 
-    hr_check(CoCreateInstance(
+    HRESULT hr = CoCreateInstance(
         CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
         IID_PPV_ARGS(&wic_factory)
-    ));
-
-    hr_check(wic_factory->CreateDecoderFromFilename(
+    );
+    if (SUCCEEDED(hr)) hr = wic_factory->CreateDecoderFromFilename(
         uri, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnLoad,
-        &wic_decoder
-    ));
-
-    hr_check(wic_decoder->GetFrame(0, &wic_frame));
-
-    hr_check(wic_factory->CreateFormatConverter(&wic_converter));
-
-    hr_check(wic_converter->Initialize(
+        &wic_decoder);
+    if (SUCCEEDED(hr)) hr = wic_decoder->GetFrame(0, &wic_frame);
+    if (SUCCEEDED(hr)) hr = wic_factory->CreateFormatConverter(&wic_converter);
+    if (SUCCEEDED(hr)) hr = wic_converter->Initialize(
         wic_frame,
         GUID_WICPixelFormat32bppRGBA,
         WICBitmapDitherTypeNone,
         nullptr,
         0.0f,
         WICBitmapPaletteTypeMedianCut
-    ));
-
-    hr_check(wic_converter->GetSize(&width, &height));
-
-    BYTE* res = new BYTE[4 * width * height];
-    hr_check(wic_converter->CopyPixels(
-        nullptr, 4 * width, 4 * width * height, res
-    ));
-
+    );
+    if (SUCCEEDED(hr)) hr = wic_converter->GetSize(&width, &height);
+    if (SUCCEEDED(hr)) {
+        res = new BYTE[4 * width * height];
+        hr = wic_converter->CopyPixels(
+            nullptr, 4 * width, 4 * width * height, res
+        );
+    }
 
     if (wic_factory) wic_factory->Release();
     if (wic_decoder) wic_decoder->Release();
     if (wic_frame) wic_frame->Release();
     if (wic_converter) wic_converter->Release();
 
+    if (FAILED(hr)) {
+        delete[] res;
+        throw "Cannot load the bitmap";
+    }
     return res;
 }
 
+bool save_png(PCWSTR uri, UINT width, UINT height, const BYTE* pixels) {
+    IWICImagingFactory* wic_factory = nullptr;
+    IWICStream* wic_stream = nullptr;
+    IWICBitmapEncoder* wic_encoder = nullptr;
+    IWICBitmapFrameEncode* wic_frame = nullptr;
+    WICPixelFormatGUID format = GUID_WICPixelFormat32bppRGBA;
+
+    HRESULT hr = CoCreateInstance(
+        CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+        IID_PPV_ARGS(&wic_factory)
+    );
+    if (SUCCEEDED(hr)) hr = wic_factory->CreateStream(&wic_stream);
+    if (SUCCEEDED(hr)) hr = wic_stream->InitializeFromFilename(uri, GENERIC_WRITE);
+    if (SUCCEEDED(hr)) hr = wic_factory->CreateEncoder(
+        GUID_ContainerFormatPng, nullptr, &wic_encoder);
+    if (SUCCEEDED(hr)) hr = wic_encoder->Initialize(wic_stream, WICBitmapEncoderNoCache);
+    if (SUCCEEDED(hr)) hr = wic_encoder->CreateNewFrame(&wic_frame, nullptr);
+    if (SUCCEEDED(hr)) hr = wic_frame->Initialize(nullptr);
+    if (SUCCEEDED(hr)) hr = wic_frame->SetSize(width, height);
+    // the encoder may only offer a different format
+    if (SUCCEEDED(hr)) hr = wic_frame->SetPixelFormat(&format);
+    if (SUCCEEDED(hr) && format != GUID_WICPixelFormat32bppRGBA) hr = E_FAIL;
+    if (SUCCEEDED(hr)) hr = wic_frame->WritePixels(
+        height, 4 * width, 4 * width * height, const_cast<BYTE*>(pixels));
+    if (SUCCEEDED(hr)) hr = wic_frame->Commit();
+    if (SUCCEEDED(hr)) hr = wic_encoder->Commit();
+
+    if (wic_frame) wic_frame->Release();
+    if (wic_encoder) wic_encoder->Release();
+    if (wic_stream) wic_stream->Release();
+    if (wic_factory) wic_factory->Release();
+
+    return SUCCEEDED(hr);
+}
+
+std::vector<float> load_wave(PCWSTR uri, UINT& sample_rate) {
+    HMMIO file = mmioOpen(const_cast<LPWSTR>(uri), nullptr, MMIO_READ);
+    if (file == nullptr) {
+        return {};
+    }
+
+    // find the format and data chunks of the RIFF file
+    MMCKINFO riff_chunk = {};
+    riff_chunk.fccType = mmioFOURCC('W', 'A', 'V', 'E');
+    MMCKINFO chunk = {};
+    std::vector<BYTE> format;
+    std::vector<BYTE> data;
+    if (mmioDescend(file, &riff_chunk, nullptr, MMIO_FINDRIFF) == MMSYSERR_NOERROR) {
+        chunk.ckid = mmioFOURCC('f', 'm', 't', ' ');
+        if (mmioDescend(file, &chunk, &riff_chunk, MMIO_FINDCHUNK) == MMSYSERR_NOERROR) {
+            format.resize(max(chunk.cksize, sizeof(WAVEFORMATEX)));
+            mmioRead(file, reinterpret_cast<HPSTR>(format.data()), chunk.cksize);
+            mmioAscend(file, &chunk, 0);
+        }
+        chunk.ckid = mmioFOURCC('d', 'a', 't', 'a');
+        if (mmioDescend(file, &chunk, &riff_chunk, MMIO_FINDCHUNK) == MMSYSERR_NOERROR) {
+            data.resize(chunk.cksize);
+            LONG read = mmioRead(
+                file, reinterpret_cast<HPSTR>(data.data()), chunk.cksize);
+            data.resize(read > 0 ? read : 0);
+        }
+    }
+    mmioClose(file, 0);
+    if (format.empty() || data.empty()) {
+        return {};
+    }
+
+    WAVEFORMATEX pcm_format = *reinterpret_cast<WAVEFORMATEX*>(format.data());
+    if (pcm_format.wFormatTag != WAVE_FORMAT_PCM) {
+        // compressed data (e.g. MPEG Layer-3), let ACM decode it to PCM
+        auto src_format = reinterpret_cast<WAVEFORMATEX*>(format.data());
+        pcm_format = { .wFormatTag = WAVE_FORMAT_PCM };
+        HACMSTREAM acm_stream = nullptr;
+        DWORD pcm_size = 0;
+        if (acmFormatSuggest(nullptr, src_format, &pcm_format, sizeof(pcm_format),
+                ACM_FORMATSUGGESTF_WFORMATTAG) != MMSYSERR_NOERROR
+            || acmStreamOpen(&acm_stream, nullptr, src_format, &pcm_format,
+                nullptr, 0, 0, ACM_STREAMOPENF_NONREALTIME) != MMSYSERR_NOERROR) {
+            return {};
+        }
+        acmStreamSize(acm_stream, static_cast<DWORD>(data.size()), &pcm_size,
+            ACM_STREAMSIZEF_SOURCE);
+
+        std::vector<BYTE> pcm_data(pcm_size);
+        ACMSTREAMHEADER header = {
+            .cbStruct = sizeof(ACMSTREAMHEADER),
+            .pbSrc = data.data(),
+            .cbSrcLength = static_cast<DWORD>(data.size()),
+            .pbDst = pcm_data.data(),
+            .cbDstLength = pcm_size
+        };
+        acmStreamPrepareHeader(acm_stream, &header, 0);
+        acmStreamConvert(acm_stream, &header,
+            ACM_STREAMCONVERTF_START | ACM_STREAMCONVERTF_END);
+        acmStreamUnprepareHeader(acm_stream, &header, 0);
+        acmStreamClose(acm_stream, 0);
+
+        pcm_data.resize(header.cbDstLengthUsed);
+        data = std::move(pcm_data);
+    }
+
+    // convert 8 or 16 bit PCM to stereo floats, the first two
+    // channels are kept and a single one is played on both
+    const UINT channels = pcm_format.nChannels;
+    const UINT sample_size = pcm_format.wBitsPerSample / 8;
+    if (channels == 0 || (sample_size != 1 && sample_size != 2)) {
+        return {};
+    }
+    const size_t frames = data.size() / (channels * sample_size);
+    std::vector<float> samples(2 * frames);
+    for (size_t i = 0; i < frames; i++) {
+        for (UINT c = 0; c < 2; c++) {
+            const BYTE* src = data.data()
+                + (i * channels + (std::min)(c, channels - 1)) * sample_size;
+            samples[2 * i + c] = sample_size == 2
+                ? *reinterpret_cast<const SHORT*>(src) / 32768.0f
+                : (*src - 128) / 128.0f;
+        }
+    }
+
+    sample_rate = pcm_format.nSamplesPerSec;
+    return samples;
+}
+
+UINT64 fnv1a(const void* data, size_t size, UINT64 hash) {
+    const BYTE* bytes = static_cast<const BYTE*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void log_tile_reduction(PCWSTR tag, PCWSTR level, size_t tiles, size_t instances, double time_ms) {
+    WCHAR line[160];
+    swprintf_s(line, L"[%s] %s: %zu tiles -> %zu instances, %.1fx fewer in %.1f ms\n",
+        tag, level, tiles, instances,
+        static_cast<double>(tiles) / (std::max)(instances, size_t(1)), time_ms);
+    OutputDebugStringW(line);
+}
+
+ScopeTimer::ScopeTimer(PCWSTR name) :
+    name(name),
+    start(std::chrono::steady_clock::now())
+{}
+
+ScopeTimer::~ScopeTimer() {
+    const std::chrono::duration<double, std::milli> duration =
+        std::chrono::steady_clock::now() - start;
+    WCHAR line[128];
+    swprintf_s(line, L"[timing] %s: %.2f ms (thread %lu)\n",
+        name, duration.count(), GetCurrentThreadId());
+    OutputDebugStringW(line);
+}
\ No newline at end of file
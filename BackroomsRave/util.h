@@ -4,6 +4,8 @@
 #include <windows.h>
 #include <d3d12.h>
 #include <dxgi1_4.h>
+#include <chrono>
+#include <vector>
 
 /*
  * Helper function check HRESULT. Exits with code 1 if failed.
@@ -13,8 +15,66 @@ void hr_check(HRESULT hr);
 
 /*
  * Helper function to load a bitmap from a file.
+ * Needs COM on the calling thread. Throws if failed, so it can
+ * run on threads without a message loop.
  */
 BYTE* load_bitmap(PCWSTR uri, UINT& width, UINT& height);
 
 
+/*
+ * Helper function to save RGBA pixels, 8 bits per channel,
+ * as a PNG file. Needs COM on the calling thread.
+ * Returns false if failed.
+ */
+bool save_png(PCWSTR uri, UINT width, UINT height, const BYTE* pixels);
+
+
+/*
+ * Helper function to load a wave file as interleaved stereo float
+ * samples, mono files play on both channels.
+ * Compressed formats are decoded with ACM. Returns no samples if failed.
+ */
+std::vector<float> load_wave(PCWSTR uri, UINT& sample_rate);
+
+
+/*
+ * Helper function hashing bytes with 64-bit FNV-1a.
+ * Pass the previous result as `hash` to continue hashing.
+ */
+UINT64 fnv1a(const void* data, size_t size, UINT64 hash = 14695981039346656037ull);
+
+
+/*
+ * Helper function writing to the debugger output, prefixed by `tag`,
+ * how many fewer instances than `tiles` uniform tiles of `level`
+ * the `instances` replacing them are.
+ */
+void log_tile_reduction(PCWSTR tag, PCWSTR level, size_t tiles, size_t instances, double time_ms);
+
+
+/*
+ * Helper class measuring the time until it goes out of scope.
+ * The duration is written to the debugger output.
+ */
+class ScopeTimer {
+public:
+    ScopeTimer(PCWSTR name);
+    ~ScopeTimer();
+
+private:
+    PCWSTR name;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+/*
+ * Helper function running `phase` under a ScopeTimer.
+ */
+template <typename F>
+auto timed(PCWSTR name, F&& phase) {
+    ScopeTimer timer(name);
+    return phase();
+}
+
+
 #endif /* UTIL_H */
\ No newline at end of file